@@ -0,0 +1,121 @@
+/**
+ * @file  ChordMatcher.h
+ *
+ * @brief  Detects registered key combinations within the stream of tracked
+ *         key events.
+ */
+
+#pragma once
+#include "KeyMessage.h"
+#include "KeySet.h"
+#include <linux/input-event-codes.h>
+#include <vector>
+#include <cstdint>
+
+namespace KeyDaemon
+{
+    class ChordMatcher;
+}
+
+/**
+ * @brief  Tracks held keys and reports when registered chords start and end.
+ *
+ *  A chord fires when the last of its keys is pressed while exactly its keys
+ * are held, in any order. It is released as soon as any of its keys is
+ * released. Each chord is assigned one bit in a per-key membership mask, so
+ * handling an event only costs one step for each chord that contains the
+ * event's key, bounded by maxChords.
+ *
+ *  Chord keys are only forwarded to the parent as individual key events if
+ * they were also registered as tracked keys. Only one thread may process
+ * events at a time.
+ */
+class KeyDaemon::ChordMatcher
+{
+public:
+    // Maximum number of chords that can be registered:
+    static const constexpr int maxChords = 64;
+
+    // Maximum number of keys in a single chord:
+    static const constexpr int maxChordKeys = 8;
+
+    // Maximum number of messages produced by a single key event:
+    static const constexpr int maxOutputMessages = maxChords + 1;
+
+    /**
+     * @brief  Builds chord membership tables on construction.
+     *
+     * @param forwardedKeys  Key codes and event types that should still be
+     *                       sent to the parent as individual key events.
+     *
+     * @param chords         Registered chords, each holding two to
+     *                       maxChordKeys distinct key codes. Chords are
+     *                       identified by their index in this list. Invalid
+     *                       chords and chords past maxChords are ignored.
+     */
+    ChordMatcher(const KeySet& forwardedKeys,
+            const std::vector<std::vector<int>>& chords);
+
+    virtual ~ChordMatcher() { }
+
+    /**
+     * @brief  Checks if a list of key codes can be registered as a chord.
+     *
+     * @param chordKeys  The chord's key codes.
+     *
+     * @return           Whether the chord has two to maxChordKeys distinct,
+     *                   valid key codes.
+     */
+    static bool isValidChord(const std::vector<int>& chordKeys);
+
+    /**
+     * @brief  Checks if any chords were registered.
+     *
+     * @return  Whether events need to pass through the ChordMatcher.
+     */
+    bool hasChords() const;
+
+    /**
+     * @brief  Replaces the keys and event types sent to the parent as
+     *         individual key events. Chords and held key state are kept.
+     *
+     * @param forwardedKeys  Key codes and event types that should be sent
+     *                       to the parent as individual key events.
+     */
+    void setForwardedKeys(const KeySet& forwardedKeys);
+
+    /**
+     * @brief  Updates held key state with a new key event, and finds the
+     *         messages that should be sent because of it.
+     *
+     * @param message  A tracked key event.
+     *
+     * @param output   A buffer with room for maxOutputMessages messages,
+     *                 used to return the key event if its code and type are
+     *                 forwarded, followed by any chord messages. Chord
+     *                 messages use MessageKind::chord, hold the chord index
+     *                 in keyCode, and use EventType::pressed when the chord
+     *                 fires and EventType::released when it ends.
+     *
+     * @return         The number of messages copied to the output buffer.
+     */
+    int process(const KeyMessage& message, KeyMessage* output);
+
+private:
+    // Keys and event types forwarded to the parent as individual events:
+    KeySet forwardedKeys;
+    // Number of valid registered chords:
+    int chordCount = 0;
+    // For each key code, one bit set for each chord that contains the key:
+    uint64_t chordMasks[KEY_CNT] = {};
+    // Number of keys in each chord:
+    uint8_t chordSizes[maxChords] = {};
+    // Number of each chord's keys currently held:
+    uint8_t heldChordKeys[maxChords] = {};
+    // One bit set for each chord that has fired and not been released:
+    uint64_t activeChords = 0;
+    // Held state of every key code:
+    bool heldKeys[KEY_CNT] = {};
+    // Total number of tracked keys currently held:
+    int heldKeyCount = 0;
+};
@@ -0,0 +1,93 @@
+/**
+ * @file  ControlReader.h
+ *
+ * @brief  Reads commands sent by the parent application through the control
+ *         FIFO, when built with KD_CONTROL.
+ */
+
+#pragma once
+#include "ControlFormat.h"
+#include <vector>
+
+namespace KeyDaemon
+{
+    class ControlReader;
+}
+
+/**
+ * @brief  Opens the parent's control FIFO and decodes the commands written to
+ *         it.
+ *
+ *  The parent creates the FIFO with owner-only permissions before launching
+ * the daemon. The daemon may be able to open files its user doesn't own, so
+ * the FIFO is only used if it is owned by the daemon's real user and no other
+ * users can access it.
+ *
+ *  Like the DeviceWatcher, the ControlReader doesn't wait on its own. The
+ * KeyLoop polls its file descriptor along with its other wakeup sources, and
+ * calls readCommand until it returns false.
+ */
+class KeyDaemon::ControlReader
+{
+public:
+    /**
+     * @brief  A single decoded control command.
+     */
+    struct Command
+    {
+        // The action the daemon should take:
+        ControlFormat::Command type;
+        // New individually tracked keys, if type is Command::setKeys:
+        std::vector<int> keyCodes;
+        // Event types to send for each of keyCodes, in the same order:
+        std::vector<EventMask> eventMasks;
+    };
+
+    /**
+     * @brief  Opens the control FIFO on construction, if it is safe to use.
+     *
+     * @param fifoPath  The path to the FIFO created by the parent.
+     */
+    ControlReader(const char* fifoPath);
+
+    /**
+     * @brief  Closes the control FIFO on destruction.
+     */
+    virtual ~ControlReader();
+
+    /**
+     * @brief  Checks if the control FIFO was opened.
+     *
+     * @return  Whether control commands can be received.
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief  Gets the descriptor that becomes readable when the parent sends
+     *         a command.
+     *
+     * @return  The FIFO file descriptor, or -1 if the FIFO isn't open.
+     */
+    int getFileDescriptor() const;
+
+    /**
+     * @brief  Reads the next pending command without blocking.
+     *
+     *  If invalid data is found, all pending data is discarded, as command
+     * boundaries can't be found again.
+     *
+     * @param command  Used to return the command.
+     *
+     * @return         Whether a valid command was read.
+     */
+    bool readCommand(Command& command);
+
+private:
+    /**
+     * @brief  Discards all data waiting in the FIFO.
+     */
+    void discardInput();
+
+    // The control FIFO file descriptor:
+    int fifoFD = -1;
+};
@@ -0,0 +1,64 @@
+/**
+ * @file  DeviceWatcher.h
+ *
+ * @brief  Watches the input event file directory for keyboards being added or
+ *         removed.
+ */
+
+#pragma once
+
+namespace KeyDaemon
+{
+    class DeviceWatcher;
+}
+
+/**
+ * @brief  Uses inotify to detect when input event files are created,
+ *         removed, or have their permissions changed.
+ *
+ *  The DeviceWatcher doesn't read or wait on its own. The KeyLoop polls its
+ * file descriptor along with its other wakeup sources, and calls readChanges
+ * when it becomes readable.
+ */
+class KeyDaemon::DeviceWatcher
+{
+public:
+    /**
+     * @brief  Starts watching the event file directory on construction.
+     */
+    DeviceWatcher();
+
+    /**
+     * @brief  Stops watching the event file directory on destruction.
+     */
+    virtual ~DeviceWatcher();
+
+    /**
+     * @brief  Checks if the event file directory is being watched.
+     *
+     * @return  Whether event file changes will be detected.
+     */
+    bool isWatching() const;
+
+    /**
+     * @brief  Gets the descriptor that becomes readable when the event file
+     *         directory changes.
+     *
+     * @return  The inotify file descriptor, or -1 if not watching.
+     */
+    int getFileDescriptor() const;
+
+    /**
+     * @brief  Reads all pending directory change notifications without
+     *         blocking.
+     *
+     * @return  Whether any notification involved an event file, or
+     *          notifications were lost and the directory should be checked
+     *          again anyway.
+     */
+    bool readChanges();
+
+private:
+    // The inotify instance file descriptor:
+    int inotifyFD = -1;
+};
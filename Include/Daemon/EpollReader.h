@@ -0,0 +1,89 @@
+/**
+ * @file  EpollReader.h
+ *
+ * @brief  Reads key events from every keyboard event file on a single thread
+ *         using epoll.
+ */
+
+#pragma once
+#include "MultiReader.h"
+
+namespace KeyDaemon
+{
+    class EpollReader;
+}
+
+/**
+ * @brief  Adds all event file descriptors to one epoll set, and drains each
+ *         file whenever epoll reports that it has new input.
+ */
+class KeyDaemon::EpollReader : public MultiReader
+{
+public:
+    /**
+     * @brief  Opens all event files and starts the read thread.
+     *
+     * @param eventFilePaths  Paths to all keyboard input event files that
+     *                        should be read.
+     *
+     * @param trackedKeys     The set of all key event codes that should be
+     *                        reported.
+     *
+     * @param listener        The object that will handle relevant keyboard
+     *                        events.
+     */
+    EpollReader(const std::vector<std::string>& eventFilePaths,
+            const KeySetBuffer& trackedKeys, KeyReader::Listener* listener);
+
+    /**
+     * @brief  Stops the read thread and closes the epoll instance.
+     */
+    virtual ~EpollReader();
+
+private:
+    /**
+     * @brief  Waits for and reads input from all open event files until the
+     *         EpollReader is destroyed or all files are closed.
+     */
+    virtual void readLoop() override;
+
+    /**
+     * @brief  Wakes the read thread from epoll_wait so it can exit.
+     */
+    virtual void signalStop() override;
+
+    /**
+     * @brief  Reads input from one event file into its buffer without
+     *         blocking.
+     *
+     * @param fileIndex  The index of the event file to read.
+     *
+     * @return           The number of bytes read, zero if no input was
+     *                   available, or -1 if the file was closed or
+     *                   encountered an error.
+     */
+    int readInput(const size_t fileIndex);
+
+    /**
+     * @brief  Reads and processes all input currently available from one
+     *         event file.
+     *
+     * @param fileIndex  The index of the event file to read.
+     *
+     * @return           False if the file was closed or encountered an
+     *                   error, true otherwise.
+     */
+    bool readAvailable(const size_t fileIndex);
+
+    /**
+     * @brief  Removes an event file from the epoll set before closing it.
+     *
+     * @param fileIndex  The index of the event file to close.
+     */
+    virtual void closeFile(const size_t fileIndex) override;
+
+    // The epoll instance that holds all event file descriptors:
+    int epollFD = -1;
+    // Event file descriptor used to wake the read thread for shutdown:
+    int stopFD = -1;
+};
@@ -5,6 +5,7 @@
  */
 
 #pragma once
+#include "KeySet.h"
 #include <vector>
 #include <string>
 
@@ -13,10 +14,41 @@ namespace KeyDaemon
     namespace EventFiles
     {
         /**
-         * @brief  Gets paths for all valid keyboard input event files.
+         * @brief  Gets paths for all keyboard input event files that can emit
+         *         at least one tracked key code.
          *
-         * @return  The list of valid keyboard file paths.
+         *  Keyboards are found by parsing the kernel's input device list.
+         * Devices with the keyboard handler whose key capability bitmaps
+         * don't include any tracked key, like power buttons and lid switches,
+         * are skipped. The number of skipped devices is added to the
+         * skippedDevices performance counter.
+         *
+         * @param trackedKeys  The set of all tracked key codes.
+         *
+         * @return             The list of valid keyboard file paths.
+         */
+        std::vector<std::string> getPaths(const KeySet& trackedKeys);
+
+        /**
+         * @brief  Gets the path to the directory where event files are found.
+         *
+         *  This is /dev/input/ unless the daemon was built with KD_EVENT_DIR
+         * set to a stand-in directory for testing. When using a stand-in
+         * directory, every file in it named "event*" is treated as a keyboard
+         * event file.
+         *
+         * @return  The event file directory path, ending in '/'.
+         */
+        const std::string& getDirPath();
+
+        /**
+         * @brief  Checks if a file name within the event file directory could
+         *         belong to an input event file.
+         *
+         * @param fileName  A file name, without any directory path.
+         *
+         * @return          Whether the name starts with "event".
          */
-        std::vector<std::string> getPaths();
+        bool isEventFileName(const char* fileName);
     }
 }
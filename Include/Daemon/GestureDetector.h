@@ -0,0 +1,207 @@
+/**
+ * @file  GestureDetector.h
+ *
+ * @brief  Detects long presses and double taps of individual tracked keys.
+ */
+
+#pragma once
+#include "KeyMessage.h"
+#include "KeyGesture.h"
+#include <linux/input-event-codes.h>
+#include <vector>
+#include <cstdint>
+
+namespace KeyDaemon
+{
+    class GestureDetector;
+}
+
+/**
+ * @brief  Finds timed gestures within the stream of tracked key events,
+ *         using a single timerfd to run a timer wheel for long presses.
+ *
+ *  A double tap is sent when a key is pressed again within its double tap
+ * threshold of its last press, measured using event timestamps. Presses that
+ * became long presses or completed a double tap never start a new double tap.
+ *
+ *  A long press is sent when a key stays held for its long press threshold.
+ * Each held key schedules a deadline in a timer wheel with one slot per
+ * timer tick. While any deadline is pending, the timerfd wakes the KeyLoop
+ * once per tick, and the KeyLoop calls readTimers to send any expired long
+ * presses. The timerfd is disarmed whenever no deadlines are pending.
+ *
+ *  Repeat events for gesture keys are never sent to the parent, since long
+ * presses replace them. Like DeviceWatcher, the GestureDetector never waits
+ * on its own, and only one thread may use it at a time.
+ */
+class KeyDaemon::GestureDetector
+{
+public:
+    // Maximum number of keys that can have gestures:
+    static const constexpr int maxGestureKeys = 32;
+
+    // Smallest allowed gesture threshold, in milliseconds. Shorter long
+    // presses would report nearly every press of the key:
+    static const constexpr unsigned int minThresholdMS = 100;
+
+    // Largest allowed gesture threshold, in milliseconds:
+    static const constexpr unsigned int maxThresholdMS = 10000;
+
+    // Maximum number of messages produced by a single key event:
+    static const constexpr int maxOutputMessages = 1;
+
+    // Maximum number of messages produced by a single call to readTimers:
+    static const constexpr int maxTimerMessages = maxGestureKeys;
+
+    /**
+     * @brief  Saves gesture thresholds, and creates the timerfd if any
+     *         gestures were registered.
+     *
+     * @param gestures  Gesture thresholds for each key. Invalid gestures,
+     *                  repeated keys, and gestures past maxGestureKeys are
+     *                  ignored.
+     */
+    GestureDetector(const std::vector<KeyGesture>& gestures);
+
+    /**
+     * @brief  Closes the timerfd on destruction.
+     */
+    virtual ~GestureDetector();
+
+    /**
+     * @brief  Checks if a key's gesture thresholds can be registered.
+     *
+     * @param gesture  The gesture thresholds to check.
+     *
+     * @return         Whether the key code is valid, at least one threshold
+     *                 is enabled, and every enabled threshold is between
+     *                 minThresholdMS and maxThresholdMS.
+     */
+    static bool isValidGesture(const KeyGesture& gesture);
+
+    /**
+     * @brief  Checks if any gestures were registered.
+     *
+     * @return  Whether key events need to pass through the GestureDetector.
+     */
+    bool hasGestures() const;
+
+    /**
+     * @brief  Gets the descriptor that becomes readable once per timer tick
+     *         while long press deadlines are pending.
+     *
+     * @return  The timerfd file descriptor, or -1 if no gestures were
+     *          registered or the timerfd couldn't be created.
+     */
+    int getFileDescriptor() const;
+
+    /**
+     * @brief  Checks if a key event should be withheld from the parent
+     *         because gestures replace it.
+     *
+     * @param message  A tracked key event.
+     *
+     * @return         Whether the event is a repeat of a gesture key.
+     */
+    bool suppresses(const KeyMessage& message) const;
+
+    /**
+     * @brief  Updates gesture state with a new key event, scheduling or
+     *         cancelling its long press, and checks if it completed a double
+     *         tap.
+     *
+     * @param message  A tracked key event.
+     *
+     * @param output   A buffer with room for maxOutputMessages messages,
+     *                 used to return a MessageKind::doubleTap message if the
+     *                 event completed a double tap.
+     *
+     * @return         The number of messages copied to the output buffer.
+     */
+    int process(const KeyMessage& message, KeyMessage* output);
+
+    /**
+     * @brief  Reads the timerfd without blocking, and finds all long presses
+     *         whose deadlines have passed.
+     *
+     * @param output  A buffer with room for maxTimerMessages messages, used
+     *                to return a MessageKind::longPress message for each
+     *                expired deadline. Each message's timestamp is its
+     *                deadline.
+     *
+     * @return        The number of messages copied to the output buffer.
+     */
+    int readTimers(KeyMessage* output);
+
+private:
+    /**
+     * @brief  Adds a long press deadline to the timer wheel, starting the
+     *         timerfd if it isn't running.
+     *
+     * @param gestureIndex  The index of the held gesture key.
+     *
+     * @param deadline      CLOCK_MONOTONIC time in microseconds when the
+     *                      long press should be sent.
+     */
+    void scheduleLongPress(const int gestureIndex, const uint64_t deadline);
+
+    /**
+     * @brief  Removes a key's long press deadline from the timer wheel if
+     *         present, stopping the timerfd if no deadlines remain.
+     *
+     * @param gestureIndex  The index of the gesture key.
+     */
+    void cancelLongPress(const int gestureIndex);
+
+    /**
+     * @brief  Arms the timerfd to wake once per tick, or disarms it.
+     *
+     * @param running  Whether the timer should run.
+     */
+    void setTimerRunning(const bool running);
+
+    // Number of timer wheel slots, no more than one per possible
+    // KeyState::slot value:
+    static const constexpr int wheelSlots = 256;
+
+    // Gesture index assigned to each key code, or -1 for keys without
+    // gestures:
+    int8_t gestureIndices[KEY_CNT];
+    // Number of keys with gestures:
+    int gestureCount = 0;
+    // Timer file descriptor used to wake the KeyLoop for long presses:
+    int timerFD = -1;
+    // Last timer tick processed, counted from CLOCK_MONOTONIC zero:
+    uint64_t lastTick = 0;
+    // Number of long press deadlines in the timer wheel:
+    int pendingTimers = 0;
+    // First gesture index scheduled in each wheel slot, or -1:
+    int8_t slotHeads[wheelSlots];
+
+    // State tracked for each gesture key:
+    struct KeyState
+    {
+        // The key's code:
+        int keyCode = 0;
+        // Long press threshold in microseconds, or zero if disabled:
+        uint64_t longPressUS = 0;
+        // Double tap threshold in microseconds, or zero if disabled:
+        uint64_t doubleTapUS = 0;
+        // Time in microseconds of the key's last press:
+        uint64_t lastPressTime = 0;
+        // Whether the last press can be the first half of a double tap:
+        bool tapPending = false;
+        // Whether the key is held down:
+        bool held = false;
+        // Whether the key has a long press deadline in the timer wheel:
+        bool scheduled = false;
+        // The key's long press deadline in microseconds:
+        uint64_t deadline = 0;
+        // The wheel slot holding the key's deadline:
+        uint8_t slot = 0;
+        // Previous and next gesture indices in the key's wheel slot, or -1:
+        int8_t previous = -1;
+        int8_t next = -1;
+    };
+    KeyState keyStates[maxGestureKeys];
+};
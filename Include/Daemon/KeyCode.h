@@ -5,6 +5,9 @@
  */
 
 #pragma once
+#include "KeyGesture.h"
+#include "EventType.h"
+#include "RepeatPolicy.h"
 #include <vector>
 #include <string>
 
@@ -13,19 +16,168 @@ namespace KeyDaemon
     namespace KeyCode
     {
         /**
-         * @brief  Parses keyboard codes from a set of command line arguments, 
-         *         returning the list of codes only when no errors or invalid
-         *         codes are encountered.
+         * @brief  Parses keyboard codes and their event type masks from a set
+         *         of command line arguments, returning the list of codes only
+         *         when no errors or invalid codes are encountered.
          *
-         * @param argc  The number of command line arguments to parse.
+         *  A key code argument may end with '/' and a decimal EventMask to
+         * select which event types are sent for that key, e.g. "30/2" to only
+         * send presses of the A key. Codes without a mask send all types.
          *
-         * @param argv  An array of arguments. All arguments from index 1 onward
-         *              must be valid key codes.
+         * @param argc        The number of command line arguments to parse.
          *
-         * @return      The sorted list of parsed codes, or an empty list if the
-         *              codes were invalid or any errors occur.
+         * @param argv        An array of arguments. All arguments from index 1
+         *                    onward must be valid key codes, or chord,
+         *                    sequence, or gesture arguments, which are
+         *                    skipped.
+         *
+         * @param eventMasks  Used to return the EventMask of each parsed
+         *                    code, in the same order as the returned codes.
+         *
+         * @return            The sorted list of parsed codes, or an empty list
+         *                    if the codes were invalid, no key codes were
+         *                    found, or any errors occur.
+         */
+        std::vector<int> parseCodes(const int argc, char** argv,
+                std::vector<EventMask>& eventMasks);
+
+        /**
+         * @brief  Checks if a command line argument describes a chord rather
+         *         than a single key code.
+         *
+         *  Chord arguments list two or more key codes separated by '+', e.g.
+         * "29+56+63" for Ctrl+Alt+F5.
+         *
+         * @param argument  The argument to check.
+         *
+         * @return          Whether the argument contains '+'.
+         */
+        bool isChordArg(const char* argument);
+
+        /**
+         * @brief  Parses all chord arguments from a set of command line
+         *         arguments, in order.
+         *
+         * @param argc    The number of command line arguments to parse.
+         *
+         * @param argv    The array of command line arguments.
+         *
+         * @param chords  Used to return the key codes in each chord.
+         *
+         * @return        Whether all chord arguments were valid. If false,
+         *                the chords list is left empty.
+         */
+        bool parseChords(const int argc, char** argv,
+                std::vector<std::vector<int>>& chords);
+
+        /**
+         * @brief  Checks if a command line argument describes a key sequence
+         *         rather than a single key code.
+         *
+         *  Sequence arguments list two or more key codes separated by ',' in
+         * the order they must be pressed, e.g. "70,2,3" for Scroll Lock, then
+         * 1, then 2.
+         *
+         * @param argument  The argument to check.
+         *
+         * @return          Whether the argument contains ','.
+         */
+        bool isSequenceArg(const char* argument);
+
+        /**
+         * @brief  Parses all sequence arguments from a set of command line
+         *         arguments, in order.
+         *
+         * @param argc       The number of command line arguments to parse.
+         *
+         * @param argv       The array of command line arguments.
+         *
+         * @param sequences  Used to return the key codes in each sequence.
+         *
+         * @return           Whether all sequence arguments were valid. If
+         *                   false, the sequences list is left empty.
+         */
+        bool parseSequences(const int argc, char** argv,
+                std::vector<std::vector<int>>& sequences);
+
+        /**
+         * @brief  Checks if a command line argument describes key gestures
+         *         rather than a single key code.
+         *
+         *  Gesture arguments hold a key code, its long press threshold, and
+         * its double tap threshold separated by ':', with thresholds in
+         * milliseconds and zero disabling a gesture, e.g. "57:600:250" for
+         * long presses and double taps of the space bar.
+         *
+         * @param argument  The argument to check.
+         *
+         * @return          Whether the argument contains ':'.
+         */
+        bool isGestureArg(const char* argument);
+
+        /**
+         * @brief  Parses all gesture arguments from a set of command line
+         *         arguments, in order.
+         *
+         * @param argc      The number of command line arguments to parse.
+         *
+         * @param argv      The array of command line arguments.
+         *
+         * @param gestures  Used to return each argument's gesture thresholds.
+         *
+         * @return          Whether all gesture arguments were valid. If false,
+         *                  the gestures list is left empty.
+         */
+        bool parseGestures(const int argc, char** argv,
+                std::vector<KeyGesture>& gestures);
+
+        /**
+         * @brief  Checks if a command line argument selects the daemon's
+         *         repeat policy rather than a single key code.
+         *
+         *  Repeat policy arguments start with "repeat=" followed by
+         * "passThrough", "suppress", "collapse", or a decimal number of
+         * repeats per second to rate-limit repeats, e.g. "repeat=10".
+         *
+         * @param argument  The argument to check.
+         *
+         * @return          Whether the argument starts with "repeat=".
+         */
+        bool isRepeatArg(const char* argument);
+
+        /**
+         * @brief  Parses the repeat policy argument from a set of command
+         *         line arguments, if one is present.
+         *
+         * @param argc    The number of command line arguments to parse.
+         *
+         * @param argv    The array of command line arguments.
+         *
+         * @param policy  Used to return the selected policy, or
+         *                RepeatPolicy::passThrough if no policy argument was
+         *                found.
+         *
+         * @param rateHz  Used to return the rateLimit repeat rate, or zero for
+         *                other policies.
+         *
+         * @return        Whether there was no more than one policy argument,
+         *                and it was valid.
+         */
+        bool parseRepeatPolicy(const int argc, char** argv,
+                RepeatPolicy& policy, unsigned int& rateHz);
+
+        /**
+         * @brief  Counts the command line arguments that should be parsed as
+         *         key codes, chords, sequences, gestures, or the repeat
+         *         policy, skipping the executable name if present.
+         *
+         * @param argc  The number of command line arguments.
+         *
+         * @param argv  The array of command line arguments.
+         *
+         * @return      The number of key code arguments.
          */
-        std::vector<int> parseCodes(const int argc, char** argv);
+        int countCodeArgs(const int argc, char** argv);
 
         /**
          * @brief  Gets a string representation of a linux key code.
@@ -0,0 +1,63 @@
+/**
+ * @file  KeyFilter.h
+ *
+ * @brief  Finds tracked key events within a buffer of keyboard input events.
+ */
+
+#pragma once
+#include "EventType.h"
+#include "KeySet.h"
+#include <linux/input.h>
+
+namespace KeyDaemon
+{
+    namespace KeyFilter
+    {
+        /**
+         * @brief  Finds the indices of all tracked key events and SYN_DROPPED
+         *         events in an input event buffer.
+         *
+         *  Events are checked in a single branch-free pass: each event's index
+         * is always written to the next open slot in hitIndices, but the hit
+         * count only advances for tracked events. This keeps the loop free of
+         * unpredictable branches when processing long bursts of input.
+         * SYN_DROPPED events are found in the same pass, so callers only need
+         * to check the type of events that were hits.
+         *
+         * @param events       The buffer of input events to check.
+         *
+         * @param eventCount   The number of events in the buffer.
+         *
+         * @param trackedKeys  The set of key codes and event types that should
+         *                     be reported. This may be a KeySet, or any other
+         *                     type with a compatible accepts() method, such
+         *                     as the compile-time BakedKeys::Set.
+         *
+         * @param hitIndices   An array with room for at least eventCount
+         *                     indices, where tracked and SYN_DROPPED event
+         *                     indices will be stored in order.
+         *
+         * @return             The number of tracked and SYN_DROPPED events
+         *                     found.
+         */
+        template <typename TrackedSet>
+        inline int findTracked(const struct input_event* events,
+                const int eventCount, const TrackedSet& trackedKeys,
+                unsigned short* hitIndices)
+        {
+            int hitCount = 0;
+            for (int i = 0; i < eventCount; i++)
+            {
+                const struct input_event& event = events[i];
+                const bool isKeyEvent = (event.type == EV_KEY);
+                const bool isTrackedEvent = trackedKeys.accepts(event.code,
+                        static_cast<unsigned int>(event.value));
+                const bool isDropEvent = (event.type == EV_SYN)
+                        & (event.code == SYN_DROPPED);
+                hitIndices[hitCount] = static_cast<unsigned short>(i);
+                hitCount += (isKeyEvent & isTrackedEvent) | isDropEvent;
+            }
+            return hitCount;
+        }
+    }
+}
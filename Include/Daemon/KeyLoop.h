@@ -7,7 +7,30 @@
 #pragma once
 #include "DaemonLoop.h"
 #include "KeyReader.h"
+#include "KeySetBuffer.h"
+#include "MultiReader.h"
+#include "MessageQueue.h"
+#include "DeviceWatcher.h"
+#include "ChordMatcher.h"
+#include "SequenceMatcher.h"
+#include "GestureDetector.h"
+#include "RepeatThrottle.h"
+#ifdef KD_MERGE_KEYBOARDS
+#include "KeyMerger.h"
+#endif
+#ifdef KD_SHM_TRANSPORT
+#include "RingWriter.h"
+#endif
+#ifdef KD_KEY_STATE
+#include "KeyStatePublisher.h"
+#endif
+#ifdef KD_CONTROL
+#include "ControlReader.h"
+#endif
 #include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
 
 namespace KeyDaemon
 {
@@ -19,11 +42,41 @@ class KeyDaemon::KeyLoop : public DaemonFramework::DaemonLoop,
 {
 public:
     /**
-     * @brief  Saves the list of tracked key codes on construction.
+     * @brief  Saves the list of tracked key codes, builds the tracked key
+     *         set, and creates the reader event file descriptor on
+     *         construction.
      *
-     * @param keyCodes  Linux keyboard input codes the KeyDaemon should monitor.
+     * @param keyCodes    Linux keyboard input codes the KeyDaemon should
+     *                    monitor.
+     *
+     * @param eventMasks  Event types to send for each key code, in the same
+     *                    order as keyCodes. Codes without a mask send all
+     *                    event types.
+     *
+     * @param chords      Key combinations the KeyDaemon should report as
+     *                    chord events. Chord keys are read from keyboards
+     *                    but only sent individually if also in keyCodes.
+     *
+     * @param sequences   Key press sequences the KeyDaemon should report as
+     *                    sequence events. Like chord keys, sequence keys are
+     *                    only sent individually if also in keyCodes.
+     *
+     * @param gestures    Long press and double tap thresholds for keys the
+     *                    KeyDaemon should send gesture events for. Repeat
+     *                    events are never sent for these keys.
+     *
+     * @param repeatPolicy  How repeat events of held keys are sent.
+     *
+     * @param repeatRateHz  Maximum repeats per second sent for each key, if
+     *                      using RepeatPolicy::rateLimit.
      */
-    KeyLoop(std::vector<int> keyCodes);
+    KeyLoop(std::vector<int> keyCodes,
+            std::vector<EventMask> eventMasks = {},
+            std::vector<std::vector<int>> chords = {},
+            std::vector<std::vector<int>> sequences = {},
+            std::vector<KeyGesture> gestures = {},
+            const RepeatPolicy repeatPolicy = RepeatPolicy::passThrough,
+            const unsigned int repeatRateHz = 0);
 
     /**
      * @brief  Ensures all key event file readers are closed and deleted on
@@ -31,38 +84,388 @@ public:
      */
     virtual ~KeyLoop();
 
+    /**
+     * @brief  Counts the distinct key codes keyboard readers need to read to
+     *         track a set of keys, chords, sequences, and gestures.
+     *
+     *  The daemon never reads more than KD_KEY_LIMIT keys, so this count is
+     * checked against the limit before any keys are read.
+     *
+     * @param keyCodes   Individually tracked key codes.
+     *
+     * @param chords     Registered chord key codes.
+     *
+     * @param sequences  Registered sequence key codes.
+     *
+     * @param gestures   Registered gesture keys.
+     *
+     * @return           The number of distinct valid key codes among all of
+     *                   them.
+     */
+    static size_t countReadKeys(const std::vector<int>& keyCodes,
+            const std::vector<std::vector<int>>& chords,
+            const std::vector<std::vector<int>>& sequences,
+            const std::vector<KeyGesture>& gestures);
+
 private:
     /**
-     * @brief  Creates KeyReader objects for all keyboard event files before
-     *         starting the daemon action loop.
+     * @brief  Starts the message writer thread and creates readers for all
+     *         keyboard event files before starting the daemon action loop.
      *
-     * @return  Zero if keyboard event files were successfully located, 
-     *          (int) KeyExitCode::missingKeyEventFiles if no event files were
-     *          found.
+     *  If no keyboards are connected but the event file directory is being
+     * watched, the daemon stays idle until a keyboard is connected.
+     *
+     * @return  Zero if keyboard event files were successfully located or can
+     *          be detected later, (int) KeyExitCode::missingKeyEventFiles if
+     *          no event files were found and keyboards can't be detected.
      */
     virtual int initLoop() override;
 
     /**
-     * @brief  Polls the list of KeyReaders, deleting any that have encountered
-     *         errors, then briefly sleeps.
+     * @brief  Removes any KeyReaders that have encountered errors, then waits
+     *         until a reader signals that it has stopped, keyboards are
+     *         connected or removed, or the parent sends a command.
      *
-     * @return  Zero if KeyReaders are still open, (int)
-     *          KeyExitCode::keyReadersStopped if all readers have been removed.
+     * @return  Zero if readers are still open or keyboards can be detected
+     *          later, (int) KeyExitCode::keyReadersStopped if all readers have
+     *          been removed and new keyboards can't be detected.
      */
     virtual int loopAction() override;
 
     /**
-     * @brief  Sends all tracked key events to the parent application.
+     * @brief  Creates readers for any keyboard event files that aren't
+     *         already being read.
+     *
+     *  If built with KD_EPOLL_READER or KD_URING_READER, a single MultiReader
+     * reads all files, and it is replaced whenever the set of files changes.
+     * If io_uring is unavailable, the KeyLoop falls back to using KeyReader
+     * objects.
+     */
+    void updateReaders();
+
+    /**
+     * @brief  Creates a MultiReader to read a set of event files, if the
+     *         daemon was built to use one.
      *
-     * @param keyCode  The code value of a tracked key that was pressed.
+     * @param eventFilePaths  The event files to read.
      *
-     * @param type     The type of key event that was detected.
+     * @return                The new MultiReader, or nullptr if KeyReader
+     *                        threads should be used instead.
+     */
+    MultiReader* createMultiReader
+    (const std::vector<std::string>& eventFilePaths);
+
+    /**
+     * @brief  Deletes all KeyReaders that stopped reading or failed.
+     */
+    void removeStoppedReaders();
+
+    /**
+     * @brief  Checks if every event passed on by readers can be sent to the
+     *         parent unchanged, so no events need to be matched or filtered.
+     *
+     * @return  Whether no chords, sequences, gestures, or repeat policy are
+     *          registered, and readers pass on exactly the event types the
+     *          parent requested.
+     */
+    bool canForwardAllEvents() const;
+
+#ifdef KD_CONTROL
+    /**
+     * @brief  Reads and applies all pending commands from the parent's
+     *         control FIFO.
      */
-    virtual void keyEvent(const int keyCode, const EventType type) override;
+    void readControlCommands();
+
+    /**
+     * @brief  Replaces the individually tracked keys, keeping all chords,
+     *         sequences, gestures, and open event files.
+     *
+     *  Event files are only searched again if keys were added, in case
+     * keyboards that were skipped because they can't send any tracked keys
+     * are needed now.
+     *
+     *  The new keys are ignored if, combined with all chord, sequence, and
+     * gesture keys, they would exceed KD_KEY_LIMIT distinct key codes.
+     *
+     * @param keyCodes    Linux keyboard input codes the KeyDaemon should
+     *                    monitor from now on.
+     *
+     * @param eventMasks  Event types to send for each key code, in the same
+     *                    order as keyCodes.
+     */
+    void replaceTrackedKeys(const std::vector<int>& keyCodes,
+            const std::vector<EventMask>& eventMasks);
+
+    /**
+     * @brief  Pauses or resumes reading key events.
+     *
+     *  Paused readers share an empty tracked key set and kernel event mask,
+     * so keyboards never wake them, while their event files stay open.
+     *
+     * @param pause  Whether reading should be paused.
+     */
+    void setPaused(const bool pause);
+
+    /**
+     * @brief  Shares a new tracked key set with all readers, and updates the
+     *         kernel event masks of their open event files.
+     *
+     * @param keys  The key set readers should use.
+     */
+    void publishKeys(const KeySet& keys);
+#endif
+
+    /**
+     * @brief  Checks if any keyboard event files are being read.
+     *
+     * @return  Whether any KeyReaders or MultiReader files remain open.
+     */
+    bool hasOpenReaders() const;
+
+    /**
+     * @brief  Queues a MessageKind::ready message once every reader created
+     *         on startup has opened its event file or stopped.
+     *
+     *  The ready message holds the number of open event files in place of a
+     * key code, and is only sent once.
+     */
+    void sendReadyMessage();
+
+    /**
+     * @brief  Queues a tracked key event to send to the parent application.
+     *
+     * @param keyCode    The code value of a tracked key that was pressed.
+     *
+     * @param type       The type of key event that was detected.
+     *
+     * @param timestamp  The CLOCK_MONOTONIC time in microseconds when the
+     *                   event occurred.
+     */
+    virtual void keyEvent(const int keyCode, const EventType type,
+            const uint64_t timestamp) override;
+
+    /**
+     * @brief  Queues a batch of tracked key events to send to the parent
+     *         application. Reader threads never wait for the parent: if the
+     *         message queue is full, its overflow policy decides which
+     *         messages are dropped.
+     *
+     *  If built with KD_KEY_STATE, the shared key state page is updated
+     * before messages are queued, so it stays accurate even if messages are
+     * dropped. If chords or sequences were registered, or readers pass on
+     * event types that weren't requested, events pass through the
+     * ChordMatcher, which adds chord events and removes events the parent
+     * didn't request, and then through the SequenceMatcher, which adds
+     * completed sequence events. Repeats of gesture keys are dropped, and
+     * other gesture key events pass through the GestureDetector, which adds
+     * double taps and schedules long presses. Key events that will be sent
+     * finally pass through the RepeatThrottle if a repeat policy is active.
+     *
+     * @param messages  The tracked key events to send, in order.
+     *
+     * @param count     The number of events in the messages array.
+     */
+    virtual void keyEvents(const KeyMessage* messages, const int count)
+        override;
+
+    /**
+     * @brief  Passes a batch of key events through the matchers and the
+     *         repeat policy, and queues the messages they produce.
+     *
+     * @param messages  The tracked key events to match, in order.
+     *
+     * @param count     The number of events in the messages array.
+     */
+    void matchKeyEvents(const KeyMessage* messages, const int count);
+
+    /**
+     * @brief  Updates key state with releases for held keys that were
+     *         removed from the tracked key set, without sending them to the
+     *         parent application.
+     *
+     *  Releases are merged with other keyboards if built with
+     * KD_MERGE_KEYBOARDS, update the key state page if built with
+     * KD_KEY_STATE, and pass through the matchers, where the ChordMatcher
+     * drops them as keys the parent doesn't track.
+     *
+     * @param reader    The KeyReader that held the keys.
+     *
+     * @param releases  Release events for each removed key.
+     *
+     * @param count     The number of events in the releases array.
+     */
+    virtual void readerKeysRemoved(const KeyReader& reader,
+            const KeyMessage* releases, const int count) override;
+
+#ifdef KD_MERGE_KEYBOARDS
+    /**
+     * @brief  Merges a batch of tracked key events from one keyboard with the
+     *         combined key state of all keyboards, and queues the events that
+     *         change it.
+     *
+     * @param reader    The KeyReader that read the events.
+     *
+     * @param messages  The tracked key events, in order.
+     *
+     * @param count     The number of events in the messages array.
+     */
+    virtual void readerKeyEvents(const KeyReader& reader,
+            const KeyMessage* messages, const int count) override;
+
+    /**
+     * @brief  Queues releases for keys that were only held by keyboards that
+     *         have been removed.
+     *
+     * @param eventFilePaths  Paths of all keyboard event files that still
+     *                        exist.
+     */
+    void releaseRemovedKeyboards
+    (const std::vector<std::string>& eventFilePaths);
+#endif
+
+    /**
+     * @brief  Runs on the writer thread, sending queued messages to the
+     *         parent application until the message queue is closed and empty.
+     */
+    void writeMessages();
+
+    /**
+     * @brief  Sends a single frame of messages to the parent application,
+     *         using one pipe write.
+     *
+     *  If built with KD_SHM_TRANSPORT and the parent created a message ring,
+     * messages are written to the ring instead of the pipe. If the ring is
+     * full, the frame is dropped, or with KD_QUEUE_POLICY=block, the writer
+     * thread waits for the parent to make room.
+     *
+     * @param messages  Queued messages, with their sequence numbers assigned.
+     *
+     * @param count     The number of messages to send, no more than
+     *                  KeyWireFormat::maxFrameMessages.
+     */
+    void sendFrame(const KeyMessage* messages, const int count);
+
+    /**
+     * @brief  Wakes the loop to remove a KeyReader that stopped reading input.
+     */
+    virtual void readerStopped() override;
+
+    /**
+     * @brief  Wakes the loop to check if the daemon is ready, if the ready
+     *         message hasn't been sent yet.
+     */
+    virtual void readerOpened() override;
+
+    /**
+     * @brief  Blocks until a KeyReader stops, keyboards are connected or
+     *         removed, the parent sends a command, a signal is received, or
+     *         the reader wait timeout period ends.
+     */
+    void waitForReaderChange();
+
+    /**
+     * @brief  Queues all long presses whose deadlines have passed, after the
+     *         gesture timer wakes the loop.
+     */
+    void sendTimedGestures();
+
+    /**
+     * @brief  Applies the repeat policy to a message, and adds whatever
+     *         should be sent in its place to the batch of matched messages.
+     *         The matchLock must be held.
+     *
+     * @param message  A message to send to the parent application.
+     */
+    void addMatchedMessage(const KeyMessage& message);
+
+    /**
+     * @brief  Queues the batch of matched messages all at once. The matchLock
+     *         must be held.
+     */
+    void queueMatchedMessages();
+
+    // Most messages the matchers and repeat policy can send for one event:
+    static const constexpr int maxMatchedMessages
+            = (ChordMatcher::maxOutputMessages
+                + SequenceMatcher::maxOutputMessages
+                + GestureDetector::maxOutputMessages)
+            * RepeatThrottle::maxOutputMessages;
 
     // All key codes tracked by the daemon:
     std::vector<int> keyCodes;
+    // Registered chords, sequences, and gestures, kept so the keys readers
+    // need can be found again when tracked keys are replaced:
+    const std::vector<std::vector<int>> chords;
+    const std::vector<std::vector<int>> sequences;
+    const std::vector<KeyGesture> gestures;
+    // Tracked key codes and the event types sent for each of them:
+    KeySet forwardedKeys;
+    // Every key code and event type that readers need to pass to the loop,
+    // including chord, sequence, and gesture keys:
+    KeySet readKeys;
+    // The key set shared with all readers for fast lookup, holding readKeys
+    // or, while reading is paused, no keys:
+    KeySetBuffer trackedKeys;
+    // Whether every event passed on by readers is sent to the parent
+    // unchanged, so no events need to be matched or filtered:
+    std::atomic<bool> forwardAllEvents;
+    // Finds registered chords within tracked key events:
+    ChordMatcher chordMatcher;
+    // Finds registered sequences within tracked key presses:
+    SequenceMatcher sequenceMatcher;
+    // Finds long presses and double taps of gesture keys:
+    GestureDetector gestureDetector;
+    // Drops, rate-limits, or collapses repeat events:
+    RepeatThrottle repeatThrottle;
+    // Ensures only one thread updates the chord and sequence matchers, the
+    // gesture detector, or the repeat throttle at a time:
+    std::mutex matchLock;
+    // Matched messages waiting to be queued together, guarded by matchLock:
+    KeyMessage matchedMessages[KD_EVENT_BUF_SIZE + maxMatchedMessages];
+    int matchedCount = 0;
     // Holds KeyReaders for each keyboard event file:
     std::vector<KeyReader*> eventFileReaders;
+    // Reads all keyboard event files, if using a single-threaded reader:
+    MultiReader* multiReader = nullptr;
+    // Sorted paths of the event files given to the MultiReader:
+    std::vector<std::string> multiReaderPaths;
+    // Whether a MultiReader is used instead of KeyReader threads:
+    bool useMultiReader;
+    // Detects keyboards being connected or removed:
+    DeviceWatcher deviceWatcher;
+    // Event file descriptor used by readers to wake the loop when they stop
+    // or open their files:
+    int readerEventFD = -1;
+    // Whether the parent was told the daemon is ready to read keys:
+    std::atomic<bool> readySent;
+    // Passes messages from reader threads to the writer thread:
+    MessageQueue messageQueue;
+    // Sends queued messages to the parent application:
+    std::thread writerThread;
+#ifdef KD_MERGE_KEYBOARDS
+    // Combines key events from all keyboards:
+    KeyMerger keyMerger;
+    // Merged key events waiting to be queued:
+    KeyMessage mergedMessages[KD_EVENT_BUF_SIZE];
+    // Ensures only one reader thread merges key events at a time:
+    std::mutex mergeLock;
+#endif
+#ifdef KD_SHM_TRANSPORT
+    // Writes messages to the parent's shared memory ring, if available:
+    RingWriter ringWriter;
+#endif
+#ifdef KD_KEY_STATE
+    // Publishes held tracked keys to the parent's key state page:
+    KeyStatePublisher keyStatePublisher;
+    // Ensures only one reader thread updates the key state page at a time:
+    std::mutex stateLock;
+#endif
+#ifdef KD_CONTROL
+    // Receives commands from the parent application:
+    ControlReader controlReader;
+    // Whether the parent paused reading key events:
+    std::atomic<bool> readingPaused;
+#endif
 
 };
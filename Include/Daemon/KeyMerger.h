@@ -0,0 +1,118 @@
+/**
+ * @file  KeyMerger.h
+ *
+ * @brief  Combines key events from every keyboard into one logical keyboard.
+ */
+
+#pragma once
+#include "KeyMessage.h"
+#include <linux/input-event-codes.h>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace KeyDaemon
+{
+    class KeyMerger;
+}
+
+/**
+ * @brief  Tracks which keyboards hold each key, and removes key events that
+ *         don't change the key's combined state.
+ *
+ *  Keyboards often expose the same key on more than one event file, and
+ * several keyboards may be connected at once. A key is pressed when any
+ * keyboard holds it, and released once no keyboard holds it, so the parent
+ * sees one press and one release no matter how many event files reported
+ * them. Repeat events are only kept from the keyboard that pressed the key
+ * first.
+ *
+ *  Keyboards are identified by their event file paths, so their held keys
+ * are kept when readers are replaced. When a keyboard is removed, any keys
+ * only it held are released. Only one thread may use the KeyMerger at a time.
+ *
+ *  Events are merged in the order they are processed. Events from different
+ * keyboards only arrive in kernel timestamp order when the daemon is built
+ * with KD_EPOLL_READER or KD_URING_READER, where a MultiReader reads every
+ * keyboard on one thread.
+ */
+class KeyDaemon::KeyMerger
+{
+public:
+    // Maximum number of keyboard event files that can be told apart. Events
+    // from additional files are passed on without merging:
+    static const constexpr int maxDevices = 64;
+
+    /**
+     * @brief  Starts with no keys held by any keyboard.
+     */
+    KeyMerger();
+
+    virtual ~KeyMerger() { }
+
+    /**
+     * @brief  Gets the index used to track a keyboard event file, assigning
+     *         a new index if the file hasn't been seen before.
+     *
+     * @param eventFilePath  The keyboard's event file path.
+     *
+     * @return               The keyboard's device index, or -1 if
+     *                       maxDevices keyboards are already tracked.
+     */
+    int getDeviceIndex(const std::string& eventFilePath);
+
+    /**
+     * @brief  Removes key events that don't change any key's combined state
+     *         from a batch of events read from one keyboard.
+     *
+     * @param deviceIndex  The index of the keyboard that sent the events, or
+     *                     -1 to pass all events on unchanged.
+     *
+     * @param messages     The keyboard's key events, in order.
+     *
+     * @param count        The number of events in the messages array.
+     *
+     * @param output       A buffer with room for count messages, used to
+     *                     return the events that should be sent.
+     *
+     * @return             The number of messages copied to the output buffer.
+     */
+    int process(const int deviceIndex, const KeyMessage* messages,
+            const int count, KeyMessage* output);
+
+    /**
+     * @brief  Stops tracking every keyboard whose event file is no longer
+     *         present, releasing keys that only those keyboards held.
+     *
+     * @param eventFilePaths  The paths of all keyboard event files that still
+     *                        exist.
+     *
+     * @param timestamp       The CLOCK_MONOTONIC time in microseconds to use
+     *                        for released keys.
+     *
+     * @return                A key release message for each key that is no
+     *                        longer held.
+     */
+    std::vector<KeyMessage> removeMissingDevices
+    (const std::vector<std::string>& eventFilePaths,
+            const uint64_t timestamp);
+
+    /**
+     * @brief  Gets the total number of key events removed because another
+     *         keyboard already pressed, held, or still holds their key.
+     *
+     * @return  The number of duplicate events removed.
+     */
+    unsigned long getDuplicateCount() const;
+
+private:
+    // Event file paths of tracked keyboards, indexed by device index. Unused
+    // indices hold empty paths:
+    std::vector<std::string> devicePaths;
+    // Bit masks of the device indices holding each key:
+    uint64_t holdingDevices[KEY_CNT] = {};
+    // Device index that pressed each held key first, and sends its repeats:
+    int8_t repeatingDevices[KEY_CNT];
+    // Total number of duplicate events removed:
+    unsigned long duplicateCount = 0;
+};
@@ -6,13 +6,17 @@
 
 #pragma once
 #include "EventType.h"
+#include "KeyMessage.h"
+#include "KeySetBuffer.h"
 #include "InputReader.h"
 #include <vector>
+#include <atomic>
 #include <linux/input.h>
 
 namespace KeyDaemon
 {
     class KeyReader;
+    class MultiReader;
 }
 
 class KeyDaemon::KeyReader : public DaemonFramework::InputReader
@@ -29,11 +33,85 @@ public:
         /**
          * @brief  Called whenever the KeyReader detects a key input event.
          *
-         * @param keyCode  The code value of a tracked key that was pressed.
+         * @param keyCode    The code value of a tracked key that was pressed.
          *
-         * @param type     The type of key event that was detected.
+         * @param type       The type of key event that was detected.
+         *
+         * @param timestamp  The CLOCK_MONOTONIC time in microseconds when the
+         *                   event occurred.
+         */
+        virtual void keyEvent(const int keyCode, const EventType type,
+                const uint64_t timestamp) = 0;
+
+        /**
+         * @brief  Called with all tracked key events found in a single read
+         *         from the KeyReader's event file.
+         *
+         *  By default, this passes each event to keyEvent in order. Listeners
+         * that can handle events together should override this.
+         *
+         * @param messages  The tracked key events, in the order they were
+         *                  read.
+         *
+         * @param count     The number of events in the messages array.
+         */
+        virtual void keyEvents(const KeyMessage* messages, const int count)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                keyEvent(messages[i].keyCode, messages[i].event,
+                        messages[i].timestamp);
+            }
+        }
+
+        /**
+         * @brief  Called by KeyReaders with all tracked key events found in
+         *         a single read, along with the reader that found them.
+         *
+         *  By default, this passes the events on to keyEvents. Listeners
+         * that need to tell keyboards apart should override this.
+         *
+         * @param reader    The KeyReader that read the events.
+         *
+         * @param messages  The tracked key events, in the order they were
+         *                  read.
+         *
+         * @param count     The number of events in the messages array.
+         */
+        virtual void readerKeyEvents(const KeyReader& reader,
+                const KeyMessage* messages, const int count)
+        {
+            keyEvents(messages, count);
+        }
+
+        /**
+         * @brief  Called by KeyReaders with releases for held keys that were
+         *         removed from the tracked key set.
+         *
+         *  These releases keep key state held outside the reader accurate,
+         * but must never be sent to the parent application, which no longer
+         * tracks the keys. By default, they are ignored.
+         *
+         * @param reader    The KeyReader that held the keys.
+         *
+         * @param releases  Release events for each removed key.
+         *
+         * @param count     The number of events in the releases array.
+         */
+        virtual void readerKeysRemoved(const KeyReader& reader,
+                const KeyMessage* releases, const int count) { }
+
+        /**
+         * @brief  Called when a KeyReader stops reading input because its file
+         *         was closed or could not be read.
+         */
+        virtual void readerStopped() { }
+
+        /**
+         * @brief  Called when a KeyReader opens its event file and is ready
+         *         to read key events.
          */
-        virtual void keyEvent(const int keyCode, const EventType type) = 0;
+        virtual void readerOpened() { }
     };
 
     /**
@@ -42,18 +120,59 @@ public:
      *
      * @param eventFilePath  The path to the keyboard's input event file.
      *
-     * @param keyCodes       A list of all key event codes that the KeyReader
-     *                       should report.
+     * @param trackedKeys    The set of all key event codes that the KeyReader
+     *                       should report. This set must remain valid for
+     *                       the lifetime of the KeyReader, and may be
+     *                       replaced while the KeyReader is reading.
      *
      * @param listener       The object that will handle relevant keyboard
      *                       events.
+     *
+     * @param startThread    Whether the KeyReader should immediately start
+     *                       its own input thread. KeyReaders owned by a
+     *                       MultiReader don't run their own threads.
      */
-    KeyReader(const char* eventFilePath, const std::vector<int>& keyCodes,
-            Listener* listener);
+    KeyReader(const char* eventFilePath, const KeySetBuffer& trackedKeys,
+            Listener* listener, const bool startThread = true);
 
     virtual ~KeyReader() { }
 
+    /**
+     * @brief  Updates the kernel event mask of the open event file after the
+     *         tracked key set is replaced.
+     *
+     *  This may be called from any thread. Key state is checked again the
+     * next time the KeyReader reads input, so tracked keys that changed state
+     * while they weren't being read are reported.
+     *
+     * @return  Whether an event file is open and its kernel event mask was
+     *          updated.
+     */
+    bool updateEventMask();
+
+    /**
+     * @brief  Checks if the KeyReader has permanently stopped reading input.
+     *
+     *  This may become true slightly before the InputReader state changes to
+     * closed or failed.
+     *
+     * @return  Whether the event file failed to open or could not be read.
+     */
+    bool hasStopped() const;
+
+    /**
+     * @brief  Checks if the KeyReader opened its event file.
+     *
+     * @return  Whether the event file was opened and is ready to read, even if
+     *          the reader later stopped.
+     */
+    bool hasOpened() const;
+
 private:
+    // MultiReader objects open files and process input on the KeyReader's
+    // behalf:
+    friend class KeyDaemon::MultiReader;
+
     /**
      * @brief  Opens the input file, handling errors and using appropriate 
      *         file reading options.
@@ -63,6 +182,76 @@ private:
      */
     virtual int openFile() override;
 
+    /**
+     * @brief  Asks the kernel to only report tracked key events and
+     *         synchronization events from the event file, so that the reader
+     *         isn't woken by untracked keys or other event types the device
+     *         supports.
+     *
+     *  If the kernel doesn't support EVIOCSMASK, all events are still filtered
+     * normally in processInput.
+     *
+     * @param fileDescriptor  The opened keyboard event file descriptor.
+     *
+     * @return                Whether the kernel event mask was installed.
+     */
+    bool installEventMask(const int fileDescriptor);
+
+    /**
+     * @brief  Asks the kernel to timestamp input events using CLOCK_MONOTONIC
+     *         instead of CLOCK_REALTIME.
+     *
+     *  If the kernel rejects the request, events are timestamped with the
+     * monotonic clock when they are read instead.
+     *
+     * @param fileDescriptor  The opened keyboard event file descriptor.
+     *
+     * @return                Whether kernel timestamps will use
+     *                        CLOCK_MONOTONIC.
+     */
+    bool useMonotonicClock(const int fileDescriptor);
+
+    /**
+     * @brief  Asks the kernel which keys the keyboard is holding, and reports
+     *         each tracked key whose state differs from the state the
+     *         KeyReader last reported.
+     *
+     *  This runs when the event file is opened, so keys held before the
+     * daemon started are reported, after the kernel drops events, and after
+     * the tracked key set is replaced. Only event types the tracked key set
+     * accepts are reported. Held keys that are no longer tracked are passed
+     * to the listener's readerKeysRemoved as releases instead. If the kernel
+     * can't report key state, no other keys are reported.
+     */
+    void syncKeyState();
+
+    /**
+     * @brief  Filters and reports a range of input events from the input
+     *         buffer, stopping early after a SYN_DROPPED event.
+     *
+     * @param startIndex  The index of the first event to process.
+     *
+     * @param endIndex    The index after the last event to process.
+     *
+     * @return            The index after the last event processed. If a
+     *                    SYN_DROPPED event was found, this is the index after
+     *                    it, and resyncPending is set.
+     */
+    int processEvents(const int startIndex, const int endIndex);
+
+    /**
+     * @brief  Processes a range of input events already read into the input
+     *         buffer, resyncing key state when needed.
+     *
+     *  MultiReader objects use this to interleave input from several event
+     * files.
+     *
+     * @param startIndex  The index of the first event to process.
+     *
+     * @param endIndex    The index after the last event to process.
+     */
+    void processEventRange(const int startIndex, const int endIndex);
+
     /**
      * @brief  Processes new input from the input file.
      *
@@ -91,12 +280,37 @@ private:
      */
     virtual void* getBuffer() override;
 
-    // List of relevant key codes to report:
-    const std::vector<int>& trackedCodes;
+    // Set of relevant key codes to report:
+    const KeySetBuffer& trackedKeys;
+    // Tracked key set generation used when key state was last checked:
+    unsigned int keyGeneration = 0;
     // Handles reported keyboard events:
     Listener* listener = nullptr;
+    // Set when the event file fails to open or can no longer be read:
+    std::atomic<bool> inputStopped;
+    // Set once the event file is open and ready to read:
+    std::atomic<bool> fileOpened;
+    // Whether kernel event timestamps use CLOCK_MONOTONIC:
+    bool kernelMonotonicTime = false;
+    // The open event file descriptor, or -1:
+    std::atomic<int> eventFileDescriptor;
+    // Whether the kernel dropped events, so input is ignored until the next
+    // SYN_REPORT, when key state is read again:
+    bool resyncPending = false;
+    // Number of words in the key state bitmap:
+    static const constexpr int keyWordCount = KeySet::getBitmapSize()
+            / sizeof(unsigned long);
+    // Tracked keys the KeyReader last reported as held, using the same
+    // layout as the kernel's key state bitmap:
+    unsigned long heldKeys[keyWordCount] = {};
     // Maximum number of events that can be buffered at once:
-    static const constexpr int eventBufSize = 16;
+    static const constexpr int eventBufSize = KD_EVENT_BUF_SIZE;
+    static_assert(eventBufSize > 0 && eventBufSize <= 65536,
+            "KD_EVENT_BUF_SIZE must be between 1 and 65536.");
     // Keyboard event input buffer:
     struct input_event eventBuffer[eventBufSize];
+    // Indices of tracked events found in the input buffer:
+    unsigned short trackedIndices[eventBufSize];
+    // Tracked events from the input buffer, to be sent to the listener:
+    KeyMessage trackedMessages[eventBufSize];
 };
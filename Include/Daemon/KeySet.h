@@ -0,0 +1,116 @@
+/**
+ * @file  KeySet.h
+ *
+ * @brief  Stores a set of tracked key codes as a fixed-size bitmap, along with
+ *         the event types tracked for each code.
+ */
+
+#pragma once
+#include "EventType.h"
+#include <vector>
+#include <cstdint>
+#include <linux/input-event-codes.h>
+
+namespace KeyDaemon
+{
+    class KeySet;
+}
+
+/**
+ * @brief  A read-only set of key codes that can be checked in constant time.
+ *
+ *  The KeySet holds one bit for every possible Linux key code, stored using
+ * the same bitmap layout as the kernel's input event masks. It also holds an
+ * EventMask for every key code, so that checking both an event's code and its
+ * type takes a single table lookup.
+ */
+class KeyDaemon::KeySet
+{
+public:
+    /**
+     * @brief  Builds the key bitmap and event type table on construction.
+     *
+     * @param keyCodes    All key codes that should be included in the set.
+     *                    Codes outside of the valid key code range are
+     *                    ignored.
+     *
+     * @param eventMasks  Event types tracked for each key code, in the same
+     *                    order as keyCodes. Codes without a mask track all
+     *                    event types. If a code is listed more than once,
+     *                    its masks are combined. Codes with empty masks
+     *                    aren't included in the set.
+     */
+    KeySet(const std::vector<int>& keyCodes,
+            const std::vector<EventMask>& eventMasks = {});
+
+    /**
+     * @brief  Checks if a key code is in the set.
+     *
+     * @param keyCode  The code to find.
+     *
+     * @return         Whether the code is in the set.
+     */
+    inline bool contains(const unsigned int keyCode) const
+    {
+        return keyCode < KEY_CNT
+            && ((bitmap[keyCode / wordBits] >> (keyCode % wordBits)) & 1);
+    }
+
+    /**
+     * @brief  Checks if a key event should be tracked, using both its code
+     *         and its event type.
+     *
+     * @param keyCode    The event's key code.
+     *
+     * @param eventType  The event's value, which may be outside the range of
+     *                   tracked EventTypes.
+     *
+     * @return           Whether the code is in the set and the event type is
+     *                   tracked for that code.
+     */
+    inline bool accepts(const unsigned int keyCode,
+            const unsigned int eventType) const
+    {
+        return keyCode < KEY_CNT && eventType
+                < static_cast<unsigned int>(EventType::trackedTypeCount)
+            && ((eventMasks[keyCode] >> eventType) & 1);
+    }
+
+    /**
+     * @brief  Gets the event types tracked for a key code.
+     *
+     * @param keyCode  The code to check.
+     *
+     * @return         The code's EventMask, or zero if the code isn't in the
+     *                 set.
+     */
+    EventMask getEventMask(const unsigned int keyCode) const;
+
+    /**
+     * @brief  Gets the set's bitmap data.
+     *
+     * @return  A bitmap with one bit set for each key code in the set.
+     */
+    const unsigned long* getBitmap() const;
+
+    /**
+     * @brief  Gets the size of the set's bitmap data.
+     *
+     * @return  The size in bytes of the array returned by getBitmap().
+     */
+    static constexpr unsigned int getBitmapSize()
+    {
+        return sizeof(unsigned long) * wordCount;
+    }
+
+private:
+    // Number of bits stored in each bitmap word:
+    static const constexpr unsigned int wordBits = sizeof(unsigned long) * 8;
+    // Number of words needed to hold one bit for each key code:
+    static const constexpr unsigned int wordCount
+            = (KEY_CNT + wordBits - 1) / wordBits;
+    // Key code bitmap:
+    unsigned long bitmap[wordCount] = {};
+    // Event types tracked for each key code:
+    uint8_t eventMasks[KEY_CNT] = {};
+};
@@ -0,0 +1,103 @@
+/**
+ * @file  KeySetBuffer.h
+ *
+ * @brief  Holds the tracked KeySet shared by all keyboard readers, so that it
+ *         can be replaced while they are reading.
+ */
+
+#pragma once
+#include "KeySet.h"
+#include <atomic>
+
+namespace KeyDaemon
+{
+    class KeySetBuffer;
+}
+
+/**
+ * @brief  A double-buffered KeySet that a single thread can replace without
+ *         making readers wait.
+ *
+ *  New sets are copied into the inactive buffer, which becomes active once
+ * it is complete. Updates are tracked with a seqlock sequence value that is
+ * odd while the inactive buffer is being written, and increases by two with
+ * each completed update. A reader takes the sequence value when it starts
+ * using the active set, and checks if it changed when it is done. Only a
+ * second replacement can overwrite the set a reader is using, so readers only
+ * need to retry if the tracked keys changed while they were checking events.
+ */
+class KeyDaemon::KeySetBuffer
+{
+public:
+    /**
+     * @brief  Copies the initial tracked key set on construction.
+     *
+     * @param keys  The set readers should use until it is replaced.
+     */
+    KeySetBuffer(const KeySet& keys);
+
+    virtual ~KeySetBuffer() { }
+
+    /**
+     * @brief  Gets the active key set, to be used until changedSince shows
+     *         that it was replaced.
+     *
+     * @param generation  Used to return the sequence value, which must be
+     *                    passed to changedSince once the set is no longer
+     *                    needed.
+     *
+     * @return            The active key set.
+     */
+    inline const KeySet& read(unsigned int& generation) const
+    {
+        generation = sequence.load(std::memory_order_acquire);
+        return sets[(generation / 2) & 1];
+    }
+
+    /**
+     * @brief  Checks if the key set was replaced after it was read.
+     *
+     * @param generation  The sequence value returned when the set was read.
+     *
+     * @return            Whether the set changed. If true, anything found
+     *                    using the set should be found again.
+     */
+    inline bool changedSince(const unsigned int generation) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return sequence.load(std::memory_order_relaxed) != generation;
+    }
+
+    /**
+     * @brief  Gets the current sequence value without reading the set.
+     *
+     * @return  A value that changes each time the set is replaced.
+     */
+    inline unsigned int getGeneration() const
+    {
+        return sequence.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief  Copies a consistent snapshot of the active key set, for uses
+     *         that can't be repeated if the set changes.
+     *
+     * @param generation  Used to return the sequence value of the copied set.
+     *
+     * @return            A copy of the active key set.
+     */
+    KeySet copy(unsigned int& generation) const;
+
+    /**
+     * @brief  Replaces the active key set. Only one thread may replace sets.
+     *
+     * @param keys  The set readers should use from now on.
+     */
+    void replace(const KeySet& keys);
+
+private:
+    // The active set, and the set used for the next replacement:
+    KeySet sets[2];
+    // Seqlock sequence value, odd while a replacement is being written:
+    std::atomic<unsigned int> sequence;
+};
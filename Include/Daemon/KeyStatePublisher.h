@@ -0,0 +1,61 @@
+/**
+ * @file  KeyStatePublisher.h
+ *
+ * @brief  Publishes the set of held tracked keys to the parent application's
+ *         shared key state page.
+ */
+
+#pragma once
+#include "KeyStatePage.h"
+#include "KeyMessage.h"
+
+namespace KeyDaemon
+{
+    class KeyStatePublisher;
+}
+
+/**
+ * @brief  The writer side of the shared key state page.
+ *
+ *  Only one thread may update the page at a time.
+ */
+class KeyDaemon::KeyStatePublisher
+{
+public:
+    /**
+     * @brief  Opens and maps the key state page on construction.
+     *
+     * @param pagePath  The path to the key state page created by the parent.
+     */
+    KeyStatePublisher(const char* pagePath);
+
+    /**
+     * @brief  Unmaps the key state page on destruction.
+     */
+    virtual ~KeyStatePublisher();
+
+    /**
+     * @brief  Checks if the key state page was successfully opened and
+     *         mapped.
+     *
+     * @return  Whether key state updates can be published.
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief  Applies a batch of key events to the published key state.
+     *
+     *  All events are applied in a single seqlock update. If none of the
+     * events change whether a key is held, the page and its generation number
+     * are left unchanged.
+     *
+     * @param messages  The key events to apply, in order.
+     *
+     * @param count     The number of events in the messages array.
+     */
+    void update(const KeyMessage* messages, const int count);
+
+private:
+    // The mapped key state page:
+    KeyStatePage::Page* page = nullptr;
+};
@@ -0,0 +1,105 @@
+/**
+ * @file  KeyStats.h
+ *
+ * @brief  Provides performance counters that are removed from builds without
+ *         KD_STATS enabled.
+ */
+
+#pragma once
+#ifdef KD_STATS
+
+namespace KeyDaemon
+{
+    namespace KeyStats
+    {
+        /**
+         * @brief  All tracked performance counters.
+         */
+        enum class Counter
+        {
+            // Times the KeyLoop woke up to check on its readers:
+            loopWakeups,
+            // Loop wakeups that found no change in reader state:
+            idleWakeups,
+            // Event files where the kernel filters out untracked events. The
+            // kernel doesn't report how many events it discards, so this
+            // counts files rather than events:
+            kernelFilteredFiles,
+            // Input events read and then discarded by KeyReader filtering:
+            userFilteredEvents,
+            // Input events passed on to the KeyReader's Listener:
+            trackedEvents,
+            // Message frames written to the parent application:
+            parentWrites,
+            // Messages dropped because the shared memory ring was full:
+            droppedMessages,
+            // Messages discarded by the message queue's overflow policy:
+            queueDrops,
+            // Times a reader thread waited for space in a full message queue:
+            blockedPushes,
+            // Largest number of messages held in the message queue at once.
+            // This is a peak value, not a running total:
+            peakQueueDepth,
+            // Keyboard devices ignored because they can't emit tracked keys,
+            // counted each time event files are searched:
+            skippedDevices,
+            // Key repeat events withheld from the parent because their keys
+            // send gesture events instead, or the repeat policy dropped
+            // them:
+            suppressedRepeats,
+            // Key events dropped because another keyboard already sent the
+            // same key state:
+            mergedDuplicates,
+            // SYN_DROPPED events that made a reader resync its key state:
+            droppedInputEvents,
+            counterCount
+        };
+
+        /**
+         * @brief  Adds to one of the daemon's performance counters.
+         *
+         * @param counter  The counter to update.
+         *
+         * @param amount   The amount to add to the counter.
+         */
+        void add(const Counter counter, const unsigned long amount);
+
+        /**
+         * @brief  Raises one of the daemon's performance counters to a new
+         *         value, if the value is larger than the current count.
+         *
+         * @param counter  The counter to update.
+         *
+         * @param value    The new peak value to record.
+         */
+        void raise(const Counter counter, const unsigned long value);
+
+        /**
+         * @brief  Prints all counter values to stderr, along with their
+         *         average rate per second since the daemon started.
+         */
+        void printAll();
+    }
+}
+
+// Adds an amount to a performance counter:
+#   define STAT_ADD(counter, amount) KeyDaemon::KeyStats::add( \
+        KeyDaemon::KeyStats::Counter::counter, amount);
+
+// Increments a performance counter:
+#   define STAT_INC(counter) STAT_ADD(counter, 1)
+
+// Raises a peak value counter:
+#   define STAT_MAX(counter, value) KeyDaemon::KeyStats::raise( \
+        KeyDaemon::KeyStats::Counter::counter, value);
+
+// Prints all performance counters:
+#   define STAT_PRINT() KeyDaemon::KeyStats::printAll();
+
+// Redefine stats macros as empty statements outside of stats builds:
+#else
+#   define STAT_ADD(counter, amount)
+#   define STAT_INC(counter)
+#   define STAT_MAX(counter, value)
+#   define STAT_PRINT()
+#endif
@@ -0,0 +1,278 @@
+/**
+ * @file  MessageQueue.h
+ *
+ * @brief  A bounded lock-free queue that passes key event messages from
+ *         reader threads to the KeyLoop's writer thread.
+ */
+
+#pragma once
+#include "KeyMessage.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+namespace KeyDaemon
+{
+    class MessageQueue;
+}
+
+/**
+ * @brief  A bounded multi-producer, single-consumer queue of key messages.
+ *
+ *  Pushing and popping messages never takes a lock. Locks are only used to
+ * sleep while the queue is empty, or while the queue is full under the block
+ * overflow policy.
+ *
+ *  Each message pushed is assigned a transport sequence number from its
+ * position in the queue, plus the number of key repeats dropped before they
+ * could be queued. Numbers for dropped repeats are reserved together with
+ * the queue positions of the messages pushed after them, so every dropped
+ * message leaves a gap in sequence numbers where it was dropped, which the
+ * parent application can detect.
+ */
+class KeyDaemon::MessageQueue
+{
+public:
+    // Number of messages the queue can hold:
+    static const constexpr size_t capacity = KD_QUEUE_SIZE;
+
+    static_assert(capacity > 1 && (capacity & (capacity - 1)) == 0,
+            "KD_QUEUE_SIZE must be a power of two.");
+
+    // Largest number of messages a batch push adds at once:
+    static const constexpr int maxBatchSize
+            = (capacity >= 8) ? static_cast<int>(capacity / 4) : 1;
+
+    /**
+     * @brief  Ways the queue can handle new messages when it is full.
+     */
+    enum class OverflowPolicy
+    {
+        // Wait for the writer thread to make room:
+        block,
+        // Discard the oldest queued messages to make room:
+        dropOldest,
+        // Discard new key repeat messages once the queue is three quarters
+        // full, keeping the remaining space for key presses and releases.
+        // If the queue still fills, discard the oldest queued messages:
+        dropRepeats
+    };
+
+    /**
+     * @brief  Prepares an empty queue on construction.
+     *
+     * @param policy  How the queue should handle new messages when full.
+     */
+    MessageQueue(const OverflowPolicy policy);
+
+    virtual ~MessageQueue() { }
+
+    /**
+     * @brief  Adds a message to the end of the queue, applying the overflow
+     *         policy if the queue is full. This may be called from any
+     *         number of threads at once.
+     *
+     * @param message  The message to add. Its sequence value is replaced.
+     *
+     * @return         Whether the message was added. This is false if the
+     *                 message was dropped or the queue was closed.
+     */
+    bool push(const KeyMessage& message);
+
+    /**
+     * @brief  Adds several messages to the end of the queue at once, applying
+     *         the overflow policy if the queue can't hold them. This may be
+     *         called from any number of threads at once.
+     *
+     *  The writer thread can't pop any message in the batch until all of them
+     * are queued, so messages read together are sent in the same frame.
+     * Batches larger than maxBatchSize, or split by key repeats the overflow
+     * policy drops, are added in parts.
+     *
+     * @param messages  The messages to add. Their sequence values are
+     *                  replaced.
+     *
+     * @param count     The number of messages to add.
+     *
+     * @return          The number of messages added.
+     */
+    int push(const KeyMessage* messages, const int count);
+
+    /**
+     * @brief  Removes the oldest message from the queue, if any. Only the
+     *         writer thread may call this.
+     *
+     * @param message  Used to return the removed message.
+     *
+     * @return         Whether a message was removed.
+     */
+    bool pop(KeyMessage& message);
+
+    /**
+     * @brief  Blocks the writer thread until messages are available, the
+     *         queue is closed, or the timeout period ends.
+     *
+     * @param timeoutMS  Maximum time to wait in milliseconds, or -1 to wait
+     *                   until messages are pushed or the queue is closed.
+     */
+    void waitForMessages(const int timeoutMS = -1);
+
+    /**
+     * @brief  Closes the queue, rejecting new messages and waking all
+     *         waiting threads. Messages already queued can still be popped.
+     */
+    void close();
+
+    /**
+     * @brief  Checks if the queue has been closed.
+     *
+     * @return  Whether close has been called.
+     */
+    bool isClosed() const;
+
+    /**
+     * @brief  Gets the approximate number of queued messages.
+     *
+     * @return  The number of messages pushed but not yet popped.
+     */
+    size_t getDepth() const;
+
+    /**
+     * @brief  Gets the largest number of messages held in the queue at once.
+     *
+     * @return  The queue's peak depth.
+     */
+    size_t getPeakDepth() const;
+
+    /**
+     * @brief  Gets the number of messages discarded by the overflow policy or
+     *         rejected because the queue was closed.
+     *
+     * @return  The total number of dropped messages.
+     */
+    unsigned long getDropCount() const;
+
+private:
+    /**
+     * @brief  Checks if the overflow policy drops a message before it is
+     *         queued.
+     *
+     * @param message  A message about to be added.
+     *
+     * @return         Whether the message should be dropped.
+     */
+    bool isDroppedRepeat(const KeyMessage& message) const;
+
+    /**
+     * @brief  Adds a run of messages at once, applying the overflow policy
+     *         until the queue has room for all of them.
+     *
+     * @param messages  The messages to add.
+     *
+     * @param count     The number of messages to add, no more than
+     *                  maxBatchSize.
+     *
+     * @param skipped   The number of key repeats dropped directly before the
+     *                  run, whose sequence numbers are skipped.
+     *
+     * @return          The number of messages added, either count or zero.
+     */
+    int pushRun(const KeyMessage* messages, const int count,
+            const unsigned int skipped);
+
+    /**
+     * @brief  Adds a run of messages if the queue has room for all of them.
+     *
+     *  Messages are published last to first, so the writer thread finds none
+     * of them until the first is published with the rest.
+     *
+     * @param messages  The messages to add.
+     *
+     * @param count     The number of messages to add, no more than
+     *                  maxBatchSize.
+     *
+     * @param skipped   The number of sequence numbers to skip before the
+     *                  run.
+     *
+     * @return          Whether the messages were added.
+     */
+    bool tryPush(const KeyMessage* messages, const int count,
+            const unsigned int skipped);
+
+    /**
+     * @brief  Removes the oldest message if the queue isn't empty. Unlike
+     *         pop, this is safe to call from producer threads.
+     *
+     * @param message  Used to return the removed message.
+     *
+     * @return         Whether a message was removed.
+     */
+    bool tryPop(KeyMessage& message);
+
+    /**
+     * @brief  Blocks a producer thread until the queue has room, the queue is
+     *         closed, or the timeout period ends.
+     *
+     * @param count      The number of messages the queue needs room for.
+     *
+     * @param timeoutMS  Maximum time to wait in milliseconds.
+     */
+    void waitForSpace(const int count, const int timeoutMS);
+
+    /**
+     * @brief  Wakes the writer thread if it is waiting for messages.
+     */
+    void wakeConsumer();
+
+    /**
+     * @brief  Wakes producer threads waiting for space, if any.
+     */
+    void wakeProducers();
+
+    // Size of the cache lines used to separate queue positions:
+    static const constexpr size_t cacheLineSize = 64;
+
+    /**
+     * @brief  A single queue slot.
+     */
+    struct Cell
+    {
+        // Queue position the cell is ready for. A producer may write the cell
+        // when this equals its push position, and the consumer may read it
+        // when this is one past its pop position:
+        std::atomic<size_t> position;
+        // The queued message:
+        KeyMessage message;
+    };
+
+    // How full messages are handled:
+    const OverflowPolicy policy;
+    // All queue slots:
+    Cell cells[capacity];
+    // Bits of pushState holding the push position. The remaining high bits
+    // count dropped repeats, and only need to wrap at a multiple of the
+    // sequence numbers sent to the parent:
+    static const constexpr int positionBits = (sizeof(size_t) >= 8) ? 40 : 32;
+    static const constexpr uint64_t positionMask
+            = (uint64_t(1) << positionBits) - 1;
+    // Position of the next message to push, and the number of key repeats
+    // dropped before they were queued, updated together:
+    alignas(cacheLineSize) std::atomic<uint64_t> pushState;
+    // Position of the next message to pop:
+    alignas(cacheLineSize) std::atomic<size_t> popPosition;
+    // Counters, kept away from the positions updated on every message:
+    alignas(cacheLineSize) std::atomic<size_t> peakDepth;
+    std::atomic<unsigned long> dropCount;
+    // Set once the queue is closed:
+    std::atomic<bool> closed;
+    // Set while the writer thread is preparing to sleep or sleeping:
+    std::atomic<bool> consumerWaiting;
+    // Number of producers preparing to sleep or sleeping:
+    std::atomic<int> producersWaiting;
+    // Used with the condition variables to sleep and wake threads:
+    std::mutex waitLock;
+    std::condition_variable messagesAvailable;
+    std::condition_variable spaceAvailable;
+};
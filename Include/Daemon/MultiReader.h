@@ -0,0 +1,177 @@
+/**
+ * @file  MultiReader.h
+ *
+ * @brief  Reads key events from every keyboard event file on a single thread.
+ */
+
+#pragma once
+#include "KeyReader.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+
+namespace KeyDaemon
+{
+    class MultiReader;
+}
+
+/**
+ * @brief  An abstract alternative to running one KeyReader thread per event
+ *         file.
+ *
+ *  The MultiReader creates KeyReader objects without starting their input
+ * threads, opens all of their event files, and leaves it to the inheriting
+ * class to wait for and read input from all files on a single thread. Input is
+ * still passed through each KeyReader's normal event filtering before it
+ * reaches the Listener. When several files are read at once, their events are
+ * merged in kernel timestamp order.
+ */
+class KeyDaemon::MultiReader
+{
+public:
+    /**
+     * @brief  Opens all event files on construction.
+     *
+     * @param eventFilePaths  Paths to all keyboard input event files that
+     *                        should be read.
+     *
+     * @param trackedKeys     The set of all key event codes that should be
+     *                        reported.
+     *
+     * @param listener        The object that will handle relevant keyboard
+     *                        events.
+     */
+    MultiReader(const std::vector<std::string>& eventFilePaths,
+            const KeySetBuffer& trackedKeys, KeyReader::Listener* listener);
+
+    /**
+     * @brief  Closes all event files on destruction. Inheriting classes must
+     *         call stopThread() in their destructors.
+     */
+    virtual ~MultiReader();
+
+    /**
+     * @brief  Gets the number of event files that are still open for reading.
+     *
+     * @return  The open event file count. Once this reaches zero, no more key
+     *          events will be read.
+     */
+    int getOpenFileCount() const;
+
+    /**
+     * @brief  Updates the kernel event masks of all open event files after
+     *         the tracked key set is replaced.
+     */
+    void updateEventMasks();
+
+protected:
+    // Input read from an event file that hasn't been processed yet:
+    struct PendingInput
+    {
+        // The index of the event file that was read:
+        size_t fileIndex;
+        // The number of bytes read into the file's buffer:
+        int inputBytes;
+        // The index of the first event processInputs hasn't passed on yet:
+        int nextEvent;
+    };
+
+    /**
+     * @brief  Starts the read thread, if any event files were opened.
+     */
+    void startThread();
+
+    /**
+     * @brief  Signals the read thread to exit, and waits for it to finish.
+     */
+    void stopThread();
+
+    /**
+     * @brief  Gets the number of event files the MultiReader opened, including
+     *         files that have since been closed.
+     *
+     * @return  The number of valid file indices.
+     */
+    size_t getFileCount() const;
+
+    /**
+     * @brief  Gets the descriptor of an event file.
+     *
+     * @param fileIndex  The index of an opened event file.
+     *
+     * @return           The file descriptor, or -1 if the file was closed.
+     */
+    int getFileDescriptor(const size_t fileIndex) const;
+
+    /**
+     * @brief  Gets the buffer where input from an event file should be read.
+     *
+     * @param fileIndex  The index of an opened event file.
+     *
+     * @return           The input buffer of the file's KeyReader.
+     */
+    void* getBuffer(const size_t fileIndex);
+
+    /**
+     * @brief  Gets the size in bytes of each event file input buffer.
+     *
+     * @return  The number of bytes available for each input read.
+     */
+    int getBufferSize() const;
+
+    /**
+     * @brief  Passes new input from an event file to its KeyReader.
+     *
+     * @param fileIndex   The index of the event file that was read.
+     *
+     * @param inputBytes  The number of bytes read into the file's buffer.
+     */
+    void processInput(const size_t fileIndex, const int inputBytes);
+
+    /**
+     * @brief  Passes new input from several event files to their KeyReaders,
+     *         merging their events in kernel timestamp order.
+     *
+     *  Each file's input report is passed on whole, and consecutive reports
+     * from the same file are passed on together until another file has an
+     * earlier event.
+     *
+     * @param inputs  Input read from distinct event files. The nextEvent
+     *                field of each input is used while merging.
+     *
+     * @param count   The number of inputs in the array.
+     */
+    void processInputs(PendingInput* inputs, const int count);
+
+    /**
+     * @brief  Closes an event file after it is removed or encounters an
+     *         error, and notifies the listener that the file was closed.
+     *
+     * @param fileIndex  The index of the event file to close.
+     */
+    virtual void closeFile(const size_t fileIndex);
+
+private:
+    /**
+     * @brief  Waits for and reads input from all open event files until
+     *         stopThread() is called or all files are closed.
+     */
+    virtual void readLoop() = 0;
+
+    /**
+     * @brief  Wakes the read thread from any blocking wait so it can exit.
+     */
+    virtual void signalStop() = 0;
+
+    // Holds one unthreaded KeyReader for each event file:
+    std::vector<KeyReader*> readers;
+    // Event file descriptors, using the same order as the readers list:
+    std::vector<int> fileDescriptors;
+    // Number of event files that are still open:
+    std::atomic<int> openFileCount;
+    // Notified whenever an event file is closed:
+    KeyReader::Listener* listener = nullptr;
+    // The single thread that reads all event files:
+    std::thread readThread;
+};
@@ -0,0 +1,96 @@
+/**
+ * @file  RepeatThrottle.h
+ *
+ * @brief  Applies the daemon's repeat policy to key repeat events before
+ *         they are sent to the parent.
+ */
+
+#pragma once
+#include "KeyMessage.h"
+#include "RepeatPolicy.h"
+#include <linux/input-event-codes.h>
+#include <cstdint>
+
+namespace KeyDaemon
+{
+    class RepeatThrottle;
+}
+
+/**
+ * @brief  Drops, rate-limits, or collapses repeat events for held keys
+ *         according to a single policy chosen at launch.
+ *
+ *  RepeatPolicy::rateLimit sends a key's repeat event only if no repeat of
+ * the same key was sent within the rate's interval, measured using event
+ * timestamps. RepeatPolicy::collapse sends only the first repeat of each held
+ * key, and when the key is released sends a MessageKind::repeatCount message
+ * holding the number of repeats received just before the release. Only one
+ * thread may process events at a time.
+ */
+class KeyDaemon::RepeatThrottle
+{
+public:
+    // Maximum number of messages produced by a single key event:
+    static const constexpr int maxOutputMessages = 2;
+
+    // Largest allowed rateLimit repeat rate, in repeats per second:
+    static const constexpr unsigned int maxRateHz = 1000;
+
+    // Largest repeat count sent in a repeatCount message. Larger counts are
+    // reduced to this value so they fit in the key code field:
+    static const constexpr unsigned int maxRepeatCount = 1023;
+
+    /**
+     * @brief  Saves the repeat policy on construction.
+     *
+     * @param policy  How repeat events should be handled.
+     *
+     * @param rateHz  Maximum repeats per second sent for each key when using
+     *                RepeatPolicy::rateLimit. Values outside of
+     *                1 to maxRateHz disable rate limiting.
+     */
+    RepeatThrottle(const RepeatPolicy policy, const unsigned int rateHz);
+
+    virtual ~RepeatThrottle() { }
+
+    /**
+     * @brief  Checks if key events need to pass through the RepeatThrottle.
+     *
+     * @return  Whether the policy is anything other than passThrough.
+     */
+    bool isActive() const;
+
+    /**
+     * @brief  Applies the repeat policy to a key event that would otherwise
+     *         be sent to the parent.
+     *
+     * @param message  A key event with MessageKind::key.
+     *
+     * @param output   A buffer with room for maxOutputMessages messages, used
+     *                 to return the messages that should be sent in place of
+     *                 the event.
+     *
+     * @return         The number of messages copied to the output buffer.
+     */
+    int process(const KeyMessage& message, KeyMessage* output);
+
+    /**
+     * @brief  Gets the total number of repeat events the policy has kept
+     *         from the parent.
+     *
+     * @return  The number of suppressed repeat events.
+     */
+    unsigned long getSuppressedCount() const;
+
+private:
+    // How repeat events are handled:
+    RepeatPolicy policy;
+    // Minimum time in microseconds between repeats sent for a single key:
+    uint64_t intervalUS = 0;
+    // Time in microseconds of the last repeat sent for each key:
+    uint64_t lastRepeatTimes[KEY_CNT] = {};
+    // Number of repeats received for each key since it was last pressed:
+    uint32_t repeatCounts[KEY_CNT] = {};
+    // Total number of repeat events kept from the parent:
+    unsigned long suppressedCount = 0;
+};
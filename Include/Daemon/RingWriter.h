@@ -0,0 +1,80 @@
+/**
+ * @file  RingWriter.h
+ *
+ * @brief  Writes encoded key event messages into the shared memory ring
+ *         created by the parent application.
+ */
+
+#pragma once
+#include "KeyRing.h"
+
+namespace KeyDaemon
+{
+    class RingWriter;
+}
+
+/**
+ * @brief  The producer side of the shared memory key message ring.
+ *
+ *  Only one thread may write to the ring at a time. Writing never blocks: if
+ * the parent falls far enough behind that the ring fills up, write() fails.
+ * The caller may then drop the messages, leaving the parent to detect the loss
+ * through message sequence numbers, or use waitForSpace() and try again.
+ */
+class KeyDaemon::RingWriter
+{
+public:
+    /**
+     * @brief  Opens and maps the ring file on construction.
+     *
+     *  The ring file must be a regular file owned by the daemon's real user
+     * that is only accessible by its owner, and must hold a ring initialized
+     * with the expected layout.
+     *
+     * @param ringPath  The path to the ring file created by the parent.
+     */
+    RingWriter(const char* ringPath);
+
+    /**
+     * @brief  Unmaps the ring file on destruction.
+     */
+    virtual ~RingWriter();
+
+    /**
+     * @brief  Checks if the ring file was successfully opened and mapped.
+     *
+     * @return  Whether messages can be written to the ring.
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief  Copies encoded messages into the ring, waking the parent if it
+     *         is waiting for new messages.
+     *
+     * @param messageData   Encoded message data.
+     *
+     * @param messageCount  The number of messages in messageData.
+     *
+     * @return              Whether the messages were written. If false, the
+     *                      ring didn't have room for all messages, and none
+     *                      were written.
+     */
+    bool write(const unsigned char* messageData, const int messageCount);
+
+    /**
+     * @brief  Sleeps until the parent has read enough messages to make room in
+     *         the ring, or until a timeout expires.
+     *
+     * @param messageCount  The number of messages that need to fit in the
+     *                      ring, no more than KeyRing::capacity.
+     *
+     * @param timeoutMS     Maximum time to sleep in milliseconds.
+     */
+    void waitForSpace(const int messageCount, const int timeoutMS);
+
+private:
+    // The ring's header, at the start of the mapped file:
+    KeyRing::Header* header = nullptr;
+    // The ring's message data:
+    unsigned char* ringData = nullptr;
+};
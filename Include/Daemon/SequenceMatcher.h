@@ -0,0 +1,124 @@
+/**
+ * @file  SequenceMatcher.h
+ *
+ * @brief  Detects registered sequences of key presses within the stream of
+ *         tracked key events.
+ */
+
+#pragma once
+#include "KeyMessage.h"
+#include <linux/input-event-codes.h>
+#include <vector>
+#include <cstdint>
+
+namespace KeyDaemon
+{
+    class SequenceMatcher;
+}
+
+/**
+ * @brief  Matches key presses against all registered sequences at once,
+ *         using a deterministic finite automaton built on construction.
+ *
+ *  Registered sequences are compiled into a trie of key presses, and every
+ * missing trie transition is filled in with the state the longest matching
+ * suffix would reach. Each key press then costs a single table lookup, no
+ * matter how many sequences are registered. Key releases and repeats never
+ * change the matcher's state, and pressing any key that isn't part of a
+ * sequence returns the matcher to its initial state.
+ *
+ *  After a sequence completes, matching starts over from the initial state,
+ * so sequences never overlap. Only one thread may process events at a time.
+ */
+class KeyDaemon::SequenceMatcher
+{
+public:
+    // Maximum number of sequences that can be registered:
+    static const constexpr int maxSequences = 64;
+
+    // Maximum number of key presses in a single sequence:
+    static const constexpr int maxSequenceKeys = 8;
+
+    // Maximum number of messages produced by a single key event:
+    static const constexpr int maxOutputMessages = 1;
+
+    /**
+     * @brief  Compiles registered sequences into the matcher's transition
+     *         table on construction.
+     *
+     * @param sequences  Registered sequences, each holding two to
+     *                   maxSequenceKeys key codes in the order they must be
+     *                   pressed. Sequences are identified by their index in
+     *                   this list. Invalid sequences and sequences past
+     *                   maxSequences are ignored.
+     *
+     * @param timeoutMS  Maximum time in milliseconds allowed between two
+     *                   presses in the same sequence, or zero to allow any
+     *                   amount of time.
+     */
+    SequenceMatcher(const std::vector<std::vector<int>>& sequences,
+            const unsigned int timeoutMS);
+
+    virtual ~SequenceMatcher() { }
+
+    /**
+     * @brief  Checks if a list of key codes can be registered as a sequence.
+     *
+     * @param sequenceKeys  The sequence's key codes, in order.
+     *
+     * @return              Whether the sequence has two to maxSequenceKeys
+     *                      valid key codes.
+     */
+    static bool isValidSequence(const std::vector<int>& sequenceKeys);
+
+    /**
+     * @brief  Checks if any sequences were registered.
+     *
+     * @return  Whether key presses need to pass through the SequenceMatcher.
+     */
+    bool hasSequences() const;
+
+    /**
+     * @brief  Gets the number of states in the compiled automaton.
+     *
+     * @return  The state count, including the initial state.
+     */
+    int getStateCount() const;
+
+    /**
+     * @brief  Advances the matcher with a new key event, and checks if it
+     *         completed a registered sequence.
+     *
+     * @param message  A tracked key event.
+     *
+     * @param output   A buffer with room for maxOutputMessages messages,
+     *                 used to return a sequence message if a sequence was
+     *                 completed. Sequence messages use MessageKind::sequence,
+     *                 hold the sequence index in keyCode, and use
+     *                 EventType::pressed.
+     *
+     * @return         The number of messages copied to the output buffer.
+     */
+    int process(const KeyMessage& message, KeyMessage* output);
+
+private:
+    // Key code input symbol used for keys that aren't part of any sequence:
+    static const constexpr uint16_t otherKeySymbol = 0;
+
+    // Input symbol assigned to each key code:
+    uint16_t keySymbols[KEY_CNT] = {};
+    // Number of distinct input symbols, including otherKeySymbol:
+    int symbolCount = 1;
+    // Next state for each state and input symbol, indexed by
+    // (state * symbolCount) + symbol. The initial state is always zero:
+    std::vector<uint16_t> transitions;
+    // Index of the sequence completed by entering each state, or -1:
+    std::vector<int8_t> completedSequences;
+    // The matcher's current state:
+    uint16_t state = 0;
+    // Maximum time in microseconds allowed between sequence key presses, or
+    // zero if sequences never time out:
+    const uint64_t timeoutUS;
+    // Time in microseconds of the last key press:
+    uint64_t lastPressTime = 0;
+};
@@ -0,0 +1,138 @@
+/**
+ * @file  UringReader.h
+ *
+ * @brief  Reads key events from every keyboard event file on a single thread
+ *         using io_uring.
+ */
+
+#pragma once
+#include "MultiReader.h"
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+namespace KeyDaemon
+{
+    class UringReader;
+}
+
+/**
+ * @brief  Keeps one read request queued for every open event file, submitting
+ *         and collecting them in batches.
+ *
+ *  Each time the read thread wakes, it handles every completed read, then
+ * re-queues reads for those files and waits for the next completion using a
+ * single io_uring_enter system call.
+ *
+ *  Use isSupported() to check that the kernel provides io_uring before
+ * creating a UringReader. If the io_uring instance still can't be created, the
+ * UringReader closes all of its event files immediately, and isAvailable()
+ * returns false.
+ */
+class KeyDaemon::UringReader : public MultiReader
+{
+public:
+    /**
+     * @brief  Opens all event files, creates the io_uring instance, and starts
+     *         the read thread.
+     *
+     * @param eventFilePaths  Paths to all keyboard input event files that
+     *                        should be read.
+     *
+     * @param trackedKeys     The set of all key event codes that should be
+     *                        reported.
+     *
+     * @param listener        The object that will handle relevant keyboard
+     *                        events.
+     */
+    UringReader(const std::vector<std::string>& eventFilePaths,
+            const KeySetBuffer& trackedKeys, KeyReader::Listener* listener);
+
+    /**
+     * @brief  Stops the read thread and releases the io_uring instance.
+     */
+    virtual ~UringReader();
+
+    /**
+     * @brief  Checks if the io_uring instance was successfully created.
+     *
+     * @return  Whether the UringReader is able to read input.
+     */
+    bool isAvailable() const;
+
+    /**
+     * @brief  Checks if the kernel allows io_uring instances to be created,
+     *         without opening any event files.
+     *
+     * @return  Whether a UringReader should be able to read input.
+     */
+    static bool isSupported();
+
+private:
+    /**
+     * @brief  Creates and maps the io_uring submission and completion queues.
+     *
+     * @param entryCount  The minimum number of queue entries needed.
+     *
+     * @return            Whether the io_uring instance was created.
+     */
+    bool initRing(const unsigned int entryCount);
+
+    /**
+     * @brief  Submits queued reads and handles completed reads until the
+     *         UringReader is destroyed or all files are closed.
+     */
+    virtual void readLoop() override;
+
+    /**
+     * @brief  Wakes the read thread so it can exit.
+     */
+    virtual void signalStop() override;
+
+    /**
+     * @brief  Adds a read request to the submission queue.
+     *
+     * @param fileDescriptor  The file to read.
+     *
+     * @param buffer          The iovec describing where input will be read.
+     *
+     * @param requestID       A value used to identify the request's
+     *                        completion.
+     */
+    void queueRead(const int fileDescriptor, struct iovec* buffer,
+            const unsigned long long requestID);
+
+    // The io_uring instance file descriptor:
+    int ringFD = -1;
+    // Event file descriptor used to wake the read thread for shutdown:
+    int stopFD = -1;
+    // Read requests queued but not yet submitted:
+    unsigned int pendingSubmissions = 0;
+
+    // Submission queue ring pointers:
+    unsigned int* sqHead = nullptr;
+    unsigned int* sqTail = nullptr;
+    unsigned int* sqMask = nullptr;
+    unsigned int* sqArray = nullptr;
+    struct io_uring_sqe* sqEntries = nullptr;
+    // Completion queue ring pointers:
+    unsigned int* cqHead = nullptr;
+    unsigned int* cqTail = nullptr;
+    unsigned int* cqMask = nullptr;
+    struct io_uring_cqe* cqEntries = nullptr;
+
+    // Mapped ring memory regions:
+    void* sqRing = nullptr;
+    size_t sqRingSize = 0;
+    void* cqRing = nullptr;
+    size_t cqRingSize = 0;
+    size_t sqEntriesSize = 0;
+
+    // Input buffer descriptions, one for each event file:
+    std::vector<struct iovec> fileBuffers;
+    // Completed reads waiting to be processed, with room for one read from
+    // each event file:
+    std::vector<PendingInput> pendingInputs;
+    // Input buffer for the shutdown event file:
+    unsigned long long stopValue = 0;
+    struct iovec stopBuffer;
+};
@@ -0,0 +1,73 @@
+/**
+ * @file  ControlWriter.h
+ *
+ * @brief  Creates the control FIFO, and sends commands to a running KeyDaemon
+ *         through it, when built with KD_CONTROL.
+ */
+
+#pragma once
+#include "ControlFormat.h"
+#include <string>
+#include <vector>
+
+namespace KeyDaemon
+{
+    class ControlWriter;
+}
+
+/**
+ * @brief  The parent side of the daemon control FIFO.
+ *
+ *  A new FIFO with owner-only permissions is created before each daemon
+ * launch, so commands can only reach the daemon that was launched with it.
+ * Sending never blocks: commands are dropped if the daemon hasn't opened the
+ * FIFO yet, has exited, or isn't reading. Only one thread may send commands
+ * at a time.
+ */
+class KeyDaemon::ControlWriter
+{
+public:
+    /**
+     * @brief  Saves the control FIFO path on construction.
+     *
+     * @param fifoPath  The path where the control FIFO will be created.
+     */
+    ControlWriter(const char* fifoPath);
+
+    /**
+     * @brief  Closes and removes the control FIFO on destruction.
+     */
+    virtual ~ControlWriter();
+
+    /**
+     * @brief  Creates a new control FIFO with owner-only permissions,
+     *         replacing any existing FIFO.
+     *
+     * @return  Whether the FIFO was created.
+     */
+    bool create();
+
+    /**
+     * @brief  Sends a single command to the daemon.
+     *
+     * @param command     The action the daemon should take.
+     *
+     * @param keyCodes    The keys the daemon should track, if the command
+     *                    is Command::setKeys.
+     *
+     * @param eventMasks  Event types to send for each of keyCodes, in the
+     *                    same order. Codes without a mask send all event
+     *                    types.
+     *
+     * @return            Whether the whole command was written to the FIFO.
+     */
+    bool send(const ControlFormat::Command command,
+            const std::vector<int>& keyCodes = {},
+            const std::vector<EventMask>& eventMasks = {});
+
+private:
+    // The path where the control FIFO is created:
+    const std::string fifoPath;
+    // The FIFO's write descriptor, opened once the daemon is reading:
+    int fifoFD = -1;
+};
@@ -8,7 +8,22 @@
 #include "DaemonControl.h"
 #include "Pipe_Listener.h"
 #include "KeyMessage.h"
+#include "KeyGesture.h"
 #include "EventType.h"
+#include "RepeatPolicy.h"
+#ifdef KD_SHM_TRANSPORT
+#include "RingReader.h"
+#endif
+#ifdef KD_KEY_STATE
+#include "KeyStateReader.h"
+#endif
+#ifdef KD_CONTROL
+#include "ControlWriter.h"
+#endif
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <string>
 
 namespace KeyDaemon
 {
@@ -29,10 +44,160 @@ public:
     /**
      * @brief  Launches the KeyDaemon if it isn't already running.
      *
+     *  If built with KD_SHM_TRANSPORT, this creates a new message ring for
+     * the daemon before launching it. If the ring can't be created, messages
+     * are received through the output pipe instead. If built with
+     * KD_KEY_STATE, this also creates a new, empty key state page. If built
+     * with KD_CONTROL, this also creates a new control FIFO.
+     *
+     *  The daemon exits with KeyExitCode::badTrackedKeys if the distinct key
+     * codes across trackedKeyCodes, chords, sequences, and gestures exceed
+     * KD_KEY_LIMIT.
+     *
      * @param trackedKeyCodes  The list of key codes the KeyDaemon should track.
+     *                         If KD_BAKED_KEYS is defined, this is ignored,
+     *                         and the daemon tracks its built-in key codes.
+     *
+     * @param chords           Key combinations the KeyDaemon should report
+     *                         to handleChordEvent, each holding two to
+     *                         ChordMatcher::maxChordKeys key codes. Chord
+     *                         keys not in trackedKeyCodes aren't sent to
+     *                         handleKeyEvent. If KD_BAKED_KEYS is defined,
+     *                         this is ignored.
+     *
+     * @param sequences        Key press sequences the KeyDaemon should report
+     *                         to handleSequenceEvent, each holding two to
+     *                         SequenceMatcher::maxSequenceKeys key codes in
+     *                         the order they must be pressed. Sequence keys
+     *                         not in trackedKeyCodes aren't sent to
+     *                         handleKeyEvent. If KD_BAKED_KEYS is defined,
+     *                         this is ignored.
+     *
+     * @param gestures         Long press and double tap thresholds for keys
+     *                         the KeyDaemon should report to
+     *                         handleGestureEvent. Repeat events are never
+     *                         sent for these keys, and they aren't sent to
+     *                         handleKeyEvent unless they're also in
+     *                         trackedKeyCodes. Enabled thresholds must be
+     *                         from 100 to 10000 milliseconds. If
+     *                         KD_BAKED_KEYS is defined, this is ignored.
+     *
+     * @param eventMasks       The EventTypes the KeyDaemon should send for
+     *                         each of trackedKeyCodes, in the same order.
+     *                         Events of other types are discarded by the
+     *                         daemon. Masks must not be empty, and codes
+     *                         without a mask send all types.
+     *                         If KD_BAKED_KEYS is defined, this is ignored.
+     */
+    void startKeyDaemon(const std::vector<int> trackedKeyCodes,
+            const std::vector<std::vector<int>>& chords = {},
+            const std::vector<std::vector<int>>& sequences = {},
+            const std::vector<KeyGesture>& gestures = {},
+            const std::vector<EventMask>& eventMasks = {});
+
+    /**
+     * @brief  Selects how the KeyDaemon sends repeat events for held keys
+     *         the next time it is launched.
+     *
+     *  With RepeatPolicy::collapse, each release of a key that repeated is
+     * passed to handleKeyEvent with the number of repeats the daemon received
+     * in keyMessage.repeatCount. Unlike key codes, the repeat policy is still
+     * sent to daemons built with KD_BAKED_KEYS.
+     *
+     * @param policy  How repeat events should be handled.
+     *
+     * @param rateHz  Maximum repeats per second sent for each key when using
+     *                RepeatPolicy::rateLimit, from one to
+     *                RepeatThrottle::maxRateHz. This is ignored for other
+     *                policies.
+     */
+    void setRepeatPolicy(const RepeatPolicy policy,
+            const unsigned int rateHz = 0);
+
+    /**
+     * @brief  Blocks until the KeyDaemon reports that it opened its keyboard
+     *         event files and is ready to read key events.
+     *
+     *  startKeyDaemon returns as soon as the daemon is launched, before any
+     * keyboards are read. Applications that can't block may override
+     * handleDaemonReady instead.
+     *
+     * @param timeoutMS  Maximum time in milliseconds to wait, or a negative
+     *                   value to wait until the daemon is ready or stops.
+     *
+     * @return           The number of keyboard event files the daemon
+     *                   opened, or -1 if it stopped or the timeout passed
+     *                   before it was ready.
+     */
+    int waitForDaemonReady(const int timeoutMS = -1);
+
+#ifdef KD_CONTROL
+    /**
+     * @brief  Replaces the set of individually tracked keys in the running
+     *         KeyDaemon, without relaunching it.
+     *
+     *  Chords, sequences, gestures, and the repeat policy are unchanged. Keys
+     * that are no longer tracked never send releases, even if they are held
+     * when the set is replaced. This fails if the daemon was built with
+     * KD_BAKED_KEYS. The daemon ignores the new keys if, combined with its
+     * chord, sequence, and gesture keys, they exceed KD_KEY_LIMIT distinct key
+     * codes.
+     *
+     * @param trackedKeyCodes  The key codes the KeyDaemon should track, no
+     *                         more than KD_KEY_LIMIT.
+     *
+     * @param eventMasks       The EventTypes the KeyDaemon should send for
+     *                         each of trackedKeyCodes, in the same order.
+     *                         Codes without a mask send all types.
+     *
+     * @return                 Whether the new keys were sent to the daemon.
+     */
+    bool setTrackedKeys(const std::vector<int>& trackedKeyCodes,
+            const std::vector<EventMask>& eventMasks = {});
+
+    /**
+     * @brief  Stops the running KeyDaemon from reading key events until
+     *         resumeKeyDaemon is called.
+     *
+     *  While paused, the kernel stops passing key events to the daemon, so
+     * it isn't woken at all. Held keys may not send releases while paused;
+     * tracked keys that changed state are reported once the daemon resumes
+     * and reads its next input event.
+     *
+     * @return  Whether the command was sent to the daemon.
+     */
+    bool pauseKeyDaemon();
+
+    /**
+     * @brief  Lets a paused KeyDaemon read and send key events again.
+     *
+     * @return  Whether the command was sent to the daemon.
+     */
+    bool resumeKeyDaemon();
+#endif
+
+    /**
+     * @brief  Gets the number of key event messages that the daemon sent but
+     *         the Controller never received.
+     *
+     *  Lost messages are detected using message sequence numbers, so they
+     * can't be counted if the daemon was built with KD_LEGACY_MESSAGES.
+     *
+     * @return  The total number of messages lost since the daemon was last
+     *          launched.
      */
-    void startKeyDaemon(const std::vector<int> trackedKeyCodes);
+    unsigned long getLostMessageCount() const;
 
+#ifdef KD_KEY_STATE
+    /**
+     * @brief  Gets the shared key state page reader, which can be polled to
+     *         find which tracked keys are currently held down without
+     *         waiting for key event messages.
+     *
+     * @return  The Controller's key state reader.
+     */
+    const KeyStateReader& getKeyState() const;
+#endif
 
     // Grant limited access to DaemonControl public methods:
     using DaemonFramework::DaemonControl::stopDaemon;
@@ -45,23 +210,151 @@ private:
      * @brief  The virual method called to handle all key events sent by the 
      *         KeyDaemon.
      *
-     * @param keyMessage  The incoming key event message data.
+     * @param keyMessage  The incoming key event message data. If the daemon
+     *                    was built with KD_TIMESTAMPS, keyMessage.timestamp
+     *                    holds the CLOCK_MONOTONIC time in microseconds when
+     *                    the kernel registered the event. If repeats are
+     *                    collapsed, releases of keys that repeated hold the
+     *                    repeat count in keyMessage.repeatCount.
      */
     virtual void handleKeyEvent(const KeyMessage& keyMessage) = 0;
 
     /**
-     * @brief  Receives keyboard event data from the daemon output pipe, and 
-     *         passes it to the handleKeyEvent method if its data is valid.
+     * @brief  Called when a chord registered with startKeyDaemon starts or
+     *         ends.
+     *
+     * @param chordMessage  The chord event message. Its keyCode holds the
+     *                      chord's index in the chord list, and its event is
+     *                      EventType::pressed when all of the chord's keys
+     *                      are held, or EventType::released when any of
+     *                      them is released.
+     */
+    virtual void handleChordEvent(const KeyMessage& chordMessage) { }
+
+    /**
+     * @brief  Called when a sequence registered with startKeyDaemon is
+     *         completed.
+     *
+     * @param sequenceMessage  The sequence event message. Its keyCode holds
+     *                         the sequence's index in the sequence list, and
+     *                         its timestamp is taken from the sequence's
+     *                         final key press.
+     */
+    virtual void handleSequenceEvent(const KeyMessage& sequenceMessage) { }
+
+    /**
+     * @brief  Called when a key registered with gesture thresholds in
+     *         startKeyDaemon is long pressed or double tapped.
+     *
+     * @param gestureMessage  The gesture event message. Its kind is either
+     *                        MessageKind::longPress or MessageKind::doubleTap,
+     *                        and its keyCode holds the gesture key. Long
+     *                        press timestamps hold the time the threshold
+     *                        passed, and double tap timestamps hold the time
+     *                        of the second press.
+     */
+    virtual void handleGestureEvent(const KeyMessage& gestureMessage) { }
+
+    /**
+     * @brief  Called when a gap in message sequence numbers shows that key
+     *         event messages were lost before reaching the Controller.
      *
-     * @param data  A raw data array pointing to KeyMessage data.
+     *  Lost messages may include key releases, so applications may want to
+     * treat any keys they believe are held as released. This is called before
+     * handleKeyEvent is called for the message that follows the gap.
      *
-     * @param size  Size in bytes of the data array. If this does not match the
-     *              size of the KeyMessage data structure, the message will be
+     * @param lostCount  The number of messages missing from this gap.
+     */
+    virtual void handleMessageGap(const unsigned int lostCount) { }
+
+    /**
+     * @brief  Called once after each launch, when the KeyDaemon has opened
+     *         its keyboard event files and is ready to read key events.
+     *
+     * @param readyMessage  The ready message. Its keyCode holds the number of
+     *                      open event files, and if the daemon was built with
+     *                      KD_TIMESTAMPS, its timestamp holds the
+     *                      CLOCK_MONOTONIC time in microseconds when the
+     *                      daemon became ready.
+     */
+    virtual void handleDaemonReady(const KeyMessage& readyMessage) { }
+
+    /**
+     * @brief  Receives frames of keyboard event data from the daemon output
+     *         pipe, and passes each message to the handleKeyEvent method in
+     *         order if its data is valid.
+     *
+     * @param data  A raw data array pointing to one or more encoded
+     *              KeyMessages.
+     *
+     * @param size  Size in bytes of the data array. If this is not a multiple
+     *              of KeyWireFormat::messageSize, the frame will be
      *              discarded.
      */
     virtual void processData
     (const unsigned char* data, const size_t size) final override;
 
-    // The last set of tracked key codes used to launch the daemon.
+    /**
+     * @brief  Validates a single key message, passing it to the
+     *         handleKeyEvent, handleChordEvent, handleSequenceEvent,
+     *         handleGestureEvent, or handleDaemonReady method if its data is
+     *         valid.
+     *
+     * @param data         A raw data array pointing to a single encoded
+     *                     KeyMessage.
+     *
+     * @param receiveTime  The CLOCK_MONOTONIC time in microseconds when the
+     *                     message's frame was received.
+     */
+    void processMessage(const unsigned char* data,
+            const uint64_t receiveTime);
+
+    /**
+     * @brief  Checks a received message's sequence number for gaps, updating
+     *         the lost message count and calling handleMessageGap if any
+     *         messages were lost.
+     *
+     * @param sequence  The received message's sequence number.
+     */
+    void checkSequence(const unsigned int sequence);
+
+    // The last set of tracked key codes used to launch or update the daemon.
     std::vector<int> keyCodes;
+    // Ensures key codes, chord and sequence counts, and gesture keys aren't
+    // replaced while messages are validated:
+    std::mutex keyCodeLock;
+    // The number of chords registered when the daemon was launched:
+    size_t chordCount = 0;
+    // The number of sequences registered when the daemon was launched:
+    size_t sequenceCount = 0;
+    // Key codes registered with gesture thresholds when the daemon was
+    // launched:
+    std::vector<int> gestureKeys;
+    // Repeat policy argument sent when launching the daemon, or an empty
+    // string to send all repeats:
+    std::string repeatArgument;
+    // Repeat count received just before the next message, if that message
+    // is the matching key release:
+    unsigned int pendingRepeatCount = 0;
+    // Sequence number expected in the next message from the daemon:
+    unsigned int expectedSequence = 0;
+    // Total number of messages lost since the daemon was launched:
+    std::atomic<unsigned long> lostMessageCount;
+    // Number of event files the daemon opened, or -1 if it isn't ready:
+    int readyDeviceCount = -1;
+    // Guards readyDeviceCount, and wakes threads waiting for the daemon:
+    std::mutex readyLock;
+    std::condition_variable readyCondition;
+#ifdef KD_SHM_TRANSPORT
+    // Reads messages from the shared memory ring:
+    RingReader ringReader;
+#endif
+#ifdef KD_KEY_STATE
+    // Reads held keys from the shared key state page:
+    KeyStateReader keyState;
+#endif
+#ifdef KD_CONTROL
+    // Sends commands to the running daemon:
+    ControlWriter controlWriter;
+#endif
 };
@@ -0,0 +1,103 @@
+/**
+ * @file  KeyStateReader.h
+ *
+ * @brief  Creates the shared key state page, and reads which tracked keys the
+ *         KeyDaemon has published as held down.
+ */
+
+#pragma once
+#include "KeyStatePage.h"
+#include <string>
+
+namespace KeyDaemon
+{
+    class KeyStateReader;
+}
+
+/**
+ * @brief  The reader side of the shared key state page.
+ *
+ *  Reading key state never makes system calls or waits on the daemon, so it
+ * is suitable for polling once per frame. Applications can compare
+ * generation numbers to skip reading state that hasn't changed.
+ */
+class KeyDaemon::KeyStateReader
+{
+public:
+    /**
+     * @brief  A consistent copy of the published key state.
+     */
+    struct Snapshot
+    {
+        // The page generation number when this snapshot was taken:
+        uint32_t generation = 0;
+        // Bitmap with one bit set for each tracked key held down:
+        uint64_t pressedKeys[KeyStatePage::wordCount] = {};
+
+        /**
+         * @brief  Checks if a key was held down when the snapshot was taken.
+         *
+         * @param keyCode  The key code to check.
+         *
+         * @return         Whether the key was held down.
+         */
+        bool isPressed(const unsigned int keyCode) const;
+    };
+
+    /**
+     * @brief  Saves the key state page path on construction.
+     *
+     * @param pagePath  The path where the key state page will be created.
+     */
+    KeyStateReader(const char* pagePath);
+
+    /**
+     * @brief  Unmaps and removes the key state page on destruction.
+     */
+    virtual ~KeyStateReader();
+
+    /**
+     * @brief  Creates a new key state page with owner-only permissions and
+     *         no held keys, replacing any existing page.
+     *
+     *  Once created, the page is only mapped for reading within the parent
+     * application.
+     *
+     * @return  Whether the page was created.
+     */
+    bool create();
+
+    /**
+     * @brief  Gets the current page generation number, which changes each
+     *         time the daemon publishes a change in key state.
+     *
+     * @return  The current generation number, or zero if the page hasn't been
+     *          created.
+     */
+    uint32_t getGeneration() const;
+
+    /**
+     * @brief  Copies the current key state.
+     *
+     * @param snapshot  Used to return the key state.
+     *
+     * @return          Whether the snapshot was taken. This is false if the
+     *                  page hasn't been created.
+     */
+    bool readSnapshot(Snapshot& snapshot) const;
+
+    /**
+     * @brief  Checks if a single key is currently held down.
+     *
+     * @param keyCode  The key code to check.
+     *
+     * @return         Whether the key is held down.
+     */
+    bool isPressed(const unsigned int keyCode) const;
+
+private:
+    // Path to the key state page:
+    const std::string pagePath;
+    // The mapped key state page:
+    const KeyStatePage::Page* page = nullptr;
+};
@@ -0,0 +1,78 @@
+/**
+ * @file  RingReader.h
+ *
+ * @brief  Creates the shared memory key message ring, and reads messages that
+ *         the KeyDaemon writes into it.
+ */
+
+#pragma once
+#include "KeyRing.h"
+#include "Pipe_Listener.h"
+#include <string>
+#include <thread>
+#include <atomic>
+
+namespace KeyDaemon
+{
+    class RingReader;
+}
+
+/**
+ * @brief  The consumer side of the shared memory key message ring.
+ *
+ *  The RingReader reads messages on its own thread, passing them to a
+ * listener in the same way the daemon's output pipe does, so that listeners
+ * don't need to know which transport is in use.
+ */
+class KeyDaemon::RingReader
+{
+public:
+    /**
+     * @brief  Saves the ring file path on construction.
+     *
+     * @param ringPath  The path where the ring file will be created.
+     */
+    RingReader(const char* ringPath);
+
+    /**
+     * @brief  Stops reading, unmaps the ring, and removes the ring file on
+     *         destruction.
+     */
+    virtual ~RingReader();
+
+    /**
+     * @brief  Creates a new, empty ring file with owner-only permissions,
+     *         replacing any existing ring file, and starts reading messages
+     *         from it.
+     *
+     * @param listener  The object that will receive all message data.
+     *
+     * @return          Whether the ring was created and reading started.
+     */
+    bool start(DaemonFramework::Pipe::Listener* listener);
+
+    /**
+     * @brief  Stops the read thread, if it is running, and unmaps the ring.
+     */
+    void stop();
+
+private:
+    /**
+     * @brief  Passes new messages to the listener, sleeping whenever the ring
+     *         is empty, until the RingReader is stopped.
+     */
+    void readLoop();
+
+    // Path to the ring file:
+    const std::string ringPath;
+    // The ring's header, at the start of the mapped file:
+    KeyRing::Header* header = nullptr;
+    // The ring's message data:
+    unsigned char* ringData = nullptr;
+    // Receives all message data:
+    DaemonFramework::Pipe::Listener* listener = nullptr;
+    // Set while the read thread should keep running:
+    std::atomic<bool> reading;
+    // Thread used to read new messages:
+    std::thread readThread;
+};
@@ -0,0 +1,159 @@
+/**
+ * @file  BakedKeys.h
+ *
+ * @brief  Provides the fixed set of tracked key codes built into the KeyDaemon
+ *         when KD_BAKED_KEYS is defined.
+ */
+
+#pragma once
+#ifdef KD_BAKED_KEYS
+#include "EventType.h"
+#include <vector>
+#include <linux/input-event-codes.h>
+
+namespace KeyDaemon
+{
+    namespace BakedKeys
+    {
+        // Tracked key codes, copied directly from the build definition:
+        static const constexpr int codes[] = { KD_BAKED_KEYS };
+
+        // Number of tracked key codes:
+        static const constexpr int count = sizeof(codes) / sizeof(int);
+
+        // Number of bits stored in each bitmap word:
+        static const constexpr unsigned int wordBits
+                = sizeof(unsigned long) * 8;
+
+        /**
+         * @brief  Finds the smallest baked key code.
+         */
+        constexpr int minCode()
+        {
+            int minValue = codes[0];
+            for (int i = 1; i < count; i++)
+            {
+                minValue = (codes[i] < minValue) ? codes[i] : minValue;
+            }
+            return minValue;
+        }
+
+        /**
+         * @brief  Finds the largest baked key code.
+         */
+        constexpr int maxCode()
+        {
+            int maxValue = codes[0];
+            for (int i = 1; i < count; i++)
+            {
+                maxValue = (codes[i] > maxValue) ? codes[i] : maxValue;
+            }
+            return maxValue;
+        }
+
+        /**
+         * @brief  Checks that every baked key code is a valid keyboard code,
+         *         using the same limits as KeyCode::parseCodes.
+         */
+        constexpr bool codesAreValid()
+        {
+            for (int i = 0; i < count; i++)
+            {
+                if (codes[i] <= KEY_RESERVED || codes[i] >= KEY_UNKNOWN)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static_assert(count <= KD_KEY_LIMIT,
+                "KD_BAKED_KEYS contains more than KD_KEY_LIMIT key codes.");
+        static_assert(codesAreValid(),
+                "KD_BAKED_KEYS contains invalid keyboard codes.");
+
+        // Whether all codes fit in a single bitmap word, offset by minCode():
+        static const constexpr bool fitsInWord
+                = (maxCode() - minCode()) < static_cast<int>(wordBits);
+
+        /**
+         * @brief  Builds a single-word bitmap of all codes, offset by
+         *         minCode(). Only meaningful when fitsInWord is true.
+         */
+        constexpr unsigned long wordMask()
+        {
+            unsigned long mask = 0;
+            for (int i = 0; i < count && fitsInWord; i++)
+            {
+                mask |= (1UL << (codes[i] - minCode()));
+            }
+            return mask;
+        }
+
+        // Bitmap of all codes when they fit in a single word:
+        static const constexpr unsigned long codeMask = wordMask();
+
+        /**
+         * @brief  A stateless key set with compile-time contents, usable
+         *         anywhere a KeySet is used to check key codes.
+         *
+         *  When all baked codes are within one word's width of each other,
+         * membership checks are a subtraction, comparison, and shift against a
+         * constant mask. Otherwise, codes are compared directly, which the
+         * compiler can reduce to a fixed switch.
+         */
+        struct Set
+        {
+            /**
+             * @brief  Checks if a key code is one of the baked key codes.
+             *
+             * @param keyCode  The code to find.
+             *
+             * @return         Whether the code is in the set.
+             */
+            constexpr bool contains(const unsigned int keyCode) const
+            {
+                if (fitsInWord)
+                {
+                    const unsigned int offset = keyCode - minCode();
+                    return offset < wordBits && ((codeMask >> offset) & 1);
+                }
+                bool found = false;
+                for (int i = 0; i < count; i++)
+                {
+                    found |= (keyCode == static_cast<unsigned int>(codes[i]));
+                }
+                return found;
+            }
+
+            /**
+             * @brief  Checks if a key event should be tracked. All event
+             *         types are tracked for baked key codes.
+             *
+             * @param keyCode    The event's key code.
+             *
+             * @param eventType  The event's value.
+             *
+             * @return           Whether the code is a baked key code and
+             *                   the value is a tracked EventType.
+             */
+            constexpr bool accepts(const unsigned int keyCode,
+                    const unsigned int eventType) const
+            {
+                return eventType < static_cast<unsigned int>
+                        (EventType::trackedTypeCount) && contains(keyCode);
+            }
+        };
+
+        /**
+         * @brief  Gets all baked key codes.
+         *
+         * @return  The baked key code list.
+         */
+        inline std::vector<int> getCodes()
+        {
+            return std::vector<int>(codes, codes + count);
+        }
+    }
+}
+#endif
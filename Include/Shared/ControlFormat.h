@@ -0,0 +1,177 @@
+/**
+ * @file  ControlFormat.h
+ *
+ * @brief  Encodes and decodes the commands a parent application sends to the
+ *         KeyDaemon through its control FIFO, when built with KD_CONTROL.
+ *
+ *  Each command starts with a four byte little-endian header word:
+ *
+ *  | Bits  | Field                         |
+ *  |-------|-------------------------------|
+ *  | 0-7   | ControlFormat::Command        |
+ *  | 8-15  | Format version                |
+ *  | 16-31 | Number of key entries         |
+ *
+ *  Command::setKeys headers are followed by one four byte little-endian word
+ * for each tracked key, holding the key code in bits 0-15 and its EventMask
+ * in bits 16-23. Other commands have no key entries. Commands never hold more
+ * than KD_KEY_LIMIT keys, and each one is sent with a single write no larger
+ * than PIPE_BUF, so commands are never split or interleaved.
+ */
+
+#pragma once
+#include "EventType.h"
+#include <limits.h>
+#include <vector>
+#include <cstdint>
+
+namespace KeyDaemon
+{
+    namespace ControlFormat
+    {
+        /**
+         * @brief  Actions the parent application can ask the daemon to take.
+         */
+        enum class Command : uint8_t
+        {
+            // Stop sending key events until the daemon is resumed:
+            pause = 1,
+            // Start sending key events again after a pause:
+            resume = 2,
+            // Replace the set of individually tracked keys:
+            setKeys = 3
+        };
+
+        // Command format version. Zero is never used, so that zero-filled
+        // data is always rejected:
+        static const constexpr uint32_t version = 1;
+
+        // Size in bytes of the header and of each key entry:
+        static const constexpr int wordSize = 4;
+
+        // Maximum number of keys a setKeys command may hold:
+        static const constexpr int maxKeys = KD_KEY_LIMIT;
+
+        // Maximum size in bytes of a single command:
+        static const constexpr int maxCommandSize = wordSize * (maxKeys + 1);
+
+        static_assert(maxKeys < (1 << 16) && maxCommandSize <= PIPE_BUF,
+                "KD_KEY_LIMIT keys must fit in a single control FIFO write.");
+
+        /**
+         * @brief  Writes a little-endian word to a command buffer.
+         */
+        inline void putWord(const uint32_t word, unsigned char* output)
+        {
+            output[0] = static_cast<unsigned char>(word);
+            output[1] = static_cast<unsigned char>(word >> 8);
+            output[2] = static_cast<unsigned char>(word >> 16);
+            output[3] = static_cast<unsigned char>(word >> 24);
+        }
+
+        /**
+         * @brief  Reads a little-endian word from a command buffer.
+         */
+        inline uint32_t getWord(const unsigned char* input)
+        {
+            return static_cast<uint32_t>(input[0])
+                    | (static_cast<uint32_t>(input[1]) << 8)
+                    | (static_cast<uint32_t>(input[2]) << 16)
+                    | (static_cast<uint32_t>(input[3]) << 24);
+        }
+
+        /**
+         * @brief  Encodes a command for transmission to the daemon.
+         *
+         * @param command     The action the daemon should take.
+         *
+         * @param keyCodes    The keys the daemon should track, if the command
+         *                    is Command::setKeys. This is ignored for other
+         *                    commands.
+         *
+         * @param eventMasks  Event types to send for each of keyCodes, in the
+         *                    same order. Codes without a mask send all event
+         *                    types.
+         *
+         * @param output      A buffer with room for at least maxCommandSize
+         *                    bytes.
+         *
+         * @return            The encoded size in bytes, or zero if there are
+         *                    more than maxKeys key codes or a code can't be
+         *                    encoded.
+         */
+        inline int encode(const Command command,
+                const std::vector<int>& keyCodes,
+                const std::vector<EventMask>& eventMasks,
+                unsigned char* output)
+        {
+            const size_t keyCount = (command == Command::setKeys)
+                    ? keyCodes.size() : 0;
+            if (keyCount > static_cast<size_t>(maxKeys))
+            {
+                return 0;
+            }
+            putWord(static_cast<uint32_t>(command) | (version << 8)
+                    | (static_cast<uint32_t>(keyCount) << 16), output);
+            for (size_t i = 0; i < keyCount; i++)
+            {
+                if (keyCodes[i] < 0 || keyCodes[i] >= (1 << 16))
+                {
+                    return 0;
+                }
+                const EventMask mask = (i < eventMasks.size())
+                        ? (eventMasks[i] & allEventTypes) : allEventTypes;
+                putWord(static_cast<uint32_t>(keyCodes[i]) | (mask << 16),
+                        output + (wordSize * (i + 1)));
+            }
+            return static_cast<int>(wordSize * (keyCount + 1));
+        }
+
+        /**
+         * @brief  Decodes a command header received from the parent,
+         *         checking that its format, command, and key count are valid.
+         *
+         * @param input     A buffer holding at least wordSize bytes.
+         *
+         * @param command   Used to return the command.
+         *
+         * @param keyCount  Used to return the number of key entries that
+         *                  follow the header.
+         *
+         * @return          Whether the header was valid.
+         */
+        inline bool decodeHeader(const unsigned char* input, Command& command,
+                int& keyCount)
+        {
+            const uint32_t word = getWord(input);
+            const uint32_t commandValue = word & 0xff;
+            keyCount = static_cast<int>(word >> 16);
+            if (((word >> 8) & 0xff) != version
+                    || commandValue < static_cast<uint32_t>(Command::pause)
+                    || commandValue > static_cast<uint32_t>(Command::setKeys)
+                    || keyCount > maxKeys)
+            {
+                return false;
+            }
+            command = static_cast<Command>(commandValue);
+            return command == Command::setKeys || keyCount == 0;
+        }
+
+        /**
+         * @brief  Decodes a single key entry that followed a setKeys header.
+         *
+         * @param input      A buffer holding at least wordSize bytes.
+         *
+         * @param keyCode    Used to return the key code.
+         *
+         * @param eventMask  Used to return the key's EventMask.
+         */
+        inline void decodeKey(const unsigned char* input, int& keyCode,
+                EventMask& eventMask)
+        {
+            const uint32_t word = getWord(input);
+            keyCode = static_cast<int>(word & 0xffff);
+            eventMask = (word >> 16) & allEventTypes;
+        }
+    }
+}
@@ -18,6 +18,26 @@ namespace KeyDaemon
         trackedTypeCount = 3
     };
 
+    // A set of EventTypes, with bit (1 << type) set for each included type:
+    using EventMask = unsigned int;
+
+    // An EventMask that includes every tracked EventType:
+    static const constexpr EventMask allEventTypes
+            = (1U << static_cast<unsigned int>(EventType::trackedTypeCount))
+            - 1;
+
+    /**
+     * @brief  Gets the EventMask bit for a single EventType.
+     *
+     * @param type  A tracked EventType.
+     *
+     * @return      An EventMask holding only that type.
+     */
+    constexpr EventMask getEventMask(const EventType type)
+    {
+        return 1U << static_cast<unsigned int>(type);
+    }
+
     /**
      * @brief  Gets the string representation of an EventType.
      *
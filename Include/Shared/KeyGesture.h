@@ -0,0 +1,23 @@
+/**
+ * @file  KeyGesture.h
+ *
+ * @brief  Describes the timed gestures the KeyDaemon should detect for a
+ *         single key.
+ */
+
+#pragma once
+
+namespace KeyDaemon
+{
+    struct KeyGesture
+    {
+        // The Linux keyboard input code to watch:
+        int keyCode = 0;
+        // Milliseconds the key must be held before a long press is sent, from
+        // 100 to 10000, or zero to disable long presses:
+        unsigned int longPressMS = 0;
+        // Maximum milliseconds between two presses of the key for a double
+        // tap to be sent, from 100 to 10000, or zero to disable double taps:
+        unsigned int doubleTapMS = 0;
+    };
+}
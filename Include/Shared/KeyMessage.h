@@ -2,19 +2,57 @@
  * @file  KeyMessage.h
  *
  * @brief  The data format used by the KeyLoop to send new key events to the
- *         parent application.
+ *         parent application. KeyWireFormat.h defines how messages are
+ *         encoded when sent through the output pipe.
  */
 
 #pragma once
 #include "EventType.h"
+#include <cstdint>
 
 namespace KeyDaemon
 {
+    // The kinds of input a KeyMessage can report:
+    enum class MessageKind
+    {
+        // A single tracked key:
+        key = 0,
+        // A registered chord of simultaneously held keys:
+        chord = 1,
+        // A registered sequence of key presses:
+        sequence = 2,
+        // A key held past its long press threshold:
+        longPress = 3,
+        // A key pressed twice within its double tap threshold:
+        doubleTap = 4,
+        // The number of repeats collapsed while a key was held, sent just
+        // before the key's release with the count in place of the key code:
+        repeatCount = 5,
+        // Sent once after the daemon opens its keyboard event files and can
+        // read key events, with the number of open files in place of the key
+        // code:
+        ready = 6
+    };
+
     struct KeyMessage
     {
-        // A Linux keyboard input code:
+        // A Linux keyboard input code, a chord or sequence index, or a
+        // count for repeatCount and ready messages:
         int keyCode = 0;
         // The type of keyboard input event:
         EventType event = EventType::pressed;
+        // CLOCK_MONOTONIC time in microseconds when the event occurred, or
+        // zero if timestamps are unavailable:
+        uint64_t timestamp = 0;
+        // Transport sequence number assigned by the daemon's MessageQueue when
+        // the message was queued to send:
+        unsigned int sequence = 0;
+        // Whether the message reports a single key, a key gesture, or a
+        // registered chord or sequence identified by its index in keyCode:
+        MessageKind kind = MessageKind::key;
+        // For key releases, the number of repeat events the daemon received
+        // while the key was held, if its repeat policy collapses repeats.
+        // Otherwise zero:
+        unsigned int repeatCount = 0;
     };
 }
@@ -0,0 +1,120 @@
+/**
+ * @file  KeyRing.h
+ *
+ * @brief  Defines the shared memory ring buffer layout used to send key event
+ *         messages from the KeyDaemon to its parent application when built
+ *         with KD_SHM_TRANSPORT.
+ *
+ *  The parent application creates the ring file at KD_SHM_PATH with owner-only
+ * permissions before launching the daemon. The daemon is the ring's only
+ * producer, and the parent's RingReader thread is its only consumer. Messages
+ * are stored using the same encoding as the output pipe, as described in
+ * KeyWireFormat.h.
+ *
+ *  Neither side needs a system call to pass messages while the consumer is
+ * busy. When the consumer runs out of messages, it sets consumerWaiting and
+ * sleeps on a futex on writeIndex. The producer only makes a wake system call
+ * when it finds that flag set, clearing it so each sleep is woken once.
+ *
+ *  When built with KD_QUEUE_POLICY=block, the producer waits for room in a full
+ * ring the same way, setting producerWaiting and sleeping on a futex on
+ * readIndex until the consumer wakes it.
+ */
+
+#pragma once
+#include "KeyWireFormat.h"
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+
+namespace KeyDaemon
+{
+    namespace KeyRing
+    {
+        // Identifies valid ring files:
+        static const constexpr uint32_t magic = 0x4B44524E;
+
+        // Current ring layout version:
+        static const constexpr uint32_t version = 1;
+
+        // Number of messages the ring can hold:
+        static const constexpr uint32_t capacity = KD_RING_CAPACITY;
+        static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0,
+                "KD_RING_CAPACITY must be a power of two.");
+
+        // Size of a cache line, used to keep producer and consumer fields
+        // from sharing a line:
+        static const constexpr int cacheLineSize = 64;
+
+        /**
+         * @brief  Data stored at the start of the ring file.
+         */
+        struct Header
+        {
+            // Set to KeyRing::magic once the ring is initialized:
+            uint32_t magic;
+            // Set to KeyRing::version:
+            uint32_t version;
+            // Set to KeyRing::capacity:
+            uint32_t capacity;
+            // Set to KeyWireFormat::messageSize:
+            uint32_t messageSize;
+            // Total messages written, only updated by the producer:
+            alignas(cacheLineSize) std::atomic<uint32_t> writeIndex;
+            // Total messages read, only updated by the consumer:
+            alignas(cacheLineSize) std::atomic<uint32_t> readIndex;
+            // Nonzero while the consumer is preparing to sleep or sleeping:
+            std::atomic<uint32_t> consumerWaiting;
+            // Nonzero while the producer is waiting for room in the ring:
+            std::atomic<uint32_t> producerWaiting;
+        };
+
+        static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t)
+                && ATOMIC_INT_LOCK_FREE == 2,
+                "Ring indices must be lock-free to be shared between "
+                "processes.");
+
+        // Offset in bytes of message data from the start of the ring file:
+        static const constexpr size_t dataOffset
+                = ((sizeof(Header) + cacheLineSize - 1) / cacheLineSize)
+                * cacheLineSize;
+
+        // Total size in bytes of the ring file:
+        static const constexpr size_t fileSize = dataOffset
+                + (capacity * KeyWireFormat::messageSize);
+
+        /**
+         * @brief  Sleeps until a futex word is woken, unless its value has
+         *         already changed.
+         *
+         * @param futexWord  The shared futex word.
+         *
+         * @param expected   The value the word must hold for the caller to
+         *                   sleep.
+         *
+         * @param timeoutMS  Maximum time to sleep in milliseconds.
+         */
+        inline void futexWait(std::atomic<uint32_t>* futexWord,
+                const uint32_t expected, const int timeoutMS)
+        {
+            struct timespec timeout = { timeoutMS / 1000,
+                    (timeoutMS % 1000) * 1000000L };
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(futexWord),
+                    FUTEX_WAIT, expected, &timeout, nullptr, 0);
+        }
+
+        /**
+         * @brief  Wakes all threads sleeping on a futex word.
+         *
+         * @param futexWord  The shared futex word.
+         */
+        inline void futexWake(std::atomic<uint32_t>* futexWord)
+        {
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(futexWord),
+                    FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+        }
+    }
+}
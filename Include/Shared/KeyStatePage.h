@@ -0,0 +1,76 @@
+/**
+ * @file  KeyStatePage.h
+ *
+ * @brief  Defines the shared memory page the KeyDaemon uses to publish which
+ *         tracked keys are currently held down, when built with KD_KEY_STATE.
+ *
+ *  The parent application creates the page file at KD_KEY_STATE_PATH with
+ * owner-only permissions before launching the daemon, and maps it read-only
+ * once it is initialized. The daemon is the page's only writer.
+ *
+ *  Updates are protected by a seqlock: the daemon makes the sequence value odd
+ * while it changes the key bitmap, and even again when it is done. Readers
+ * retry if the sequence value was odd or changed while they copied the
+ * bitmap. Each completed update increases the sequence value by two, so half
+ * the sequence value is the page's generation number.
+ */
+
+#pragma once
+#include <linux/input-event-codes.h>
+#include <atomic>
+#include <cstdint>
+
+namespace KeyDaemon
+{
+    namespace KeyStatePage
+    {
+        // Identifies valid key state pages:
+        static const constexpr uint32_t magic = 0x4B44534B;
+
+        // Current page layout version:
+        static const constexpr uint32_t version = 1;
+
+        // Number of bits stored in each bitmap word:
+        static const constexpr unsigned int wordBits = 64;
+
+        // Number of words needed to hold one bit for each key code:
+        static const constexpr unsigned int wordCount
+                = (KEY_CNT + wordBits - 1) / wordBits;
+
+        /**
+         * @brief  Data stored in the key state page.
+         */
+        struct Page
+        {
+            // Set to KeyStatePage::magic once the page is initialized:
+            uint32_t magic;
+            // Set to KeyStatePage::version:
+            uint32_t version;
+            // Seqlock sequence value, odd while the daemon is updating:
+            std::atomic<uint32_t> sequence;
+            // Bitmap with one bit set for each tracked key held down:
+            std::atomic<uint64_t> pressedKeys[wordCount];
+        };
+
+        static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t)
+                && ATOMIC_LLONG_LOCK_FREE == 2,
+                "Key state words must be lock-free to be shared between "
+                "processes.");
+
+        /**
+         * @brief  Gets the index of the bitmap word holding a key's bit.
+         */
+        constexpr unsigned int wordIndex(const unsigned int keyCode)
+        {
+            return keyCode / wordBits;
+        }
+
+        /**
+         * @brief  Gets the mask for a key's bit within its bitmap word.
+         */
+        constexpr uint64_t bitMask(const unsigned int keyCode)
+        {
+            return uint64_t(1) << (keyCode % wordBits);
+        }
+    }
+}
@@ -0,0 +1,229 @@
+/**
+ * @file  KeyWireFormat.h
+ *
+ * @brief  Encodes and decodes KeyMessage data sent through the KeyDaemon's
+ *         output pipe.
+ *
+ *  By default, each message is packed into four little-endian bytes:
+ *
+ *  | Bits  | Field                                          |
+ *  |-------|------------------------------------------------|
+ *  | 0-9   | Linux key code, or chord or sequence index     |
+ *  | 10-11 | EventType                                      |
+ *  | 12-14 | MessageKind                                    |
+ *  | 15-16 | Format version: 1, or 2 if timestamps are sent |
+ *  | 17-31 | Sequence number, modulo 2^15                   |
+ *
+ *  If KD_TIMESTAMPS is defined, each message is followed by the lowest 32 bits
+ * of the event's KeyMessage::timestamp as four little-endian bytes, so
+ * timestamped messages are no larger than legacy messages. The parent
+ * restores the full timestamp from the time it received the message, which
+ * works as long as messages arrive less than 2^32 microseconds (about 71
+ * minutes) after their events.
+ *
+ *  If KD_LEGACY_MESSAGES is defined, messages are instead sent using the
+ * original eight byte layout: the key code and EventType as two native ints,
+ * and timestamps and sequence numbers are never sent. Messages that aren't
+ * MessageKind::key send -(((kind - 1) * legacyKindBase) + keyCode + 1) in
+ * place of the key code, so chord index 0 is sent as -1. The daemon and its
+ * parent application must be built with the same settings.
+ */
+
+#pragma once
+#include "KeyMessage.h"
+#include <linux/input-event-codes.h>
+#include <limits.h>
+#include <cstdint>
+#include <cstring>
+
+namespace KeyDaemon
+{
+    namespace KeyWireFormat
+    {
+#ifdef KD_LEGACY_MESSAGES
+        // Size in bytes of each encoded message:
+        static const constexpr int messageSize = 2 * sizeof(int);
+
+        // Offset separating the negative codes sent for each MessageKind:
+        static const constexpr int legacyKindBase = 1024;
+#else
+        // Size in bytes of the packed key data word:
+        static const constexpr int wordSize = 4;
+
+    #ifdef KD_TIMESTAMPS
+        // Size in bytes of the encoded timestamp:
+        static const constexpr int timestampSize = 4;
+
+        // Packed format version. Zero is never used, so that zero-filled
+        // data is always rejected:
+        static const constexpr uint32_t version = 2;
+    #else
+        static const constexpr int timestampSize = 0;
+        static const constexpr uint32_t version = 1;
+    #endif
+
+        // Size in bytes of each encoded message:
+        static const constexpr int messageSize = wordSize + timestampSize;
+
+        // Bit offsets and widths of each packed field:
+        static const constexpr int codeShift = 0;
+        static const constexpr int codeBits = 10;
+        static const constexpr int typeShift = 10;
+        static const constexpr int typeBits = 2;
+        static const constexpr int kindShift = 12;
+        static const constexpr int kindBits = 3;
+        static const constexpr int versionShift = 15;
+        static const constexpr int versionBits = 2;
+        static const constexpr int sequenceShift = 17;
+        static const constexpr int sequenceBits = 15;
+
+        // Number of distinct sequence numbers that can be sent:
+        static const constexpr unsigned int sequenceModulus
+                = 1U << sequenceBits;
+
+        static_assert(sequenceShift + sequenceBits == wordSize * 8,
+                "Packed message fields must fill the message exactly.");
+        static_assert(KEY_CNT <= (1 << codeBits),
+                "All key codes must fit in the packed code field.");
+        static_assert(static_cast<int>(EventType::trackedTypeCount)
+                <= (1 << typeBits),
+                "All event types must fit in the packed type field.");
+
+        /**
+         * @brief  Reads a field from a packed message word.
+         */
+        inline uint32_t getField(const uint32_t word, const int shift,
+                const int bits)
+        {
+            return (word >> shift) & ((1U << bits) - 1);
+        }
+#endif
+
+        // Maximum number of messages sent to the parent in a single write.
+        // Message frames stay within PIPE_BUF so each write is atomic, and
+        // frames from different readers are never interleaved:
+        static const constexpr int maxFrameMessages = PIPE_BUF / messageSize;
+
+        // Maximum size in bytes of a single message frame:
+        static const constexpr int maxFrameSize
+                = maxFrameMessages * messageSize;
+
+        /**
+         * @brief  Encodes a key message for transmission to the parent.
+         *
+         * @param message   The message to encode.
+         *
+         * @param sequence  The message's sequence number. Only the lowest
+         *                  sequenceBits bits are sent.
+         *
+         * @param output    A buffer with room for at least messageSize bytes.
+         */
+        inline void encode(const KeyMessage& message,
+                const unsigned int sequence, unsigned char* output)
+        {
+#ifdef KD_LEGACY_MESSAGES
+            const int kindIndex = static_cast<int>(message.kind);
+            const int code = (message.kind == MessageKind::key)
+                    ? message.keyCode
+                    : -(((kindIndex - 1) * legacyKindBase) + message.keyCode
+                        + 1);
+            const int values[2] = { code, static_cast<int>(message.event) };
+            std::memcpy(output, values, messageSize);
+#else
+            const uint32_t word
+                    = (static_cast<uint32_t>(message.keyCode) << codeShift)
+                    | (static_cast<uint32_t>(message.event) << typeShift)
+                    | (static_cast<uint32_t>(message.kind) << kindShift)
+                    | (version << versionShift)
+                    | (static_cast<uint32_t>(sequence) << sequenceShift);
+            output[0] = static_cast<unsigned char>(word);
+            output[1] = static_cast<unsigned char>(word >> 8);
+            output[2] = static_cast<unsigned char>(word >> 16);
+            output[3] = static_cast<unsigned char>(word >> 24);
+            for (int i = 0; i < timestampSize; i++)
+            {
+                output[wordSize + i] = static_cast<unsigned char>
+                        (message.timestamp >> (i * 8));
+            }
+#endif
+        }
+
+        /**
+         * @brief  Decodes a key message received from the daemon, checking
+         *         that its format, event type, and kind are valid.
+         *
+         * @param input    A buffer holding at least messageSize bytes of
+         *                 encoded message data.
+         *
+         * @param message      Used to return the decoded message.
+         *
+         * @param receiveTime  The CLOCK_MONOTONIC time when the message was
+         *                     received, in the same units as the daemon's
+         *                     timestamps. This is used to restore the full
+         *                     timestamp, and ignored if timestamps aren't
+         *                     sent.
+         *
+         * @return             Whether the message was valid. If false,
+         *                     message is left unchanged.
+         */
+        inline bool decode(const unsigned char* input, KeyMessage& message,
+                const uint64_t receiveTime)
+        {
+#ifdef KD_LEGACY_MESSAGES
+            int values[2];
+            std::memcpy(values, input, messageSize);
+            int keyCode = values[0];
+            int kind = static_cast<int>(MessageKind::key);
+            if (keyCode < 0)
+            {
+                const int kindCode = -keyCode - 1;
+                keyCode = kindCode % legacyKindBase;
+                kind = (kindCode / legacyKindBase) + 1;
+            }
+            const int eventType = values[1];
+#else
+            const uint32_t word = static_cast<uint32_t>(input[0])
+                    | (static_cast<uint32_t>(input[1]) << 8)
+                    | (static_cast<uint32_t>(input[2]) << 16)
+                    | (static_cast<uint32_t>(input[3]) << 24);
+            if (getField(word, versionShift, versionBits) != version)
+            {
+                return false;
+            }
+            const int keyCode = getField(word, codeShift, codeBits);
+            const int kind = getField(word, kindShift, kindBits);
+            const int eventType = getField(word, typeShift, typeBits);
+            const unsigned int sequence = getField(word, sequenceShift,
+                    sequenceBits);
+            uint32_t sentTime = 0;
+            for (int i = 0; i < timestampSize; i++)
+            {
+                sentTime |= static_cast<uint32_t>(input[wordSize + i])
+                        << (i * 8);
+            }
+            // Zero still means the daemon had no timestamp. Otherwise, the
+            // event happened at most 2^32 units before it was received:
+            const uint32_t age = static_cast<uint32_t>(receiveTime) - sentTime;
+            const uint64_t timestamp = (sentTime == 0 || age > receiveTime)
+                    ? sentTime : (receiveTime - age);
+#endif
+            if (eventType < 0 || eventType
+                    >= static_cast<int>(EventType::trackedTypeCount)
+                    || kind > static_cast<int>(MessageKind::ready))
+            {
+                return false;
+            }
+            message.keyCode = keyCode;
+            message.event = static_cast<EventType>(eventType);
+            message.kind = static_cast<MessageKind>(kind);
+#ifdef KD_LEGACY_MESSAGES
+            message.timestamp = 0;
+            message.sequence = 0;
+#else
+            message.timestamp = timestamp;
+            message.sequence = sequence;
+#endif
+            return true;
+        }
+    }
+}
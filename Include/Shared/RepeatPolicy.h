@@ -0,0 +1,25 @@
+/**
+ * @file  RepeatPolicy.h
+ *
+ * @brief  Defines how the KeyDaemon handles key repeat events sent while
+ *         tracked keys are held down.
+ */
+
+#pragma once
+
+namespace KeyDaemon
+{
+    enum class RepeatPolicy
+    {
+        // Send every repeat event:
+        passThrough = 0,
+        // Never send repeat events:
+        suppress = 1,
+        // Send no more than a fixed number of repeat events per second for
+        // each held key:
+        rateLimit = 2,
+        // Send only the first repeat event for each held key, and send the
+        // number of repeats along with the key's release:
+        collapse = 3
+    };
+}
@@ -0,0 +1,59 @@
+/**
+ * @file  SharedFile.h
+ *
+ * @brief  Creates and maps the owner-only files used to share memory between
+ *         the KeyDaemon and its parent application.
+ */
+
+#pragma once
+#include <cstddef>
+
+namespace KeyDaemon
+{
+    namespace SharedFile
+    {
+        /**
+         * @brief  Creates a new zero-filled file with owner-only permissions,
+         *         replacing any existing file at the same path, and maps it
+         *         into memory for reading and writing.
+         *
+         *  This is used by the parent application, before the daemon is
+         * launched.
+         *
+         * @param path  The path where the file will be created.
+         *
+         * @param size  The size in bytes of the file.
+         *
+         * @return      The mapped file data, or nullptr if the file couldn't
+         *              be created or mapped.
+         */
+        void* create(const char* path, const size_t size);
+
+        /**
+         * @brief  Maps an existing shared file into memory for reading and
+         *         writing, if it is safe to use.
+         *
+         *  This is used by the daemon. The daemon may be able to open files
+         * its user doesn't own, so the file must be a regular file owned by
+         * the daemon's real user, with no group or other permissions, and at
+         * least as large as the requested size.
+         *
+         * @param path  The path to a file created by the parent application.
+         *
+         * @param size  The size in bytes to map.
+         *
+         * @return      The mapped file data, or nullptr if the file was
+         *              invalid or couldn't be mapped.
+         */
+        void* open(const char* path, const size_t size);
+
+        /**
+         * @brief  Unmaps shared file data.
+         *
+         * @param data  Data returned by create or open, or nullptr.
+         *
+         * @param size  The size that was mapped.
+         */
+        void unmap(void* data, const size_t size);
+    }
+}
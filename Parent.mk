@@ -18,6 +18,16 @@ define KD_HELPTEXT
 #    - KD_VERBOSE
 #    - KD_OPTIMIZATION
 #    - KD_GDB_SUPPORT
+#    - KD_BAKED_KEYS
+#    - KD_LEGACY_MESSAGES
+#    - KD_TIMESTAMPS
+#    - KD_SHM_TRANSPORT
+#    - KD_SHM_PATH
+#    - KD_RING_CAPACITY
+#    - KD_KEY_STATE
+#    - KD_KEY_STATE_PATH
+#    - KD_CONTROL
+#    - KD_CONTROL_PATH
 #    
 # 3. If necessary, define CFLAGS, CXXFLAGS, and/or CPPFLAGS with any extra
 #    compilation flags that should be used when compiling KeyDaemon code files.
@@ -51,6 +61,33 @@ KD_V_AT:=$(shell if [ $(KD_VERBOSE) != 1 ]; then echo '@'; fi)
 # Select specific build architectures:
 KD_TARGET_ARCH?=-march=native
 
+# Key codes built into the daemon, if the daemon was built with KD_BAKED_KEYS:
+KD_BAKED_KEYS?=
+
+# Receive key messages using the original eight byte layout, if the daemon was
+# built with KD_LEGACY_MESSAGES=1:
+KD_LEGACY_MESSAGES?=0
+
+# Receive key event timestamps, if the daemon was built with KD_TIMESTAMPS=1.
+# Timestamped messages take eight bytes instead of four:
+KD_TIMESTAMPS?=1
+
+# Receive key messages through a shared memory ring, if the daemon was built
+# with KD_SHM_TRANSPORT=1:
+KD_SHM_TRANSPORT?=0
+KD_SHM_PATH?=$(KD_PIPE_PATH).ring
+KD_RING_CAPACITY?=4096
+
+# Read held keys from a shared key state page, if the daemon was built with
+# KD_KEY_STATE=1:
+KD_KEY_STATE?=0
+KD_KEY_STATE_PATH?=$(KD_PIPE_PATH).state
+
+# Send commands to the daemon through a control FIFO, if the daemon was built
+# with KD_CONTROL=1:
+KD_CONTROL?=0
+KD_CONTROL_PATH?=$(KD_PIPE_PATH).control
+
 ################ Configure and include framework makefile: ####################
 DAEMON_FRAMEWORK_DIR?=$(KD_PROJECT_DIR)/deps/DaemonFramework
 DF_CONFIG:=$(KD_CONFIG)
@@ -110,7 +147,31 @@ KD_DEPFLAGS:=$(if $(word 2, $(DF_TARGET_ARCH)), , -MMD)
 KD_DEFINE_FLAGS:=$(call addDef,KD_KEY_LIMIT) \
                  $(call addDef,KD_VERBOSE) \
                  $(call addStringDef,KD_DAEMON_PATH) \
-                 $(call addStringDef,KD_PIPE_PATH)
+                 $(call addStringDef,KD_PIPE_PATH) \
+                 $(call addDef,KD_RING_CAPACITY)
+
+ifneq ($(KD_BAKED_KEYS),)
+    KD_DEFINE_FLAGS+= -DKD_BAKED_KEYS=$(KD_BAKED_KEYS)
+endif
+
+ifeq ($(KD_SHM_TRANSPORT),1)
+    KD_DEFINE_FLAGS+= -DKD_SHM_TRANSPORT=1 $(call addStringDef,KD_SHM_PATH)
+endif
+
+ifeq ($(KD_KEY_STATE),1)
+    KD_DEFINE_FLAGS+= -DKD_KEY_STATE=1 \
+                      $(call addStringDef,KD_KEY_STATE_PATH)
+endif
+
+ifeq ($(KD_CONTROL),1)
+    KD_DEFINE_FLAGS+= -DKD_CONTROL=1 $(call addStringDef,KD_CONTROL_PATH)
+endif
+
+ifeq ($(KD_LEGACY_MESSAGES),1)
+    KD_DEFINE_FLAGS+= -DKD_LEGACY_MESSAGES=1
+else ifeq ($(KD_TIMESTAMPS),1)
+    KD_DEFINE_FLAGS+= -DKD_TIMESTAMPS=1
+endif
 
 KD_CPPFLAGS:=-pthread \
              $(KD_DEPFLAGS) \
@@ -121,7 +182,9 @@ KD_CPPFLAGS:=-pthread \
              $(DF_INCLUDE_FLAGS) \
              $(KD_CPPFLAGS)
 
-KD_OBJECTS:=$(KD_OBJDIR)/Controller.o $(KD_OBJDIR)/EventType.o
+KD_OBJECTS:=$(KD_OBJDIR)/Controller.o $(KD_OBJDIR)/EventType.o \
+            $(KD_OBJDIR)/RingReader.o $(KD_OBJDIR)/SharedFile.o \
+            $(KD_OBJDIR)/KeyStateReader.o $(KD_OBJDIR)/ControlWriter.o
 
 KD_PARENT_DEPS:=kd-check-defs $(KD_OBJECTS)
 
@@ -177,3 +240,11 @@ $(KD_OBJDIR)/Controller.o: \
 	$(KD_SOURCE_DIR)/Controller.cpp
 $(KD_OBJDIR)/EventType.o: \
 	$(KD_SOURCE_DIR)/EventType.cpp
+$(KD_OBJDIR)/RingReader.o: \
+	$(KD_SOURCE_DIR)/RingReader.cpp
+$(KD_OBJDIR)/SharedFile.o: \
+	$(KD_SOURCE_DIR)/SharedFile.cpp
+$(KD_OBJDIR)/KeyStateReader.o: \
+	$(KD_SOURCE_DIR)/KeyStateReader.cpp
+$(KD_OBJDIR)/ControlWriter.o: \
+	$(KD_SOURCE_DIR)/ControlWriter.cpp
@@ -0,0 +1,135 @@
+#include "ChordMatcher.h"
+#include "KDDebug.h"
+#include <algorithm>
+
+#ifdef KD_DEBUG
+static const constexpr char* messagePrefix = "KeyDaemon::ChordMatcher::";
+#endif
+
+
+// Builds chord membership tables on construction.
+KeyDaemon::ChordMatcher::ChordMatcher(const KeySet& forwardedKeys,
+        const std::vector<std::vector<int>>& chords) :
+forwardedKeys(forwardedKeys)
+{
+    for (size_t i = 0; i < chords.size(); i++)
+    {
+        if (i >= maxChords || ! isValidChord(chords[i]))
+        {
+            DBG(messagePrefix << __func__ << ": Ignoring invalid chord " << i);
+            continue;
+        }
+        const std::vector<int>& chordKeys = chords[i];
+        for (const int keyCode : chordKeys)
+        {
+            chordMasks[keyCode] |= (uint64_t(1) << i);
+        }
+        chordSizes[i] = static_cast<uint8_t>(chordKeys.size());
+        chordCount = std::max(chordCount, static_cast<int>(i) + 1);
+    }
+    DBG_V(messagePrefix << __func__ << ": Registered " << chordCount
+            << " chords.");
+}
+
+
+// Checks if a list of key codes can be registered as a chord.
+bool KeyDaemon::ChordMatcher::isValidChord(const std::vector<int>& chordKeys)
+{
+    if (chordKeys.size() < 2 || chordKeys.size() > maxChordKeys)
+    {
+        return false;
+    }
+    std::vector<int> sortedKeys = chordKeys;
+    std::sort(sortedKeys.begin(), sortedKeys.end());
+    return sortedKeys.front() > KEY_RESERVED && sortedKeys.back() < KEY_CNT
+            && std::adjacent_find(sortedKeys.begin(), sortedKeys.end())
+                == sortedKeys.end();
+}
+
+
+// Checks if any chords were registered.
+bool KeyDaemon::ChordMatcher::hasChords() const
+{
+    return chordCount > 0;
+}
+
+
+// Replaces the keys and event types sent to the parent as individual key
+// events.
+void KeyDaemon::ChordMatcher::setForwardedKeys(const KeySet& forwardedKeys)
+{
+    this->forwardedKeys = forwardedKeys;
+}
+
+
+// Updates held key state with a new key event, and finds the messages that
+// should be sent because of it.
+int KeyDaemon::ChordMatcher::process(const KeyMessage& message,
+        KeyMessage* output)
+{
+    int outputCount = 0;
+    const unsigned int keyCode = static_cast<unsigned int>(message.keyCode);
+    if (forwardedKeys.accepts(keyCode,
+            static_cast<unsigned int>(message.event)))
+    {
+        output[outputCount++] = message;
+    }
+    if (keyCode >= KEY_CNT || message.event == EventType::held)
+    {
+        return outputCount;
+    }
+    // Adds a chord message for each chord in a mask:
+    auto addChordMessages = [&output, &outputCount, &message]
+            (uint64_t chords, const EventType type)
+    {
+        while (chords != 0)
+        {
+            const int chordIndex = __builtin_ctzll(chords);
+            chords &= chords - 1;
+            KeyMessage& chordMessage = output[outputCount++];
+            chordMessage.keyCode = chordIndex;
+            chordMessage.event = type;
+            chordMessage.timestamp = message.timestamp;
+            chordMessage.kind = MessageKind::chord;
+        }
+    };
+    uint64_t memberChords = chordMasks[keyCode];
+    if (message.event == EventType::pressed)
+    {
+        // Another keyboard may already be holding the same key:
+        if (heldKeys[keyCode])
+        {
+            return outputCount;
+        }
+        heldKeys[keyCode] = true;
+        heldKeyCount++;
+        uint64_t firedChords = 0;
+        for (uint64_t chords = memberChords; chords != 0; chords &= chords - 1)
+        {
+            const int chordIndex = __builtin_ctzll(chords);
+            heldChordKeys[chordIndex]++;
+            if (heldChordKeys[chordIndex] == chordSizes[chordIndex]
+                    && heldKeyCount == chordSizes[chordIndex])
+            {
+                firedChords |= (uint64_t(1) << chordIndex);
+            }
+        }
+        activeChords |= firedChords;
+        addChordMessages(firedChords, EventType::pressed);
+        return outputCount;
+    }
+    if (! heldKeys[keyCode])
+    {
+        return outputCount;
+    }
+    heldKeys[keyCode] = false;
+    heldKeyCount--;
+    const uint64_t endedChords = activeChords & memberChords;
+    activeChords &= ~endedChords;
+    for (; memberChords != 0; memberChords &= memberChords - 1)
+    {
+        heldChordKeys[__builtin_ctzll(memberChords)]--;
+    }
+    addChordMessages(endedChords, EventType::released);
+    return outputCount;
+}
@@ -0,0 +1,104 @@
+#include "ControlReader.h"
+#include "KDDebug.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef KD_DEBUG
+static const constexpr char* messagePrefix = "KeyDaemon::ControlReader::";
+#endif
+
+
+// Opens the control FIFO on construction, if it is safe to use.
+KeyDaemon::ControlReader::ControlReader(const char* fifoPath)
+{
+    // Opening for reading and writing never blocks, and the FIFO never
+    // reports end of file when the parent closes its end:
+    fifoFD = open(fifoPath, O_RDWR | O_NONBLOCK | O_NOFOLLOW | O_CLOEXEC);
+    if (fifoFD < 0)
+    {
+        DBG(messagePrefix << __func__ << ": Failed to open \"" << fifoPath
+                << "\"");
+        return;
+    }
+    struct stat fileStat;
+    if (fstat(fifoFD, &fileStat) != 0 || ! S_ISFIFO(fileStat.st_mode)
+            || fileStat.st_uid != getuid()
+            || (fileStat.st_mode & (S_IRWXG | S_IRWXO)) != 0)
+    {
+        DBG(messagePrefix << __func__ << ": \"" << fifoPath
+                << "\" has an invalid type, owner, or permissions.");
+        close(fifoFD);
+        fifoFD = -1;
+        return;
+    }
+    DBG_V(messagePrefix << __func__ << ": Reading commands from \""
+            << fifoPath << "\".");
+}
+
+
+// Closes the control FIFO on destruction.
+KeyDaemon::ControlReader::~ControlReader()
+{
+    if (fifoFD >= 0)
+    {
+        close(fifoFD);
+    }
+}
+
+
+// Checks if the control FIFO was opened.
+bool KeyDaemon::ControlReader::isOpen() const
+{
+    return fifoFD >= 0;
+}
+
+
+// Gets the descriptor that becomes readable when the parent sends a command.
+int KeyDaemon::ControlReader::getFileDescriptor() const
+{
+    return fifoFD;
+}
+
+
+// Reads the next pending command without blocking.
+bool KeyDaemon::ControlReader::readCommand(Command& command)
+{
+    using namespace ControlFormat;
+    unsigned char header[wordSize];
+    const ssize_t headerSize = (fifoFD < 0) ? -1
+            : read(fifoFD, header, wordSize);
+    if (headerSize <= 0)
+    {
+        return false;
+    }
+    // Commands are written whole, so their key entries are always ready:
+    unsigned char keyData[maxKeys * wordSize];
+    int keyCount = 0;
+    if (headerSize != wordSize
+            || ! decodeHeader(header, command.type, keyCount)
+            || (keyCount > 0 && read(fifoFD, keyData, keyCount * wordSize)
+                != keyCount * wordSize))
+    {
+        DBG(messagePrefix << __func__
+                << ": Received an invalid command, discarding input.");
+        discardInput();
+        return false;
+    }
+    command.keyCodes.resize(keyCount);
+    command.eventMasks.resize(keyCount);
+    for (int i = 0; i < keyCount; i++)
+    {
+        decodeKey(keyData + (i * wordSize), command.keyCodes[i],
+                command.eventMasks[i]);
+    }
+    return true;
+}
+
+
+// Discards all data waiting in the FIFO.
+void KeyDaemon::ControlReader::discardInput()
+{
+    unsigned char buffer[PIPE_BUF];
+    while (read(fifoFD, buffer, sizeof(buffer)) > 0) { }
+}
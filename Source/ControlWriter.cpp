@@ -0,0 +1,102 @@
+#include "ControlWriter.h"
+#include "KDDebug.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <ctime>
+
+#ifdef KD_DEBUG
+static const constexpr char* messagePrefix = "KeyDaemon::ControlWriter::";
+#endif
+
+
+// Saves the control FIFO path on construction.
+KeyDaemon::ControlWriter::ControlWriter(const char* fifoPath) :
+fifoPath(fifoPath) { }
+
+
+// Closes and removes the control FIFO on destruction.
+KeyDaemon::ControlWriter::~ControlWriter()
+{
+    if (fifoFD >= 0)
+    {
+        close(fifoFD);
+    }
+    unlink(fifoPath.c_str());
+}
+
+
+// Creates a new control FIFO with owner-only permissions, replacing any
+// existing FIFO.
+bool KeyDaemon::ControlWriter::create()
+{
+    if (fifoFD >= 0)
+    {
+        close(fifoFD);
+        fifoFD = -1;
+    }
+    // Never reuse an existing file, as it may not have been created by this
+    // user or with the correct permissions:
+    unlink(fifoPath.c_str());
+    if (mkfifo(fifoPath.c_str(), S_IRUSR | S_IWUSR) != 0)
+    {
+        DBG(messagePrefix << __func__ << ": Failed to create \"" << fifoPath
+                << "\"");
+        return false;
+    }
+    return true;
+}
+
+
+// Sends a single command to the daemon.
+bool KeyDaemon::ControlWriter::send(const ControlFormat::Command command,
+        const std::vector<int>& keyCodes,
+        const std::vector<EventMask>& eventMasks)
+{
+    unsigned char data[ControlFormat::maxCommandSize];
+    const int size = ControlFormat::encode(command, keyCodes, eventMasks,
+            data);
+    if (size == 0)
+    {
+        DBG(messagePrefix << __func__ << ": Too many or invalid key codes, "
+                << "command not sent.");
+        return false;
+    }
+    // Opening fails until the daemon has opened the FIFO for reading:
+    if (fifoFD < 0)
+    {
+        fifoFD = open(fifoPath.c_str(),
+                O_WRONLY | O_NONBLOCK | O_NOFOLLOW | O_CLOEXEC);
+        if (fifoFD < 0)
+        {
+            DBG_V(messagePrefix << __func__
+                    << ": Daemon isn't reading commands yet.");
+            return false;
+        }
+    }
+    // Writing after the daemon exits raises SIGPIPE, which would otherwise
+    // close the parent:
+    sigset_t pipeSignal;
+    sigset_t previousMask;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, &previousMask);
+    const ssize_t written = write(fifoFD, data, size);
+    if (written < 0 && errno == EPIPE)
+    {
+        const struct timespec noWait = { 0, 0 };
+        sigtimedwait(&pipeSignal, nullptr, &noWait);
+        close(fifoFD);
+        fifoFD = -1;
+    }
+    pthread_sigmask(SIG_SETMASK, &previousMask, nullptr);
+    if (written != size)
+    {
+        DBG(messagePrefix << __func__ << ": Failed to send command "
+                << static_cast<int>(command) << ".");
+        return false;
+    }
+    return true;
+}
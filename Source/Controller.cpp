@@ -1,71 +1,434 @@
 #include "Controller.h"
+#include "BakedKeys.h"
+#include "KeyWireFormat.h"
 #include "KDDebug.h"
 #include <algorithm>
+#include <chrono>
+#include <ctime>
 
 #ifdef KD_DEBUG
 static const constexpr char* messagePrefix = "KeyDaemon::Controller::";
 #endif
 
+// Maximum time in milliseconds to wait for the ready message before checking
+// if the daemon is still running:
+static const constexpr int readyCheckMS = 50;
+
 
 // Configures the daemon output pipe on construction.
 KeyDaemon::Controller::Controller() :
 DaemonFramework::DaemonControl(KD_DAEMON_PATH, "", KD_PIPE_PATH,
-        sizeof(KeyMessage)) { }
+        KeyWireFormat::maxFrameSize),
+lostMessageCount(0)
+#ifdef KD_SHM_TRANSPORT
+, ringReader(KD_SHM_PATH)
+#endif
+#ifdef KD_KEY_STATE
+, keyState(KD_KEY_STATE_PATH)
+#endif
+#ifdef KD_CONTROL
+, controlWriter(KD_CONTROL_PATH)
+#endif
+{ }
 
 
 // Launches the KeyDaemon if it isn't already running.
 void KeyDaemon::Controller::startKeyDaemon
-(const std::vector<int> trackedKeyCodes)
+(const std::vector<int> trackedKeyCodes,
+        const std::vector<std::vector<int>>& chords,
+        const std::vector<std::vector<int>>& sequences,
+        const std::vector<KeyGesture>& gestures,
+        const std::vector<EventMask>& eventMasks)
 {
+    // Newly launched daemons start counting message sequence numbers at zero:
+    if (! isDaemonRunning())
+    {
+        expectedSequence = 0;
+        lostMessageCount = 0;
+        {
+            std::lock_guard<std::mutex> lock(readyLock);
+            readyDeviceCount = -1;
+        }
+        #ifdef KD_SHM_TRANSPORT
+        if (! ringReader.start(this))
+        {
+            DBG(messagePrefix << __func__
+                    << ": Failed to create message ring, using pipe.");
+        }
+        #endif
+        #ifdef KD_KEY_STATE
+        if (! keyState.create())
+        {
+            DBG(messagePrefix << __func__
+                    << ": Failed to create key state page.");
+        }
+        #endif
+        #ifdef KD_CONTROL
+        if (! controlWriter.create())
+        {
+            DBG(messagePrefix << __func__
+                    << ": Failed to create control FIFO.");
+        }
+        #endif
+    }
+    #ifdef KD_BAKED_KEYS
+    // The daemon rejects key code arguments when its keys are built in:
+    DBG_V(messagePrefix << __func__ << ": Launching daemon with "
+            << BakedKeys::count << " built-in key codes, ignoring "
+            << trackedKeyCodes.size() << " requested codes.");
+    if (! chords.empty() || ! sequences.empty() || ! gestures.empty())
+    {
+        DBG(messagePrefix << __func__ << ": Ignoring " << chords.size()
+                << " chords, " << sequences.size() << " sequences, and "
+                << gestures.size()
+                << " gestures, the daemon was built with fixed key codes.");
+    }
+    std::vector<std::string> policyArguments;
+    if (! repeatArgument.empty())
+    {
+        policyArguments.push_back(repeatArgument);
+    }
+    {
+        std::lock_guard<std::mutex> lock(keyCodeLock);
+        keyCodes = BakedKeys::getCodes();
+        chordCount = 0;
+        sequenceCount = 0;
+        gestureKeys.clear();
+    }
+    startDaemon(policyArguments, this);
+    #else
     DBG_V(messagePrefix << __func__ << ": Launching daemon to track "
-            << trackedKeyCodes.size() << " key codes.");
+            << trackedKeyCodes.size() << " key codes, " << chords.size()
+            << " chords, " << sequences.size() << " sequences, and "
+            << gestures.size() << " gestures.");
     std::vector<std::string> codeArguments;
-    codeArguments.reserve(trackedKeyCodes.size());
-    for (const int& code : trackedKeyCodes)
+    codeArguments.reserve(trackedKeyCodes.size() + chords.size()
+            + sequences.size() + gestures.size() + 1);
+    // Key codes that don't send every event type end with '/' and their
+    // EventMask:
+    for (size_t i = 0; i < trackedKeyCodes.size(); i++)
+    {
+        std::string codeArgument = std::to_string(trackedKeyCodes[i]);
+        if (i < eventMasks.size() && eventMasks[i] != allEventTypes)
+        {
+            codeArgument += '/' + std::to_string(eventMasks[i]);
+        }
+        codeArguments.push_back(codeArgument);
+    }
+    // Chord arguments join their key codes with '+', and sequence arguments
+    // join them with ',':
+    auto addKeyListArguments = [&codeArguments]
+            (const std::vector<std::vector<int>>& keyLists,
+            const char separator)
+    {
+        for (const std::vector<int>& keyList : keyLists)
+        {
+            std::string listArgument;
+            for (const int& code : keyList)
+            {
+                if (! listArgument.empty())
+                {
+                    listArgument += separator;
+                }
+                listArgument += std::to_string(code);
+            }
+            codeArguments.push_back(listArgument);
+        }
+    };
+    addKeyListArguments(chords, '+');
+    addKeyListArguments(sequences, ',');
+    // Gesture arguments join each key code and its thresholds with ':':
+    std::vector<int> newGestureKeys;
+    for (const KeyGesture& gesture : gestures)
+    {
+        codeArguments.push_back(std::to_string(gesture.keyCode) + ':'
+                + std::to_string(gesture.longPressMS) + ':'
+                + std::to_string(gesture.doubleTapMS));
+        newGestureKeys.push_back(gesture.keyCode);
+    }
+    if (! repeatArgument.empty())
+    {
+        codeArguments.push_back(repeatArgument);
+    }
+    // Accept the new keys before the daemon can send them:
     {
-        codeArguments.push_back(std::to_string(code));
+        std::lock_guard<std::mutex> lock(keyCodeLock);
+        keyCodes = trackedKeyCodes;
+        chordCount = chords.size();
+        sequenceCount = sequences.size();
+        gestureKeys = newGestureKeys;
     }
     startDaemon(codeArguments, this);
     DBG_V(messagePrefix << __func__ << ": Launching daemon with "
             << codeArguments.size() << " tracked code arguments.");
-    keyCodes = trackedKeyCodes;
+    #endif
 }
 
 
-// Receives keyboard event data from the daemon output pipe, and passes it to
-// the handleKeyEvent method if its data is valid.
+// Selects how the KeyDaemon sends repeat events for held keys the next time it
+// is launched.
+void KeyDaemon::Controller::setRepeatPolicy(const RepeatPolicy policy,
+        const unsigned int rateHz)
+{
+    switch (policy)
+    {
+        case RepeatPolicy::passThrough:
+            repeatArgument.clear();
+            break;
+        case RepeatPolicy::suppress:
+            repeatArgument = "repeat=suppress";
+            break;
+        case RepeatPolicy::rateLimit:
+            repeatArgument = "repeat=" + std::to_string(rateHz);
+            break;
+        case RepeatPolicy::collapse:
+            repeatArgument = "repeat=collapse";
+            break;
+    }
+}
+
+
+// Blocks until the KeyDaemon reports that it opened its keyboard event files
+// and is ready to read key events.
+int KeyDaemon::Controller::waitForDaemonReady(const int timeoutMS)
+{
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point deadline = Clock::now()
+            + std::chrono::milliseconds(timeoutMS);
+    std::unique_lock<std::mutex> lock(readyLock);
+    // The daemon may exit without ever becoming ready, so wake periodically
+    // to check that it's still running:
+    while (readyDeviceCount < 0 && isDaemonRunning())
+    {
+        const Clock::time_point now = Clock::now();
+        Clock::time_point wakeTime = now
+                + std::chrono::milliseconds(readyCheckMS);
+        if (timeoutMS >= 0)
+        {
+            if (now >= deadline)
+            {
+                break;
+            }
+            wakeTime = std::min(wakeTime, deadline);
+        }
+        readyCondition.wait_until(lock, wakeTime);
+    }
+    return readyDeviceCount;
+}
+
+
+#ifdef KD_CONTROL
+// Replaces the set of individually tracked keys in the running KeyDaemon,
+// without relaunching it.
+bool KeyDaemon::Controller::setTrackedKeys
+(const std::vector<int>& trackedKeyCodes,
+        const std::vector<EventMask>& eventMasks)
+{
+    #ifdef KD_BAKED_KEYS
+    DBG(messagePrefix << __func__ << ": Can't replace tracked keys, the "
+            << "daemon was built with fixed key codes.");
+    return false;
+    #else
+    if (! isDaemonRunning())
+    {
+        return false;
+    }
+    // Accept the new keys before the daemon can send them:
+    std::vector<int> previousCodes;
+    {
+        std::lock_guard<std::mutex> lock(keyCodeLock);
+        previousCodes = keyCodes;
+        keyCodes = trackedKeyCodes;
+    }
+    if (! controlWriter.send(ControlFormat::Command::setKeys,
+            trackedKeyCodes, eventMasks))
+    {
+        std::lock_guard<std::mutex> lock(keyCodeLock);
+        keyCodes = previousCodes;
+        return false;
+    }
+    DBG_V(messagePrefix << __func__ << ": Sent " << trackedKeyCodes.size()
+            << " tracked key codes to the daemon.");
+    return true;
+    #endif
+}
+
+
+// Stops the running KeyDaemon from reading key events until resumeKeyDaemon
+// is called.
+bool KeyDaemon::Controller::pauseKeyDaemon()
+{
+    return isDaemonRunning()
+            && controlWriter.send(ControlFormat::Command::pause);
+}
+
+
+// Lets a paused KeyDaemon read and send key events again.
+bool KeyDaemon::Controller::resumeKeyDaemon()
+{
+    return isDaemonRunning()
+            && controlWriter.send(ControlFormat::Command::resume);
+}
+#endif
+
+
+// Receives frames of keyboard event data from the daemon output pipe, and
+// passes each message to the handleKeyEvent method in order if its data is
+// valid.
 void KeyDaemon::Controller::processData
 (const unsigned char* data, const size_t size)
 {
-    if (size != sizeof(KeyMessage))
+    using KeyWireFormat::messageSize;
+    if (size == 0 || (size % messageSize) != 0)
     {
         DBG(messagePrefix << __func__ << ": Received illegal message size "
-                << size << " from KeyDaemon, expected " << sizeof(KeyMessage));
+                << size << " from KeyDaemon, expected a multiple of "
+                << messageSize);
         return;
     }
-    DBG_V(messagePrefix << __func__
-            << ": Received key message with expected size " << size);
-    // Cast to int pointer first to validate event codes. This assertion
-    // shouldn't ever fail, unless the compiler is doing something truly
-    // strange.
-    ASSERT(sizeof(KeyMessage) == 2 * sizeof(int));
-    const int* numericData = reinterpret_cast<const int*>(data);
-    const int keyCode = numericData[0];
-    const int eventType = numericData[1];
-    if (std::find(keyCodes.begin(), keyCodes.end(), keyCode) == keyCodes.end())
-    {
-        DBG(messagePrefix << __func__ << ": Received illegal key code "
-                << keyCode << " from KeyDaemon.");
+    const size_t messageCount = size / messageSize;
+    DBG_V(messagePrefix << __func__ << ": Received frame of " << messageCount
+            << " key messages.");
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    const uint64_t receiveTime = static_cast<uint64_t>(currentTime.tv_sec)
+            * 1000000 + currentTime.tv_nsec / 1000;
+    for (size_t i = 0; i < messageCount; i++)
+    {
+        processMessage(data + (i * messageSize), receiveTime);
+    }
+}
+
+
+// Validates a single key message, passing it to the handleKeyEvent,
+// handleChordEvent, handleSequenceEvent, handleGestureEvent, or
+// handleDaemonReady method if its data is valid.
+void KeyDaemon::Controller::processMessage(const unsigned char* data,
+        const uint64_t receiveTime)
+{
+    KeyMessage message;
+    if (! KeyWireFormat::decode(data, message, receiveTime))
+    {
+        DBG(messagePrefix << __func__
+                << ": Received message with an invalid format version or "
+                << "event type from KeyDaemon.");
         return;
     }
-    if (eventType < 0 || eventType >= 
-            static_cast<int>(EventType::trackedTypeCount))
+    // Rejected messages still used a sequence number, so check it first to
+    // keep them from being counted as lost:
+    checkSequence(message.sequence);
+    // Repeat counts only apply to the release sent directly after them:
+    const unsigned int repeatCount = pendingRepeatCount;
+    pendingRepeatCount = 0;
+    // Chord and sequence messages hold indices instead of key codes:
+    auto isValidIndex = [&message](const size_t indexCount)
     {
-        DBG(messagePrefix << __func__ 
-                << ": Received illegal event type value " << eventType
-                << " from KeyDaemon.");
+        return message.keyCode >= 0
+                && static_cast<size_t>(message.keyCode) < indexCount;
+    };
+    bool validCode = false;
+    // Keys, chords, sequences, and gestures may be replaced by another thread
+    // while messages are validated:
+    std::unique_lock<std::mutex> keyLock(keyCodeLock);
+    switch (message.kind)
+    {
+        case MessageKind::key:
+            validCode = std::find(keyCodes.begin(), keyCodes.end(),
+                    message.keyCode) != keyCodes.end();
+            break;
+        case MessageKind::chord:
+            validCode = isValidIndex(chordCount);
+            break;
+        case MessageKind::sequence:
+            validCode = isValidIndex(sequenceCount);
+            break;
+        case MessageKind::longPress:
+        case MessageKind::doubleTap:
+            validCode = std::find(gestureKeys.begin(), gestureKeys.end(),
+                    message.keyCode) != gestureKeys.end();
+            break;
+        case MessageKind::repeatCount:
+            validCode = message.keyCode > 0;
+            break;
+        case MessageKind::ready:
+            validCode = message.keyCode >= 0;
+            break;
+    }
+    keyLock.unlock();
+    if (! validCode)
+    {
+        DBG(messagePrefix << __func__ << ": Received illegal key code or "
+                << "index " << message.keyCode << " for message kind "
+                << static_cast<int>(message.kind) << " from KeyDaemon.");
         return;
     }
-    const KeyMessage message = { keyCode, static_cast<EventType>(eventType) };
-    handleKeyEvent(message);
+    switch (message.kind)
+    {
+        case MessageKind::key:
+            if (message.event == EventType::released)
+            {
+                message.repeatCount = repeatCount;
+            }
+            handleKeyEvent(message);
+            break;
+        case MessageKind::chord:
+            handleChordEvent(message);
+            break;
+        case MessageKind::sequence:
+            handleSequenceEvent(message);
+            break;
+        case MessageKind::longPress:
+        case MessageKind::doubleTap:
+            handleGestureEvent(message);
+            break;
+        case MessageKind::repeatCount:
+            pendingRepeatCount = static_cast<unsigned int>(message.keyCode);
+            break;
+        case MessageKind::ready:
+            {
+                std::lock_guard<std::mutex> lock(readyLock);
+                readyDeviceCount = message.keyCode;
+            }
+            readyCondition.notify_all();
+            handleDaemonReady(message);
+            break;
+    }
+}
+
+
+// Checks a received message's sequence number for gaps, updating the lost
+// message count and calling handleMessageGap if any messages were lost.
+void KeyDaemon::Controller::checkSequence(const unsigned int sequence)
+{
+#ifndef KD_LEGACY_MESSAGES
+    using KeyWireFormat::sequenceModulus;
+    const unsigned int lostCount = (sequence - expectedSequence)
+            % sequenceModulus;
+    expectedSequence = (sequence + 1) % sequenceModulus;
+    if (lostCount > 0)
+    {
+        DBG(messagePrefix << __func__ << ": Lost " << lostCount
+                << " messages before message " << sequence << ".");
+        lostMessageCount += lostCount;
+        pendingRepeatCount = 0;
+        handleMessageGap(lostCount);
+    }
+#endif
 }
+
+
+// Gets the number of key event messages that the daemon sent but the
+// Controller never received.
+unsigned long KeyDaemon::Controller::getLostMessageCount() const
+{
+    return lostMessageCount;
+}
+
+
+#ifdef KD_KEY_STATE
+// Gets the shared key state page reader.
+const KeyDaemon::KeyStateReader& KeyDaemon::Controller::getKeyState() const
+{
+    return keyState;
+}
+#endif
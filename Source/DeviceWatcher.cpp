@@ -0,0 +1,105 @@
+#include "DeviceWatcher.h"
+#include "EventFiles.h"
+#include "KDDebug.h"
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#include <climits>
+#include <cstddef>
+
+#ifdef KD_DEBUG
+static const constexpr char* messagePrefix = "KeyDaemon::DeviceWatcher::";
+#endif
+
+// Directory changes that might add or remove a usable event file. Attribute
+// changes are included because new event files may not be readable until
+// their permissions are updated:
+static const constexpr uint32_t watchMask = IN_CREATE | IN_DELETE | IN_ATTRIB
+        | IN_MOVED_TO | IN_MOVED_FROM;
+
+// Size of the notification buffer, large enough for at least one event with
+// the longest possible file name:
+static const constexpr size_t notifyBufferSize
+        = 16 * (sizeof(struct inotify_event) + NAME_MAX + 1);
+
+
+// Starts watching the event file directory on construction.
+KeyDaemon::DeviceWatcher::DeviceWatcher()
+{
+    inotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFD < 0)
+    {
+        DBG(messagePrefix << __func__ << ": Failed to initialize inotify.");
+        return;
+    }
+    const std::string& dirPath = EventFiles::getDirPath();
+    if (inotify_add_watch(inotifyFD, dirPath.c_str(), watchMask) < 0)
+    {
+        DBG(messagePrefix << __func__ << ": Failed to watch \"" << dirPath
+                << "\", errno=" << errno);
+        close(inotifyFD);
+        inotifyFD = -1;
+        return;
+    }
+    DBG_V(messagePrefix << __func__ << ": Watching \"" << dirPath
+            << "\" for keyboard changes.");
+}
+
+
+// Stops watching the event file directory on destruction.
+KeyDaemon::DeviceWatcher::~DeviceWatcher()
+{
+    if (inotifyFD >= 0)
+    {
+        close(inotifyFD);
+    }
+}
+
+
+// Checks if the event file directory is being watched.
+bool KeyDaemon::DeviceWatcher::isWatching() const
+{
+    return inotifyFD >= 0;
+}
+
+
+// Gets the descriptor that becomes readable when the event file directory
+// changes.
+int KeyDaemon::DeviceWatcher::getFileDescriptor() const
+{
+    return inotifyFD;
+}
+
+
+// Reads all pending directory change notifications without blocking.
+bool KeyDaemon::DeviceWatcher::readChanges()
+{
+    if (inotifyFD < 0)
+    {
+        return false;
+    }
+    alignas(struct inotify_event) char buffer[notifyBufferSize];
+    bool eventFileChanged = false;
+    ssize_t bytesRead;
+    while ((bytesRead = read(inotifyFD, buffer, sizeof(buffer))) > 0)
+    {
+        for (ssize_t offset = 0; offset < bytesRead;)
+        {
+            const struct inotify_event* notification
+                    = reinterpret_cast<const struct inotify_event*>
+                    (buffer + offset);
+            if ((notification->mask & IN_Q_OVERFLOW) != 0
+                    || (notification->len > 0
+                        && EventFiles::isEventFileName(notification->name)))
+            {
+                eventFileChanged = true;
+            }
+            offset += sizeof(struct inotify_event) + notification->len;
+        }
+    }
+    if (bytesRead < 0 && errno != EAGAIN && errno != EINTR)
+    {
+        DBG(messagePrefix << __func__ << ": Read failed, errno=" << errno);
+    }
+    return eventFileChanged;
+}
@@ -0,0 +1,204 @@
+#include "EpollReader.h"
+#include "KDDebug.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstdint>
+
+#ifdef KD_DEBUG
+// Print the application and class name before all info/error messages:
+static const constexpr char* messagePrefix = "KeyDaemon: EpollReader::";
+#endif
+
+// Maximum number of ready files handled by a single epoll_wait call:
+static const constexpr int maxReadyEvents = 16;
+
+// Epoll data value used to identify the shutdown event file:
+static const constexpr uint64_t stopEventID = UINT64_MAX;
+
+
+// Opens all event files and starts the read thread.
+KeyDaemon::EpollReader::EpollReader
+(const std::vector<std::string>& eventFilePaths,
+        const KeySetBuffer& trackedKeys, KeyReader::Listener* listener) :
+MultiReader(eventFilePaths, trackedKeys, listener)
+{
+    epollFD = epoll_create1(EPOLL_CLOEXEC);
+    stopFD = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epollFD < 0 || stopFD < 0)
+    {
+        DBG(messagePrefix << __func__
+                << ": Failed to create epoll or eventfd descriptors.");
+        for (size_t i = 0; i < getFileCount(); i++)
+        {
+            MultiReader::closeFile(i);
+        }
+        return;
+    }
+    struct epoll_event stopEvent = {};
+    stopEvent.events = EPOLLIN;
+    stopEvent.data.u64 = stopEventID;
+    epoll_ctl(epollFD, EPOLL_CTL_ADD, stopFD, &stopEvent);
+    for (size_t i = 0; i < getFileCount(); i++)
+    {
+        const int fileDescriptor = getFileDescriptor(i);
+        // Reads must not block, so each file can be drained completely
+        // whenever epoll reports new input:
+        const int flags = fcntl(fileDescriptor, F_GETFL);
+        fcntl(fileDescriptor, F_SETFL, flags | O_NONBLOCK);
+        struct epoll_event inputEvent = {};
+        inputEvent.events = EPOLLIN;
+        inputEvent.data.u64 = i;
+        if (epoll_ctl(epollFD, EPOLL_CTL_ADD, fileDescriptor, &inputEvent)
+                != 0)
+        {
+            DBG(messagePrefix << __func__ << ": Failed to add event file "
+                    << i << " to the epoll set.");
+            MultiReader::closeFile(i);
+        }
+    }
+    startThread();
+}
+
+
+// Stops the read thread and closes the epoll instance.
+KeyDaemon::EpollReader::~EpollReader()
+{
+    stopThread();
+    if (stopFD >= 0)
+    {
+        close(stopFD);
+    }
+    if (epollFD >= 0)
+    {
+        close(epollFD);
+    }
+}
+
+
+// Waits for and reads input from all open event files until the EpollReader
+// is destroyed or all files are closed.
+void KeyDaemon::EpollReader::readLoop()
+{
+    struct epoll_event readyEvents[maxReadyEvents];
+    while (getOpenFileCount() > 0)
+    {
+        const int readyCount = epoll_wait(epollFD, readyEvents,
+                maxReadyEvents, -1);
+        if (readyCount < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            DBG(messagePrefix << __func__ << ": epoll_wait failed, errno="
+                    << errno);
+            return;
+        }
+        // Read every ready file once before processing any of them, so input
+        // from different keyboards is passed on in timestamp order:
+        PendingInput pendingInputs[maxReadyEvents];
+        int pendingCount = 0;
+        for (int i = 0; i < readyCount; i++)
+        {
+            if (readyEvents[i].data.u64 == stopEventID)
+            {
+                DBG_V(messagePrefix << __func__
+                        << ": Received shutdown signal.");
+                return;
+            }
+            const size_t fileIndex = readyEvents[i].data.u64;
+            const int inputBytes = readInput(fileIndex);
+            if (inputBytes < 0)
+            {
+                closeFile(fileIndex);
+            }
+            else if (inputBytes > 0)
+            {
+                pendingInputs[pendingCount++] = { fileIndex, inputBytes, 0 };
+            }
+        }
+        processInputs(pendingInputs, pendingCount);
+        // Files that filled their buffers may still have input waiting:
+        for (int i = 0; i < pendingCount; i++)
+        {
+            if (pendingInputs[i].inputBytes == getBufferSize()
+                    && ! readAvailable(pendingInputs[i].fileIndex))
+            {
+                closeFile(pendingInputs[i].fileIndex);
+            }
+        }
+    }
+    DBG(messagePrefix << __func__ << ": All event files closed.");
+}
+
+
+// Wakes the read thread from epoll_wait so it can exit.
+void KeyDaemon::EpollReader::signalStop()
+{
+    const uint64_t stopValue = 1;
+    if (write(stopFD, &stopValue, sizeof(stopValue)) < 0)
+    {
+        DBG(messagePrefix << __func__
+                << ": Failed to signal read thread shutdown.");
+    }
+}
+
+
+// Reads input from one event file into its buffer without blocking.
+int KeyDaemon::EpollReader::readInput(const size_t fileIndex)
+{
+    while (true)
+    {
+        const int inputBytes = read(getFileDescriptor(fileIndex),
+                getBuffer(fileIndex), getBufferSize());
+        if (inputBytes > 0)
+        {
+            return inputBytes;
+        }
+        if (inputBytes < 0 && errno == EAGAIN)
+        {
+            return 0;
+        }
+        if (inputBytes < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        DBG(messagePrefix << __func__ << ": Reading from event file "
+                << fileIndex << " stopped, errno=" << errno);
+        return -1;
+    }
+}
+
+
+// Reads and processes all input currently available from one event file.
+bool KeyDaemon::EpollReader::readAvailable(const size_t fileIndex)
+{
+    while (true)
+    {
+        const int inputBytes = readInput(fileIndex);
+        if (inputBytes <= 0)
+        {
+            return inputBytes == 0;
+        }
+        processInput(fileIndex, inputBytes);
+        if (inputBytes < getBufferSize())
+        {
+            return true;
+        }
+    }
+}
+
+
+// Removes an event file from the epoll set before closing it.
+void KeyDaemon::EpollReader::closeFile(const size_t fileIndex)
+{
+    const int fileDescriptor = getFileDescriptor(fileIndex);
+    if (fileDescriptor >= 0)
+    {
+        epoll_ctl(epollFD, EPOLL_CTL_DEL, fileDescriptor, nullptr);
+    }
+    MultiReader::closeFile(fileIndex);
+}
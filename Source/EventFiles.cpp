@@ -1,7 +1,10 @@
 #include "EventFiles.h"
+#include "KeyStats.h"
 #include "KDDebug.h"
-#include <fstream>
-#include <sstream>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
 
 #ifdef KD_DEBUG
 // Print the application and class name before all info/error messages:
@@ -9,7 +12,14 @@ static const constexpr char* messagePrefix = "KeyDaemon::EventFiles::";
 #endif
 
 // Directory where input device event queues are found:
+#ifdef KD_EVENT_DIR
+static const std::string eventDirPath = KD_EVENT_DIR;
+#else
 static const std::string eventDirPath = "/dev/input/";
+#endif
+
+// Prefix shared by all input event file names:
+static const constexpr char* eventFilePrefix = "event";
 
 // Path to the device file used to select appropriate event files:
 static const constexpr char* devFilePath = "/proc/bus/input/devices";
@@ -17,49 +27,284 @@ static const constexpr char* devFilePath = "/proc/bus/input/devices";
 // Prefix to lines that may contain event file names:
 static const constexpr char* eventLinePrefix = "H: Handlers=";
 
-// Substring found in event lines that handle keyboard input:
+// Prefix to lines listing the key codes a device can emit:
+static const constexpr char* keyBitsPrefix = "B: KEY=";
+
+// Handler name found in event lines that handle keyboard input:
 static const constexpr char* keyEventSubstring = "kbd";
 
-// Gets paths for all valid keyboard input event files.
-std::vector<std::string> KeyDaemon::EventFiles::getPaths()
+// Size of the buffer used to read the device file. Lines longer than this are
+// ignored:
+static const constexpr size_t readBufferSize = 4096;
+
+// Number of bits in each word of the device file's key bitmaps:
+static const constexpr unsigned int keyWordBits = sizeof(unsigned long) * 8;
+
+// Number of words in each KeySet bitmap:
+static const constexpr unsigned int trackedWordCount
+        = KeyDaemon::KeySet::getBitmapSize() / sizeof(unsigned long);
+
+/**
+ * @brief  Details parsed from a single device entry in the device file.
+ */
+struct DeviceEntry
+{
+    // The number of the device's event file, or -1 if it has none:
+    int eventNumber = -1;
+    // Whether the keyboard handler is attached to the device:
+    bool hasKbdHandler = false;
+    // Whether the device can emit at least one tracked key code:
+    bool emitsTrackedKeys = false;
+};
+
+
+/**
+ * @brief  Checks if a line of text starts with a prefix.
+ *
+ * @param line    The start of the line.
+ *
+ * @param end     The end of the line.
+ *
+ * @param prefix  The prefix to find.
+ *
+ * @return        Whether the line starts with the prefix.
+ */
+static bool startsWith(const char* line, const char* end, const char* prefix)
+{
+    const size_t prefixLength = strlen(prefix);
+    return static_cast<size_t>(end - line) >= prefixLength
+            && memcmp(line, prefix, prefixLength) == 0;
+}
+
+
+/**
+ * @brief  Reads the handler names listed in a device's handler line.
+ *
+ * @param text   The start of the handler list.
+ *
+ * @param end    The end of the line.
+ *
+ * @param entry  The device entry to update.
+ */
+static void parseHandlers(const char* text, const char* end,
+        DeviceEntry& entry)
+{
+    const size_t kbdLength = strlen(keyEventSubstring);
+    const size_t eventLength = strlen(eventFilePrefix);
+    while (text < end)
+    {
+        const char* tokenEnd = text;
+        while (tokenEnd < end && *tokenEnd != ' ')
+        {
+            tokenEnd++;
+        }
+        const size_t tokenLength = tokenEnd - text;
+        if (tokenLength == kbdLength
+                && memcmp(text, keyEventSubstring, kbdLength) == 0)
+        {
+            entry.hasKbdHandler = true;
+        }
+        else if (entry.eventNumber < 0 && tokenLength > eventLength
+                && memcmp(text, eventFilePrefix, eventLength) == 0)
+        {
+            int eventNumber = 0;
+            const char* digit = text + eventLength;
+            while (digit < tokenEnd && *digit >= '0' && *digit <= '9')
+            {
+                eventNumber = (eventNumber * 10) + (*digit - '0');
+                digit++;
+            }
+            if (digit == tokenEnd)
+            {
+                entry.eventNumber = eventNumber;
+            }
+        }
+        text = tokenEnd + 1;
+    }
+}
+
+
+/**
+ * @brief  Checks if a device's key bitmap includes any tracked key codes.
+ *
+ *  The bitmap is printed as space-separated hexadecimal words, with the most
+ * significant word first. Words use the same layout as KeySet bitmaps, so
+ * each word can be compared directly.
+ *
+ * @param text         The start of the bitmap text.
+ *
+ * @param end          The end of the line.
+ *
+ * @param trackedKeys  The set of tracked key codes.
+ *
+ * @return             Whether the device can emit any tracked key.
+ */
+static bool parseKeyBits(const char* text, const char* end,
+        const KeyDaemon::KeySet& trackedKeys)
+{
+    unsigned int wordCount = 0;
+    for (const char* c = text; c < end; c++)
+    {
+        if (*c != ' ' && (c == text || c[-1] == ' '))
+        {
+            wordCount++;
+        }
+    }
+    const unsigned long* trackedBitmap = trackedKeys.getBitmap();
+    unsigned int wordIndex = wordCount;
+    while (text < end && wordIndex > 0)
+    {
+        while (text < end && *text == ' ')
+        {
+            text++;
+        }
+        wordIndex--;
+        unsigned long word = 0;
+        for (; text < end && *text != ' '; text++)
+        {
+            const char c = *text;
+            const unsigned int digit = (c >= '0' && c <= '9') ? (c - '0')
+                    : ((c >= 'a' && c <= 'f') ? (c - 'a' + 10)
+                    : ((c >= 'A' && c <= 'F') ? (c - 'A' + 10) : 0));
+            word = (word << 4) | digit;
+        }
+        if (wordIndex < trackedWordCount
+                && (word & trackedBitmap[wordIndex]) != 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Gets paths for all keyboard event files that can emit tracked key codes.
+std::vector<std::string> KeyDaemon::EventFiles::getPaths
+(const KeySet& trackedKeys)
 {
-    using std::string;
-    std::vector<string> paths;
-    std::ifstream devFileReader(devFilePath);
-    if (!devFileReader.is_open())
+    std::vector<std::string> paths;
+    #ifdef KD_EVENT_DIR
+    // Stand-in directories have no device list, so use every event file:
+    DIR* eventDir = opendir(eventDirPath.c_str());
+    if (eventDir == nullptr)
+    {
+        DBG(messagePrefix << __func__ << ": Failed to open event directory \""
+                << eventDirPath << "\"");
+        return paths;
+    }
+    while (struct dirent* entry = readdir(eventDir))
+    {
+        if (isEventFileName(entry->d_name))
+        {
+            paths.push_back(eventDirPath + entry->d_name);
+        }
+    }
+    closedir(eventDir);
+    DBG_V(messagePrefix << __func__ << ": Found " << paths.size()
+            << " stand-in event file paths.");
+    return paths;
+    #endif
+    const int devFile = open(devFilePath, O_RDONLY | O_CLOEXEC);
+    if (devFile < 0)
     {
         DBG(messagePrefix << __func__ << ": Failed to open device file \""
                 << devFilePath << "\"");
         return paths;
     }
-    string line;
-    const int prefixLength = std::char_traits<char>::length(eventLinePrefix);
-    while (std::getline(devFileReader, line))
+    int skippedDevices = 0;
+    DeviceEntry entry;
+    // Adds the current device entry's path if it is usable, and starts a new
+    // entry:
+    auto finishEntry = [&paths, &entry, &skippedDevices]()
+    {
+        if (entry.eventNumber >= 0 && entry.hasKbdHandler)
+        {
+            if (entry.emitsTrackedKeys)
+            {
+                paths.push_back(eventDirPath + eventFilePrefix
+                        + std::to_string(entry.eventNumber));
+            }
+            else
+            {
+                DBG_V(messagePrefix << "getPaths: Skipping " << eventFilePrefix
+                        << entry.eventNumber << ", no tracked keys.");
+                skippedDevices++;
+            }
+        }
+        entry = DeviceEntry();
+    };
+    // Updates the current device entry using one line of the device file:
+    auto parseLine = [&trackedKeys, &entry, &finishEntry]
+            (const char* line, const char* end)
+    {
+        if (line == end)
+        {
+            finishEntry();
+        }
+        else if (startsWith(line, end, eventLinePrefix))
+        {
+            parseHandlers(line + strlen(eventLinePrefix), end, entry);
+        }
+        else if (startsWith(line, end, keyBitsPrefix))
+        {
+            entry.emitsTrackedKeys = parseKeyBits(
+                    line + strlen(keyBitsPrefix), end, trackedKeys);
+        }
+    };
+    char buffer[readBufferSize];
+    size_t bufferedBytes = 0;
+    bool skippingLongLine = false;
+    ssize_t bytesRead;
+    while ((bytesRead = read(devFile, buffer + bufferedBytes,
+            sizeof(buffer) - bufferedBytes)) > 0)
     {
-        if (line.compare(0, prefixLength, eventLinePrefix) == 0)
+        bufferedBytes += bytesRead;
+        const char* bufferEnd = buffer + bufferedBytes;
+        const char* line = buffer;
+        const char* lineEnd;
+        while ((lineEnd = static_cast<const char*>(
+                memchr(line, '\n', bufferEnd - line))) != nullptr)
         {
-            std::istringstream lineStream(line.substr(prefixLength));
-            string eventFile, token;
-            bool isKbdFile = false;
-            while (lineStream >> token)
+            if (! skippingLongLine)
             {
-                if (! isKbdFile && token.compare(keyEventSubstring) == 0)
-                {
-                    isKbdFile = true;
-                }
-                else if (eventFile.empty() && token.compare(0, 5, "event") == 0)
-                {
-                    eventFile = token;
-                }
-                if (isKbdFile && ! eventFile.empty())
-                {
-                    paths.push_back(eventDirPath + eventFile);
-                    break;
-                }
+                parseLine(line, lineEnd);
             }
+            skippingLongLine = false;
+            line = lineEnd + 1;
+        }
+        bufferedBytes = bufferEnd - line;
+        if (bufferedBytes == sizeof(buffer))
+        {
+            // Discard the rest of a line too long to buffer:
+            skippingLongLine = true;
+            bufferedBytes = 0;
         }
+        memmove(buffer, line, bufferedBytes);
     }
+    close(devFile);
+    if (bufferedBytes > 0 && ! skippingLongLine)
+    {
+        parseLine(buffer, buffer + bufferedBytes);
+    }
+    finishEntry();
+    STAT_ADD(skippedDevices, skippedDevices);
     DBG_V(messagePrefix << __func__ << ": Found " << paths.size()
-            << " keyboard event file paths.");
+            << " keyboard event file paths, skipped " << skippedDevices
+            << " keyboards without tracked keys.");
     return paths;
 }
+
+
+// Gets the path to the directory where event files are found.
+const std::string& KeyDaemon::EventFiles::getDirPath()
+{
+    return eventDirPath;
+}
+
+
+// Checks if a file name within the event file directory could belong to an
+// input event file.
+bool KeyDaemon::EventFiles::isEventFileName(const char* fileName)
+{
+    return strncmp(fileName, eventFilePrefix, strlen(eventFilePrefix)) == 0;
+}
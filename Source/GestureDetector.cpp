@@ -0,0 +1,300 @@
+#include "GestureDetector.h"
+#include "KDDebug.h"
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <ctime>
+#include <cstring>
+
+#ifdef KD_DEBUG
+static const constexpr char* messagePrefix = "KeyDaemon::GestureDetector::";
+#endif
+
+// Duration of each timer wheel tick in microseconds:
+static const constexpr uint64_t tickUS = 10000;
+
+
+// Gets the current CLOCK_MONOTONIC time in microseconds, the same clock used
+// for key event timestamps.
+static uint64_t getCurrentTime()
+{
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    return static_cast<uint64_t>(currentTime.tv_sec) * 1000000
+            + currentTime.tv_nsec / 1000;
+}
+
+
+// Saves gesture thresholds, and creates the timerfd if any gestures were
+// registered.
+KeyDaemon::GestureDetector::GestureDetector
+(const std::vector<KeyGesture>& gestures)
+{
+    memset(gestureIndices, -1, sizeof(gestureIndices));
+    memset(slotHeads, -1, sizeof(slotHeads));
+    for (const KeyGesture& gesture : gestures)
+    {
+        if (gestureCount >= maxGestureKeys || ! isValidGesture(gesture)
+                || gestureIndices[gesture.keyCode] >= 0)
+        {
+            DBG(messagePrefix << __func__ << ": Ignoring invalid gesture for "
+                    << "key " << gesture.keyCode);
+            continue;
+        }
+        KeyState& keyState = keyStates[gestureCount];
+        keyState.keyCode = gesture.keyCode;
+        keyState.longPressUS = static_cast<uint64_t>(gesture.longPressMS)
+                * 1000;
+        keyState.doubleTapUS = static_cast<uint64_t>(gesture.doubleTapMS)
+                * 1000;
+        gestureIndices[gesture.keyCode] = static_cast<int8_t>(gestureCount);
+        gestureCount++;
+    }
+    if (gestureCount == 0)
+    {
+        return;
+    }
+    timerFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerFD < 0)
+    {
+        DBG(messagePrefix << __func__
+                << ": Failed to create timerfd, long presses disabled.");
+    }
+    DBG_V(messagePrefix << __func__ << ": Detecting gestures for "
+            << gestureCount << " keys.");
+}
+
+
+// Closes the timerfd on destruction.
+KeyDaemon::GestureDetector::~GestureDetector()
+{
+    if (timerFD >= 0)
+    {
+        close(timerFD);
+    }
+}
+
+
+// Checks if a key's gesture thresholds can be registered.
+bool KeyDaemon::GestureDetector::isValidGesture(const KeyGesture& gesture)
+{
+    // Thresholds are either disabled or within the allowed range:
+    auto isValidThreshold = [](const unsigned int thresholdMS)
+    {
+        return thresholdMS == 0 || (thresholdMS >= minThresholdMS
+                && thresholdMS <= maxThresholdMS);
+    };
+    return gesture.keyCode > KEY_RESERVED && gesture.keyCode < KEY_CNT
+            && (gesture.longPressMS > 0 || gesture.doubleTapMS > 0)
+            && isValidThreshold(gesture.longPressMS)
+            && isValidThreshold(gesture.doubleTapMS);
+}
+
+
+// Checks if any gestures were registered.
+bool KeyDaemon::GestureDetector::hasGestures() const
+{
+    return gestureCount > 0;
+}
+
+
+// Gets the descriptor that becomes readable once per timer tick while long
+// press deadlines are pending.
+int KeyDaemon::GestureDetector::getFileDescriptor() const
+{
+    return timerFD;
+}
+
+
+// Checks if a key event should be withheld from the parent because gestures
+// replace it.
+bool KeyDaemon::GestureDetector::suppresses(const KeyMessage& message) const
+{
+    const unsigned int keyCode = static_cast<unsigned int>(message.keyCode);
+    return message.event == EventType::held && keyCode < KEY_CNT
+            && gestureIndices[keyCode] >= 0;
+}
+
+
+// Updates gesture state with a new key event, scheduling or cancelling its
+// long press, and checks if it completed a double tap.
+int KeyDaemon::GestureDetector::process(const KeyMessage& message,
+        KeyMessage* output)
+{
+    const unsigned int keyCode = static_cast<unsigned int>(message.keyCode);
+    if (keyCode >= KEY_CNT || gestureIndices[keyCode] < 0
+            || message.event == EventType::held)
+    {
+        return 0;
+    }
+    const int gestureIndex = gestureIndices[keyCode];
+    KeyState& keyState = keyStates[gestureIndex];
+    if (message.event == EventType::released)
+    {
+        keyState.held = false;
+        cancelLongPress(gestureIndex);
+        return 0;
+    }
+    // Another keyboard may already be holding the same key:
+    if (keyState.held)
+    {
+        return 0;
+    }
+    keyState.held = true;
+    const uint64_t pressTime = (message.timestamp != 0) ? message.timestamp
+            : getCurrentTime();
+    int outputCount = 0;
+    if (keyState.tapPending && keyState.doubleTapUS > 0
+            && pressTime <= keyState.lastPressTime + keyState.doubleTapUS)
+    {
+        KeyMessage& gestureMessage = output[outputCount++];
+        gestureMessage.keyCode = keyState.keyCode;
+        gestureMessage.event = EventType::pressed;
+        gestureMessage.timestamp = message.timestamp;
+        gestureMessage.kind = MessageKind::doubleTap;
+        keyState.tapPending = false;
+    }
+    else
+    {
+        keyState.tapPending = true;
+    }
+    keyState.lastPressTime = pressTime;
+    if (keyState.longPressUS > 0)
+    {
+        scheduleLongPress(gestureIndex, pressTime + keyState.longPressUS);
+    }
+    return outputCount;
+}
+
+
+// Reads the timerfd without blocking, and finds all long presses whose
+// deadlines have passed.
+int KeyDaemon::GestureDetector::readTimers(KeyMessage* output)
+{
+    uint64_t expirations;
+    if (timerFD < 0 || read(timerFD, &expirations, sizeof(expirations)) < 0)
+    {
+        return 0;
+    }
+    const uint64_t currentTime = getCurrentTime();
+    const uint64_t currentTick = currentTime / tickUS;
+    // Visit each slot at most once, even if the loop was delayed for more
+    // than a full turn of the wheel:
+    uint64_t tick = lastTick + 1;
+    if (currentTick >= wheelSlots && tick < currentTick - wheelSlots + 1)
+    {
+        tick = currentTick - wheelSlots + 1;
+    }
+    int outputCount = 0;
+    for (; tick <= currentTick && pendingTimers > 0; tick++)
+    {
+        int gestureIndex = slotHeads[tick % wheelSlots];
+        while (gestureIndex >= 0)
+        {
+            KeyState& keyState = keyStates[gestureIndex];
+            const int nextIndex = keyState.next;
+            // Deadlines more than one turn away stay in the slot:
+            if (keyState.deadline <= currentTime)
+            {
+                cancelLongPress(gestureIndex);
+                keyState.tapPending = false;
+                KeyMessage& gestureMessage = output[outputCount++];
+                gestureMessage.keyCode = keyState.keyCode;
+                gestureMessage.event = EventType::pressed;
+                gestureMessage.timestamp = keyState.deadline;
+                gestureMessage.kind = MessageKind::longPress;
+            }
+            gestureIndex = nextIndex;
+        }
+    }
+    lastTick = currentTick;
+    return outputCount;
+}
+
+
+// Adds a long press deadline to the timer wheel, starting the timerfd if it
+// isn't running.
+void KeyDaemon::GestureDetector::scheduleLongPress(const int gestureIndex,
+        const uint64_t deadline)
+{
+    if (timerFD < 0)
+    {
+        return;
+    }
+    cancelLongPress(gestureIndex);
+    if (pendingTimers == 0)
+    {
+        lastTick = getCurrentTime() / tickUS;
+        setTimerRunning(true);
+    }
+    // Deadlines in ticks that were already processed go in the next slot:
+    uint64_t deadlineTick = deadline / tickUS;
+    if (deadlineTick <= lastTick)
+    {
+        deadlineTick = lastTick + 1;
+    }
+    const int slot = deadlineTick % wheelSlots;
+    KeyState& keyState = keyStates[gestureIndex];
+    keyState.deadline = deadline;
+    keyState.slot = static_cast<uint8_t>(slot);
+    keyState.scheduled = true;
+    keyState.previous = -1;
+    keyState.next = slotHeads[slot];
+    if (keyState.next >= 0)
+    {
+        keyStates[keyState.next].previous
+                = static_cast<int8_t>(gestureIndex);
+    }
+    slotHeads[slot] = static_cast<int8_t>(gestureIndex);
+    pendingTimers++;
+}
+
+
+// Removes a key's long press deadline from the timer wheel if present,
+// stopping the timerfd if no deadlines remain.
+void KeyDaemon::GestureDetector::cancelLongPress(const int gestureIndex)
+{
+    KeyState& keyState = keyStates[gestureIndex];
+    if (! keyState.scheduled)
+    {
+        return;
+    }
+    if (keyState.previous >= 0)
+    {
+        keyStates[keyState.previous].next = keyState.next;
+    }
+    else
+    {
+        slotHeads[keyState.slot] = keyState.next;
+    }
+    if (keyState.next >= 0)
+    {
+        keyStates[keyState.next].previous = keyState.previous;
+    }
+    keyState.scheduled = false;
+    keyState.previous = -1;
+    keyState.next = -1;
+    pendingTimers--;
+    if (pendingTimers == 0)
+    {
+        setTimerRunning(false);
+    }
+}
+
+
+// Arms the timerfd to wake once per tick, or disarms it.
+void KeyDaemon::GestureDetector::setTimerRunning(const bool running)
+{
+    struct itimerspec timerSpec = {};
+    if (running)
+    {
+        timerSpec.it_interval.tv_nsec = tickUS * 1000;
+        timerSpec.it_value.tv_nsec = tickUS * 1000;
+    }
+    if (timerfd_settime(timerFD, 0, &timerSpec, nullptr) != 0)
+    {
+        DBG(messagePrefix << __func__ << ": Failed to "
+                << (running ? "start" : "stop") << " timer, errno="
+                << errno);
+    }
+}
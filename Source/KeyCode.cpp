@@ -1,6 +1,8 @@
 #include "KeyCode.h"
 #include "KDDebug.h"
 #include <algorithm>
+#include <cstring>
+#include <climits>
 #include <linux/input-event-codes.h>
 #include <unistd.h>
 #include <errno.h>
@@ -10,6 +12,9 @@
 static const constexpr char* messagePrefix = "KeyDaemon::KeyCode::";
 #endif
 
+// Text at the start of every repeat policy argument:
+static const constexpr char* repeatArgPrefix = "repeat=";
+
 
 namespace KeyDaemon
 {
@@ -24,6 +29,65 @@ namespace KeyDaemon
          *                    invalid.
          */
         int parseCode(const char* codeString);
+
+        /**
+         * @brief  Parses a key code argument, with an optional EventMask
+         *         following the code after a '/'.
+         *
+         * @param argument   The key code argument.
+         *
+         * @param eventMask  Used to return the argument's EventMask, or
+         *                   allEventTypes if no mask was given.
+         *
+         * @return           The argument's key code, or -1 if the code or
+         *                   mask was invalid.
+         */
+        int parseCodeArg(const char* argument, EventMask& eventMask);
+
+        /**
+         * @brief  Parses all arguments that list key codes joined by a
+         *         separator character, in order.
+         *
+         * @param argc       The number of command line arguments to parse.
+         *
+         * @param argv       The array of command line arguments.
+         *
+         * @param separator  The character separating each argument's key
+         *                   codes.
+         *
+         * @param keyLists   Used to return the key codes in each argument.
+         *
+         * @return           Whether all matching arguments were valid. If
+         *                   false, keyLists is left empty.
+         */
+        bool parseKeyLists(const int argc, char** argv, const char separator,
+                std::vector<std::vector<int>>& keyLists);
+
+        /**
+         * @brief  Checks if a command line argument registers a chord,
+         *         sequence, or gesture, or selects the repeat policy, instead
+         *         of a single tracked key code.
+         *
+         * @param argument  The argument to check.
+         *
+         * @return          Whether the argument should be skipped when
+         *                  parsing key codes.
+         */
+        bool isCompoundArg(const char* argument);
+
+        /**
+         * @brief  Parses a gesture threshold from a C string.
+         *
+         * @param thresholdString  The string representation of a threshold
+         *                         in milliseconds.
+         *
+         * @param threshold        Used to return the parsed threshold.
+         *
+         * @return                 Whether the string held only a
+         *                         non-negative decimal number.
+         */
+        bool parseThreshold(const char* thresholdString,
+                unsigned int& threshold);
     }
 }
 
@@ -71,54 +135,337 @@ int KeyDaemon::KeyCode::parseCode(const char* codeString)
 }
 
 
-// Parses keyboard codes from a set of command line arguments, returning the
-// list of codes only when no errors or invalid codes are encountered.
-std::vector<int> KeyDaemon::KeyCode::parseCodes(const int argc, char** argv)
+// Parses a key code argument, with an optional EventMask following the code
+// after a '/'.
+int KeyDaemon::KeyCode::parseCodeArg(const char* argument,
+        EventMask& eventMask)
 {
-    using std::vector;
-    // Launching via exec doesn't seem to pass the daemon's executable name
-    // as an argument, so argv[0] may or may not be a key code.
-    int startIndex = 1;
-    if (argc > 0 && parseCode(argv[0]) != -1)
+    eventMask = allEventTypes;
+    const char* maskStart = strchr(argument, '/');
+    if (maskStart == nullptr)
     {
-        DBG_V(messagePrefix << __func__ << ": Index zero was a valid key code,"
-                << " startIndex is actually zero.");
-        startIndex = 0;
+        return parseCode(argument);
     }
-    if ((argc - startIndex) > KD_KEY_LIMIT)
+    char codeString[16] = {};
+    const size_t codeLength = static_cast<size_t>(maskStart - argument);
+    unsigned int maskValue = 0;
+    if (codeLength >= sizeof(codeString)
+            || ! parseThreshold(maskStart + 1, maskValue)
+            || maskValue == 0 || maskValue > allEventTypes)
+    {
+        DBG(messagePrefix << __func__ << ": Argument \"" << argument
+                << "\" has an invalid event type mask.");
+        return -1;
+    }
+    memcpy(codeString, argument, codeLength);
+    eventMask = maskValue;
+    return parseCode(codeString);
+}
+
+
+// Parses keyboard codes and their event type masks from a set of command line
+// arguments, returning the list of codes only when no errors or invalid codes
+// are encountered.
+std::vector<int> KeyDaemon::KeyCode::parseCodes(const int argc, char** argv,
+        std::vector<EventMask>& eventMasks)
+{
+    eventMasks.clear();
+    using std::vector;
+    const int startIndex = argc - countCodeArgs(argc, argv);
+    const int codeArgCount = std::count_if(argv + startIndex, argv + argc,
+            [](const char* argument) { return ! isCompoundArg(argument); });
+    if (codeArgCount > KD_KEY_LIMIT)
     {
         DBG(messagePrefix << __func__ << ": Key code argument count "
-                << (argc - startIndex) << " exceeds maximum key code count " 
+                << codeArgCount << " exceeds maximum key code count " 
                 << KD_KEY_LIMIT);
         return vector<int>();
     }
-    if (argc <= startIndex)
+    if (codeArgCount == 0)
     {
         DBG(messagePrefix << __func__ <<  ": Key code argument count "
-                << argc << " is less than expected minimum count of 1.");
+                << codeArgCount
+                << " is less than expected minimum count of 1.");
         return vector<int>();
     }
-    vector<int> keyCodes;
+    vector<std::pair<int, EventMask>> maskedCodes;
     for (int i = startIndex; i < argc; i++)
     {
-        int argCode = parseCode(argv[i]);
+        if (isCompoundArg(argv[i]))
+        {
+            continue;
+        }
+        EventMask argMask;
+        int argCode = parseCodeArg(argv[i], argMask);
         if (argCode != -1)
         {
-            keyCodes.push_back((int) argCode);
+            maskedCodes.push_back({ argCode, argMask });
         }
         else
         {
             return vector<int>();
         }
     }
-    // Make sure key codes are sorted for fast code lookup:
-    std::sort(keyCodes.begin(), keyCodes.end());
+    // Make sure key codes are sorted for fast code lookup, keeping each
+    // code's mask at the same index:
+    std::sort(maskedCodes.begin(), maskedCodes.end());
+    vector<int> keyCodes;
+    for (const std::pair<int, EventMask>& maskedCode : maskedCodes)
+    {
+        keyCodes.push_back(maskedCode.first);
+        eventMasks.push_back(maskedCode.second);
+    }
     DBG_V(messagePrefix << __func__ << ": Returning " << keyCodes.size()
             << " sorted key codes.");
     return keyCodes;
 }
 
 
+// Counts the command line arguments that should be parsed as key codes,
+// skipping the executable name if present.
+int KeyDaemon::KeyCode::countCodeArgs(const int argc, char** argv)
+{
+    // Launching via exec doesn't seem to pass the daemon's executable name
+    // as an argument, so argv[0] may or may not be a key code.
+    EventMask unusedMask;
+    if (argc > 0 && (parseCodeArg(argv[0], unusedMask) != -1
+            || isCompoundArg(argv[0])))
+    {
+        DBG_V(messagePrefix << __func__ << ": Index zero was a valid key code,"
+                << " startIndex is actually zero.");
+        return argc;
+    }
+    return (argc > 0) ? (argc - 1) : 0;
+}
+
+
+// Checks if a command line argument describes a chord rather than a single key
+// code.
+bool KeyDaemon::KeyCode::isChordArg(const char* argument)
+{
+    return strchr(argument, '+') != nullptr;
+}
+
+
+// Parses all chord arguments from a set of command line arguments, in order.
+bool KeyDaemon::KeyCode::parseChords(const int argc, char** argv,
+        std::vector<std::vector<int>>& chords)
+{
+    return parseKeyLists(argc, argv, '+', chords);
+}
+
+
+// Checks if a command line argument describes a key sequence rather than a
+// single key code.
+bool KeyDaemon::KeyCode::isSequenceArg(const char* argument)
+{
+    return strchr(argument, ',') != nullptr;
+}
+
+
+// Parses all sequence arguments from a set of command line arguments, in
+// order.
+bool KeyDaemon::KeyCode::parseSequences(const int argc, char** argv,
+        std::vector<std::vector<int>>& sequences)
+{
+    return parseKeyLists(argc, argv, ',', sequences);
+}
+
+
+// Checks if a command line argument describes a key gesture rather than a
+// single key code.
+bool KeyDaemon::KeyCode::isGestureArg(const char* argument)
+{
+    return strchr(argument, ':') != nullptr;
+}
+
+
+// Parses all gesture arguments from a set of command line arguments, in order.
+bool KeyDaemon::KeyCode::parseGestures(const int argc, char** argv,
+        std::vector<KeyGesture>& gestures)
+{
+    gestures.clear();
+    const int startIndex = argc - countCodeArgs(argc, argv);
+    for (int i = startIndex; i < argc; i++)
+    {
+        if (! isGestureArg(argv[i]))
+        {
+            continue;
+        }
+        // Split the argument into its key code and two threshold fields:
+        char fields[3][16] = {};
+        const char* fieldStart = argv[i];
+        int fieldCount = 0;
+        while (fieldStart != nullptr && fieldCount < 3)
+        {
+            const char* fieldEnd = strchr(fieldStart, ':');
+            const size_t fieldLength = (fieldEnd == nullptr)
+                    ? strlen(fieldStart)
+                    : static_cast<size_t>(fieldEnd - fieldStart);
+            if (fieldLength >= sizeof(fields[0]))
+            {
+                break;
+            }
+            memcpy(fields[fieldCount], fieldStart, fieldLength);
+            fieldCount++;
+            fieldStart = (fieldEnd == nullptr) ? nullptr : fieldEnd + 1;
+        }
+        KeyGesture gesture;
+        gesture.keyCode = (fieldCount == 3 && fieldStart == nullptr)
+                ? parseCode(fields[0]) : -1;
+        if (gesture.keyCode == -1
+                || ! parseThreshold(fields[1], gesture.longPressMS)
+                || ! parseThreshold(fields[2], gesture.doubleTapMS))
+        {
+            DBG(messagePrefix << __func__ << ": Invalid gesture argument \""
+                    << argv[i] << "\".");
+            gestures.clear();
+            return false;
+        }
+        gestures.push_back(gesture);
+    }
+    DBG_V(messagePrefix << __func__ << ": Parsed " << gestures.size()
+            << " gestures.");
+    return true;
+}
+
+
+// Checks if a command line argument selects the daemon's repeat policy rather
+// than a single key code.
+bool KeyDaemon::KeyCode::isRepeatArg(const char* argument)
+{
+    return strncmp(argument, repeatArgPrefix, strlen(repeatArgPrefix)) == 0;
+}
+
+
+// Parses the repeat policy argument from a set of command line arguments, if
+// one is present.
+bool KeyDaemon::KeyCode::parseRepeatPolicy(const int argc, char** argv,
+        RepeatPolicy& policy, unsigned int& rateHz)
+{
+    policy = RepeatPolicy::passThrough;
+    rateHz = 0;
+    bool foundPolicy = false;
+    const int startIndex = argc - countCodeArgs(argc, argv);
+    for (int i = startIndex; i < argc; i++)
+    {
+        if (! isRepeatArg(argv[i]))
+        {
+            continue;
+        }
+        const char* policyName = argv[i] + strlen(repeatArgPrefix);
+        bool validPolicy = ! foundPolicy;
+        if (strcmp(policyName, "passThrough") == 0)
+        {
+            policy = RepeatPolicy::passThrough;
+        }
+        else if (strcmp(policyName, "suppress") == 0)
+        {
+            policy = RepeatPolicy::suppress;
+        }
+        else if (strcmp(policyName, "collapse") == 0)
+        {
+            policy = RepeatPolicy::collapse;
+        }
+        else
+        {
+            policy = RepeatPolicy::rateLimit;
+            validPolicy = validPolicy && parseThreshold(policyName, rateHz)
+                    && rateHz > 0;
+        }
+        if (! validPolicy)
+        {
+            DBG(messagePrefix << __func__ << ": Invalid or repeated repeat "
+                    << "policy argument \"" << argv[i] << "\".");
+            policy = RepeatPolicy::passThrough;
+            rateHz = 0;
+            return false;
+        }
+        foundPolicy = true;
+    }
+    return true;
+}
+
+
+// Checks if a command line argument registers a chord, sequence, or gesture,
+// or selects the repeat policy, instead of a single tracked key code.
+bool KeyDaemon::KeyCode::isCompoundArg(const char* argument)
+{
+    return isChordArg(argument) || isSequenceArg(argument)
+            || isGestureArg(argument) || isRepeatArg(argument);
+}
+
+
+// Parses a gesture threshold from a C string.
+bool KeyDaemon::KeyCode::parseThreshold(const char* thresholdString,
+        unsigned int& threshold)
+{
+    if (*thresholdString < '0' || *thresholdString > '9')
+    {
+        return false;
+    }
+    char* endPtr = nullptr;
+    errno = 0;
+    const unsigned long value = strtoul(thresholdString, &endPtr, 10);
+    if (errno != 0 || *endPtr != '\0' || value > UINT_MAX)
+    {
+        return false;
+    }
+    threshold = static_cast<unsigned int>(value);
+    return true;
+}
+
+
+// Parses all arguments that list key codes joined by a separator character, in
+// order.
+bool KeyDaemon::KeyCode::parseKeyLists(const int argc, char** argv,
+        const char separator, std::vector<std::vector<int>>& keyLists)
+{
+    keyLists.clear();
+    const int startIndex = argc - countCodeArgs(argc, argv);
+    for (int i = startIndex; i < argc; i++)
+    {
+        if (strchr(argv[i], separator) == nullptr)
+        {
+            continue;
+        }
+        std::vector<int> listKeys;
+        const char* keyStart = argv[i];
+        while (true)
+        {
+            const char* keyEnd = strchr(keyStart, separator);
+            const size_t keyLength = (keyEnd == nullptr) ? strlen(keyStart)
+                    : static_cast<size_t>(keyEnd - keyStart);
+            char keyString[16] = {};
+            if (keyLength == 0 || keyLength >= sizeof(keyString))
+            {
+                DBG(messagePrefix << __func__ << ": Invalid key list argument "
+                        << "\"" << argv[i] << "\".");
+                keyLists.clear();
+                return false;
+            }
+            memcpy(keyString, keyStart, keyLength);
+            const int keyCode = parseCode(keyString);
+            if (keyCode == -1)
+            {
+                keyLists.clear();
+                return false;
+            }
+            listKeys.push_back(keyCode);
+            if (keyEnd == nullptr)
+            {
+                break;
+            }
+            keyStart = keyEnd + 1;
+        }
+        keyLists.push_back(listKeys);
+    }
+    DBG_V(messagePrefix << __func__ << ": Parsed " << keyLists.size()
+            << " arguments separated by '" << separator << "'.");
+    return true;
+}
+
+
 // Gets a string representation of a linux key code.
 std::string KeyDaemon::KeyCode::getKeyString(const int keyCode)
 {
@@ -1,21 +1,182 @@
 #include "KeyLoop.h"
 #include "KeyExitCode.h"
 #include "EventFiles.h"
-#include "KeyMessage.h"
+#include "EpollReader.h"
+#include "UringReader.h"
+#include "KeyWireFormat.h"
+#include "KeyStats.h"
 #include "KDDebug.h"
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstdint>
 #include <ctime>
+#include <algorithm>
+#include <bitset>
 
 #ifdef KD_DEBUG
 static const constexpr char* messagePrefix = "KeyDaemon::KeyLoop::";
 #endif
 
-// Frequency in milliseconds between key reader checks.
-static const constexpr int readerCheckFrequencyMS = 100;
+// Maximum time in milliseconds to wait for KeyReader changes. When the
+// DaemonFramework timeout is enabled, the loop wakes periodically so the
+// timeout can be checked. Otherwise, the loop only wakes when a reader stops
+// or a signal is received.
+#ifdef DF_TIMEOUT
+static const constexpr int readerWaitTimeoutMS = 100;
+#else
+static const constexpr int readerWaitTimeoutMS = -1;
+#endif
+
+// Message queue overflow policy, chosen with KD_QUEUE_POLICY:
+#if defined(KD_QUEUE_BLOCK)
+static const constexpr KeyDaemon::MessageQueue::OverflowPolicy queuePolicy
+        = KeyDaemon::MessageQueue::OverflowPolicy::block;
+#elif defined(KD_QUEUE_DROP_OLDEST)
+static const constexpr KeyDaemon::MessageQueue::OverflowPolicy queuePolicy
+        = KeyDaemon::MessageQueue::OverflowPolicy::dropOldest;
+#else
+static const constexpr KeyDaemon::MessageQueue::OverflowPolicy queuePolicy
+        = KeyDaemon::MessageQueue::OverflowPolicy::dropRepeats;
+#endif
+
+#if defined(KD_SHM_TRANSPORT) && defined(KD_QUEUE_BLOCK)
+static_assert(KeyDaemon::KeyRing::capacity
+        >= KeyDaemon::KeyWireFormat::maxFrameMessages,
+        "KD_RING_CAPACITY must hold a full message frame when "
+        "KD_QUEUE_POLICY=block.");
+// Maximum time in milliseconds to wait for room in the message ring, so the
+// writer thread periodically checks if the daemon is stopping:
+static const constexpr int ringWaitTimeoutMS = 100;
+#endif
 
 
-// Saves the list of tracked key codes on construction.
-KeyDaemon::KeyLoop::KeyLoop(std::vector<int> keyCodes) :
-    keyCodes(keyCodes) { }
+// Gets every key code and event type that keyboard readers need to track,
+// combining the individually tracked keys with all chord, sequence, and
+// gesture keys.
+static KeyDaemon::KeySet getReadKeys(const std::vector<int>& keyCodes,
+        const std::vector<KeyDaemon::EventMask>& eventMasks,
+        const std::vector<std::vector<int>>& chords,
+        const std::vector<std::vector<int>>& sequences,
+        const std::vector<KeyDaemon::KeyGesture>& gestures)
+{
+    using namespace KeyDaemon;
+    const EventMask pressMask = getEventMask(EventType::pressed);
+    const EventMask pressAndRelease = pressMask
+            | getEventMask(EventType::released);
+    std::vector<int> readKeys = keyCodes;
+    std::vector<EventMask> readMasks = eventMasks;
+    readMasks.resize(readKeys.size(), allEventTypes);
+    // Chords can only fire when exactly their keys are held, and the key
+    // state page shows every held key, so both need to see all tracked key
+    // presses and releases, even if the parent didn't request them. The
+    // keyboard merger ignores presses of keys it thinks are held, so it needs
+    // every release of every key read. Events the parent didn't request are
+    // filtered out after merging and matching:
+    #if defined(KD_KEY_STATE) || defined(KD_MERGE_KEYBOARDS)
+    const bool readAllPresses = true;
+    #else
+    const bool readAllPresses = ! chords.empty();
+    #endif
+    #ifdef KD_MERGE_KEYBOARDS
+    const EventMask sequenceMask = pressAndRelease;
+    #else
+    const EventMask sequenceMask = pressMask;
+    #endif
+    if (readAllPresses)
+    {
+        for (EventMask& readMask : readMasks)
+        {
+            readMask |= pressAndRelease;
+        }
+    }
+    for (const std::vector<int>& chord : chords)
+    {
+        readKeys.insert(readKeys.end(), chord.begin(), chord.end());
+        readMasks.resize(readKeys.size(), pressAndRelease);
+    }
+    for (const std::vector<int>& sequence : sequences)
+    {
+        readKeys.insert(readKeys.end(), sequence.begin(), sequence.end());
+        readMasks.resize(readKeys.size(), sequenceMask);
+    }
+    for (const KeyGesture& gesture : gestures)
+    {
+        readKeys.push_back(gesture.keyCode);
+        readMasks.push_back(pressAndRelease);
+    }
+    return KeySet(readKeys, readMasks);
+}
+
+
+// Saves the list of tracked key codes, builds the tracked key set, and creates
+// the reader event file descriptor on construction.
+KeyDaemon::KeyLoop::KeyLoop(std::vector<int> keyCodes,
+        std::vector<EventMask> eventMasks,
+        std::vector<std::vector<int>> chords,
+        std::vector<std::vector<int>> sequences,
+        std::vector<KeyGesture> gestures,
+        const RepeatPolicy repeatPolicy,
+        const unsigned int repeatRateHz) :
+    keyCodes(keyCodes),
+    chords(chords),
+    sequences(sequences),
+    gestures(gestures),
+    forwardedKeys(keyCodes, eventMasks),
+    readKeys(getReadKeys(keyCodes, eventMasks, chords, sequences, gestures)),
+    trackedKeys(readKeys),
+    forwardAllEvents(false),
+    chordMatcher(forwardedKeys, chords),
+    sequenceMatcher(sequences, KD_SEQUENCE_TIMEOUT),
+    gestureDetector(gestures),
+    repeatThrottle(repeatPolicy, repeatRateHz),
+#if defined(KD_EPOLL_READER) || defined(KD_URING_READER)
+    useMultiReader(true),
+#else
+    useMultiReader(false),
+#endif
+    readySent(false),
+    messageQueue(queuePolicy)
+#ifdef KD_SHM_TRANSPORT
+    , ringWriter(KD_SHM_PATH)
+#endif
+#ifdef KD_KEY_STATE
+    , keyStatePublisher(KD_KEY_STATE_PATH)
+#endif
+#ifdef KD_CONTROL
+    , controlReader(KD_CONTROL_PATH), readingPaused(false)
+#endif
+{
+    forwardAllEvents = canForwardAllEvents();
+    #ifdef KD_CONTROL
+    if (! controlReader.isOpen())
+    {
+        DBG(messagePrefix << __func__
+                << ": Control FIFO unavailable, ignoring parent commands.");
+    }
+    #endif
+    #ifdef KD_SHM_TRANSPORT
+    if (! ringWriter.isOpen())
+    {
+        DBG(messagePrefix << __func__
+                << ": Message ring unavailable, sending messages by pipe.");
+    }
+    #endif
+    #ifdef KD_KEY_STATE
+    if (! keyStatePublisher.isOpen())
+    {
+        DBG(messagePrefix << __func__
+                << ": Key state page unavailable, key state not published.");
+    }
+    #endif
+    readerEventFD = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (readerEventFD < 0)
+    {
+        DBG(messagePrefix << __func__
+                << ": Failed to create reader event file descriptor.");
+    }
+}
 
 
 // Ensures all key event file readers are closed and deleted on destruction.
@@ -29,35 +190,85 @@ KeyDaemon::KeyLoop::~KeyLoop()
         delete reader;
     }
     eventFileReaders.clear();
+    delete multiReader;
+    multiReader = nullptr;
+    // Send any messages still queued, then stop the writer thread:
+    messageQueue.close();
+    if (writerThread.joinable())
+    {
+        writerThread.join();
+    }
+    DBG_V(messagePrefix << __func__ << ": Message queue peak depth: "
+            << messageQueue.getPeakDepth() << ", dropped messages: "
+            << messageQueue.getDropCount() << ", suppressed repeats: "
+            << repeatThrottle.getSuppressedCount());
+    STAT_MAX(peakQueueDepth, messageQueue.getPeakDepth());
+    if (readerEventFD >= 0)
+    {
+        close(readerEventFD);
+    }
+    STAT_PRINT();
     DBG_V(messagePrefix << __func__ << ": KeyLoop destroyed.");
 }
 
 
-// Creates KeyReader objects for all keyboard event files before starting the
-// daemon action loop.
-int KeyDaemon::KeyLoop::initLoop()
+// Counts the distinct key codes keyboard readers need to read to track a set of
+// keys, chords, sequences, and gestures.
+size_t KeyDaemon::KeyLoop::countReadKeys(const std::vector<int>& keyCodes,
+        const std::vector<std::vector<int>>& chords,
+        const std::vector<std::vector<int>>& sequences,
+        const std::vector<KeyGesture>& gestures)
 {
-    // Create KeyReader objects for each keyboard event file:
-    std::vector<std::string> eventFilePaths = EventFiles::getPaths();
-    DBG_V(messagePrefix << "Creating KeyReader objects for "
-            << eventFilePaths.size() << " event files:");
-    for (const std::string& path : eventFilePaths)
+    std::bitset<KEY_CNT> readCodes;
+    auto addCode = [&readCodes](const int keyCode)
     {
-        eventFileReaders.push_back(
-                new KeyReader(path.c_str(), keyCodes, this));
+        if (keyCode > KEY_RESERVED && keyCode < KEY_CNT)
+        {
+            readCodes.set(static_cast<size_t>(keyCode));
+        }
+    };
+    std::for_each(keyCodes.begin(), keyCodes.end(), addCode);
+    for (const std::vector<int>& chord : chords)
+    {
+        std::for_each(chord.begin(), chord.end(), addCode);
+    }
+    for (const std::vector<int>& sequence : sequences)
+    {
+        std::for_each(sequence.begin(), sequence.end(), addCode);
+    }
+    for (const KeyGesture& gesture : gestures)
+    {
+        addCode(gesture.keyCode);
     }
-    if (eventFileReaders.empty())
+    return readCodes.count();
+}
+
+
+// Starts the message writer thread and creates readers for all keyboard event
+// files before starting the daemon action loop.
+int KeyDaemon::KeyLoop::initLoop()
+{
+    writerThread = std::thread(&KeyLoop::writeMessages, this);
+    updateReaders();
+    if (! hasOpenReaders())
     {
-        DBG(messagePrefix << __func__ 
-                << ": Exiting: no valid event files found.");
-        return static_cast<int>(KeyExitCode::missingKeyEventFiles);
+        if (! deviceWatcher.isWatching())
+        {
+            DBG(messagePrefix << __func__
+                    << ": Exiting: no valid event files found.");
+            return static_cast<int>(KeyExitCode::missingKeyEventFiles);
+        }
+        DBG(messagePrefix << __func__
+                << ": No keyboards found, waiting for a keyboard to connect.");
     }
+    sendReadyMessage();
     return 0;
 }
 
 
-// Polls the list of KeyReaders, deleting any that have encountered errors, then
-// briefly sleeps.
+// Removes any KeyReaders that have encountered errors, then waits until a
+// reader signals that it has stopped, keyboards are connected or removed, or
+// the parent sends a command.
 int KeyDaemon::KeyLoop::loopAction()
 {
     static bool firstLoop = true;
@@ -66,41 +277,656 @@ int KeyDaemon::KeyLoop::loopAction()
         DBG("KeyLoop first loop");
         firstLoop = false;
     }
-    if (eventFileReaders.empty())
+    sendReadyMessage();
+    removeStoppedReaders();
+    if (! hasOpenReaders() && ! deviceWatcher.isWatching())
     {
         DBG(messagePrefix << __func__
                 << ": No readers left, closing daemon.");
         return static_cast<int>(KeyExitCode::keyReadersStopped);
     }
-    // Find and remove failed file readers:
+    waitForReaderChange();
+    return 0;
+}
+
+
+// Creates readers for any keyboard event files that aren't already being read.
+void KeyDaemon::KeyLoop::updateReaders()
+{
+    std::vector<std::string> eventFilePaths = EventFiles::getPaths(readKeys);
+    std::sort(eventFilePaths.begin(), eventFilePaths.end());
+    #ifdef KD_MERGE_KEYBOARDS
+    releaseRemovedKeyboards(eventFilePaths);
+    #endif
+    if (useMultiReader)
+    {
+        if (multiReader != nullptr && eventFilePaths == multiReaderPaths
+                && multiReader->getOpenFileCount()
+                    == static_cast<int>(multiReaderPaths.size()))
+        {
+            return;
+        }
+        // Replace the MultiReader, as it can't add or remove files:
+        delete multiReader;
+        multiReader = nullptr;
+        multiReaderPaths = eventFilePaths;
+        if (eventFilePaths.empty())
+        {
+            return;
+        }
+        multiReader = createMultiReader(eventFilePaths);
+        if (multiReader != nullptr)
+        {
+            return;
+        }
+        useMultiReader = false;
+        multiReaderPaths.clear();
+    }
+    removeStoppedReaders();
+    for (const std::string& path : eventFilePaths)
+    {
+        const bool alreadyReading = std::any_of(eventFileReaders.begin(),
+                eventFileReaders.end(), [&path](const KeyReader* reader)
+                {
+                    return reader->getPath() == path;
+                });
+        if (! alreadyReading)
+        {
+            DBG_V(messagePrefix << __func__ << ": Creating KeyReader for \""
+                    << path << "\"");
+            eventFileReaders.push_back(
+                    new KeyReader(path.c_str(), trackedKeys, this));
+        }
+    }
+}
+
+
+// Creates a MultiReader to read a set of event files, if the daemon was built
+// to use one.
+KeyDaemon::MultiReader* KeyDaemon::KeyLoop::createMultiReader
+(const std::vector<std::string>& eventFilePaths)
+{
+    #if defined(KD_EPOLL_READER)
+    DBG_V(messagePrefix << "Creating EpollReader for "
+            << eventFilePaths.size() << " event files:");
+    return new EpollReader(eventFilePaths, trackedKeys, this);
+    #elif defined(KD_URING_READER)
+    // Check for io_uring before any event files are opened, so that falling
+    // back to KeyReaders never reads the same files twice:
+    if (! UringReader::isSupported())
+    {
+        DBG(messagePrefix << __func__
+                << ": io_uring unavailable, using threaded KeyReaders.");
+        return nullptr;
+    }
+    DBG_V(messagePrefix << "Creating UringReader for "
+            << eventFilePaths.size() << " event files:");
+    UringReader* uringReader = new UringReader(eventFilePaths, trackedKeys,
+            this);
+    if (uringReader->isAvailable())
+    {
+        return uringReader;
+    }
+    DBG(messagePrefix << __func__
+            << ": Failed to create io_uring instance, using threaded "
+            << "KeyReaders.");
+    delete uringReader;
+    return nullptr;
+    #else
+    return nullptr;
+    #endif
+}
+
+
+// Deletes all KeyReaders that stopped reading or failed.
+void KeyDaemon::KeyLoop::removeStoppedReaders()
+{
     for (int i = 0; i < eventFileReaders.size(); i++)
     {
         using State = DaemonFramework::InputReader::State;
         State readerState = eventFileReaders[i]->getState();
-        if (readerState == State::closed || readerState == State::failed)
+        if (eventFileReaders[i]->hasStopped() || readerState == State::closed
+                || readerState == State::failed)
         {
             DBG(messagePrefix << "Reader for path \""
                     << eventFileReaders[i]->getPath()
-                    << "\" stopped unexpectedly, "
+                    << "\" stopped, "
                     << (eventFileReaders.size() - 1)
                     << " readers remaining.");
             KeyReader* removedReader = eventFileReaders[i];
             eventFileReaders.erase(eventFileReaders.begin() + i);
+            removedReader->stopReading();
             delete removedReader;
             i--;
         }
     }
-    struct timespec sleepTimer;
-    sleepTimer.tv_sec = 0;
-    sleepTimer.tv_nsec = readerCheckFrequencyMS * 1000000;
-    nanosleep(&sleepTimer, nullptr);
-    return 0;
 }
 
 
-// Sends all tracked key events to the parent application.
-void KeyDaemon::KeyLoop::keyEvent(const int keyCode, const EventType type)
+// Checks if any keyboard event files are being read.
+bool KeyDaemon::KeyLoop::hasOpenReaders() const
+{
+    return ! eventFileReaders.empty() || (multiReader != nullptr
+            && multiReader->getOpenFileCount() > 0);
+}
+
+
+// Queues a MessageKind::ready message once every reader created on startup has
+// opened its event file or stopped.
+void KeyDaemon::KeyLoop::sendReadyMessage()
+{
+    if (readySent)
+    {
+        return;
+    }
+    int openCount = (multiReader != nullptr)
+            ? multiReader->getOpenFileCount() : 0;
+    for (const KeyReader* reader : eventFileReaders)
+    {
+        using State = DaemonFramework::InputReader::State;
+        const State readerState = reader->getState();
+        if (reader->hasStopped() || readerState == State::closed
+                || readerState == State::failed)
+        {
+            continue;
+        }
+        if (! reader->hasOpened())
+        {
+            return;
+        }
+        openCount++;
+    }
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    KeyMessage readyMessage;
+    // Counts are sent in place of key codes, so they share the same limit:
+    readyMessage.keyCode = std::min(openCount, KEY_MAX);
+    readyMessage.timestamp = static_cast<uint64_t>(currentTime.tv_sec)
+            * 1000000 + currentTime.tv_nsec / 1000;
+    readyMessage.kind = MessageKind::ready;
+    DBG_V(messagePrefix << __func__ << ": Ready with " << openCount
+            << " open event files.");
+    readySent = true;
+    messageQueue.push(readyMessage);
+}
+
+
+// Checks if every event passed on by readers can be sent to the parent
+// unchanged, so no events need to be matched or filtered.
+bool KeyDaemon::KeyLoop::canForwardAllEvents() const
+{
+    if (chordMatcher.hasChords() || sequenceMatcher.hasSequences()
+            || gestureDetector.hasGestures() || repeatThrottle.isActive())
+    {
+        return false;
+    }
+    for (unsigned int code = 0; code < KEY_CNT; code++)
+    {
+        if (readKeys.getEventMask(code) != forwardedKeys.getEventMask(code))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+#ifdef KD_CONTROL
+// Reads and applies all pending commands from the parent's control FIFO.
+void KeyDaemon::KeyLoop::readControlCommands()
+{
+    using ControlFormat::Command;
+    ControlReader::Command command;
+    while (controlReader.readCommand(command))
+    {
+        switch (command.type)
+        {
+            case Command::pause:
+                setPaused(true);
+                break;
+            case Command::resume:
+                setPaused(false);
+                break;
+            case Command::setKeys:
+                replaceTrackedKeys(command.keyCodes, command.eventMasks);
+                break;
+        }
+    }
+}
+
+
+// Replaces the individually tracked keys, keeping all chords, sequences,
+// gestures, and open event files.
+void KeyDaemon::KeyLoop::replaceTrackedKeys(const std::vector<int>& keyCodes,
+        const std::vector<EventMask>& eventMasks)
+{
+    #ifdef KD_BAKED_KEYS
+    DBG(messagePrefix << __func__
+            << ": Tracked keys are fixed at build time, ignoring new keys.");
+    #else
+    const size_t readKeyCount = countReadKeys(keyCodes, chords, sequences,
+            gestures);
+    if (readKeyCount > KD_KEY_LIMIT)
+    {
+        DBG(messagePrefix << __func__ << ": Ignoring new keys, "
+                << readKeyCount << " distinct key codes exceeds maximum key "
+                << "code count " << KD_KEY_LIMIT);
+        return;
+    }
+    DBG_V(messagePrefix << __func__ << ": Tracking " << keyCodes.size()
+            << " keys.");
+    // Match all events until the new sets are in place, so events read with
+    // either set are only sent if the parent wants them:
+    forwardAllEvents = false;
+    {
+        std::lock_guard<std::mutex> lock(matchLock);
+        forwardedKeys = KeySet(keyCodes, eventMasks);
+        chordMatcher.setForwardedKeys(forwardedKeys);
+    }
+    const KeySet previousKeys = readKeys;
+    readKeys = getReadKeys(keyCodes, eventMasks, chords, sequences, gestures);
+    this->keyCodes = keyCodes;
+    if (! readingPaused)
+    {
+        publishKeys(readKeys);
+    }
+    forwardAllEvents = canForwardAllEvents();
+    // Keyboards that couldn't send any of the old keys were never opened, so
+    // event files only need to be searched again if keys were added:
+    for (unsigned int code = 0; code < KEY_CNT; code++)
+    {
+        if (readKeys.contains(code) && ! previousKeys.contains(code))
+        {
+            updateReaders();
+            return;
+        }
+    }
+    #endif
+}
+
+
+// Pauses or resumes reading key events.
+void KeyDaemon::KeyLoop::setPaused(const bool pause)
+{
+    if (pause == readingPaused)
+    {
+        return;
+    }
+    DBG_V(messagePrefix << __func__ << ": "
+            << (pause ? "Pausing" : "Resuming") << " key event reading.");
+    readingPaused = pause;
+    publishKeys(pause ? KeySet(std::vector<int>()) : readKeys);
+}
+
+
+// Shares a new tracked key set with all readers, and updates the kernel event
+// masks of their open event files.
+void KeyDaemon::KeyLoop::publishKeys(const KeySet& keys)
+{
+    trackedKeys.replace(keys);
+    for (KeyReader* reader : eventFileReaders)
+    {
+        reader->updateEventMask();
+    }
+    if (multiReader != nullptr)
+    {
+        multiReader->updateEventMasks();
+    }
+}
+#endif
+
+
+// Blocks until a KeyReader stops, keyboards are connected or removed, the
+// parent sends a command, a signal is received, or the reader wait timeout
+// period ends.
+void KeyDaemon::KeyLoop::waitForReaderChange()
+{
+    #ifdef KD_CONTROL
+    const int controlFD = controlReader.getFileDescriptor();
+    #else
+    const int controlFD = -1;
+    #endif
+    // Negative descriptors are ignored, so this is safe if the device watcher
+    // failed to start, no gestures were registered, or there is no control
+    // FIFO:
+    struct pollfd waitFDs[4] =
+    {
+        { readerEventFD, POLLIN, 0 },
+        { deviceWatcher.getFileDescriptor(), POLLIN, 0 },
+        { gestureDetector.getFileDescriptor(), POLLIN, 0 },
+        { controlFD, POLLIN, 0 }
+    };
+    const int pollResult = poll(waitFDs, 4, readerWaitTimeoutMS);
+    STAT_INC(loopWakeups);
+    if (pollResult > 0)
+    {
+        bool readersChanged = false;
+        uint64_t eventCount;
+        if ((waitFDs[0].revents & POLLIN) != 0
+                && read(readerEventFD, &eventCount, sizeof(eventCount)) > 0)
+        {
+            DBG_V(messagePrefix << __func__ << ": " << eventCount
+                    << " reader change(s) signaled.");
+            readersChanged = true;
+        }
+        if ((waitFDs[1].revents & POLLIN) != 0)
+        {
+            if (deviceWatcher.readChanges())
+            {
+                DBG_V(messagePrefix << __func__
+                        << ": Event files changed, updating readers.");
+                updateReaders();
+            }
+            readersChanged = true;
+        }
+        #ifdef KD_CONTROL
+        if ((waitFDs[3].revents & POLLIN) != 0)
+        {
+            readControlCommands();
+            readersChanged = true;
+        }
+        #endif
+        if ((waitFDs[2].revents & POLLIN) != 0)
+        {
+            sendTimedGestures();
+            return;
+        }
+        if (readersChanged)
+        {
+            return;
+        }
+    }
+    else if (pollResult < 0 && errno != EINTR)
+    {
+        DBG(messagePrefix << __func__ << ": poll failed, errno=" << errno);
+    }
+    STAT_INC(idleWakeups);
+}
+
+
+// Queues all long presses whose deadlines have passed, after the gesture timer
+// wakes the loop.
+void KeyDaemon::KeyLoop::sendTimedGestures()
+{
+    std::lock_guard<std::mutex> lock(matchLock);
+    KeyMessage output[GestureDetector::maxTimerMessages];
+    const int outputCount = gestureDetector.readTimers(output);
+    messageQueue.push(output, outputCount);
+}
+
+
+// Applies the repeat policy to a message, and adds whatever should be sent in
+// its place to the batch of matched messages.
+void KeyDaemon::KeyLoop::addMatchedMessage(const KeyMessage& message)
+{
+    if (message.kind != MessageKind::key || ! repeatThrottle.isActive())
+    {
+        matchedMessages[matchedCount] = message;
+        matchedCount++;
+        return;
+    }
+    // The repeat count is queued directly before its release, so the parent
+    // can pair them by sequence number:
+    const int outputCount = repeatThrottle.process(message,
+            matchedMessages + matchedCount);
+    if (outputCount == 0)
+    {
+        STAT_INC(suppressedRepeats);
+    }
+    matchedCount += outputCount;
+}
+
+
+// Queues the batch of matched messages all at once.
+void KeyDaemon::KeyLoop::queueMatchedMessages()
+{
+    if (matchedCount > 0)
+    {
+        messageQueue.push(matchedMessages, matchedCount);
+        matchedCount = 0;
+    }
+}
+
+
+// Wakes the loop to remove a KeyReader that stopped reading input.
+void KeyDaemon::KeyLoop::readerStopped()
+{
+    const uint64_t readerEvent = 1;
+    if (write(readerEventFD, &readerEvent, sizeof(readerEvent)) < 0)
+    {
+        DBG(messagePrefix << __func__
+                << ": Failed to signal stopped reader.");
+    }
+}
+
+
+// Wakes the loop to check if the daemon is ready, if the ready message hasn't
+// been sent yet.
+void KeyDaemon::KeyLoop::readerOpened()
+{
+    const uint64_t readerEvent = 1;
+    if (! readySent
+            && write(readerEventFD, &readerEvent, sizeof(readerEvent)) < 0)
+    {
+        DBG(messagePrefix << __func__
+                << ": Failed to signal opened reader.");
+    }
+}
+
+
+// Queues a tracked key event to send to the parent application.
+void KeyDaemon::KeyLoop::keyEvent(const int keyCode, const EventType type,
+        const uint64_t timestamp)
+{
+    const KeyMessage newEvent = { keyCode, type, timestamp };
+    keyEvents(&newEvent, 1);
+}
+
+
+// Queues a batch of tracked key events to send to the parent application.
+void KeyDaemon::KeyLoop::keyEvents(const KeyMessage* messages, const int count)
+{
+    #ifdef KD_CONTROL
+    // Readers may still pass on events read just before reading paused:
+    if (readingPaused)
+    {
+        return;
+    }
+    #endif
+    #ifdef KD_KEY_STATE
+    if (keyStatePublisher.isOpen())
+    {
+        std::lock_guard<std::mutex> lock(stateLock);
+        keyStatePublisher.update(messages, count);
+    }
+    #endif
+    if (forwardAllEvents)
+    {
+        messageQueue.push(messages, count);
+        return;
+    }
+    matchKeyEvents(messages, count);
+}
+
+
+// Passes a batch of key events through the matchers and the repeat policy,
+// and queues the messages they produce.
+void KeyDaemon::KeyLoop::matchKeyEvents(const KeyMessage* messages,
+        const int count)
 {
-    const KeyMessage newEvent = { keyCode, type };
-    messageParent((const unsigned char*) &newEvent, sizeof(KeyMessage));
+    // Chord, sequence, gesture, and repeat handling depend on event order, so
+    // events are matched and queued under the same lock:
+    std::lock_guard<std::mutex> lock(matchLock);
+    KeyMessage output[ChordMatcher::maxOutputMessages
+            + SequenceMatcher::maxOutputMessages
+            + GestureDetector::maxOutputMessages];
+    for (int i = 0; i < count; i++)
+    {
+        if (gestureDetector.suppresses(messages[i]))
+        {
+            STAT_INC(suppressedRepeats);
+            continue;
+        }
+        int outputCount = chordMatcher.process(messages[i], output);
+        outputCount += sequenceMatcher.process(messages[i],
+                output + outputCount);
+        outputCount += gestureDetector.process(messages[i],
+                output + outputCount);
+        for (int o = 0; o < outputCount; o++)
+        {
+            addMatchedMessage(output[o]);
+        }
+        // Everything matched from one batch of events is queued at once,
+        // unless another event could overflow the batch:
+        if (matchedCount > KD_EVENT_BUF_SIZE)
+        {
+            queueMatchedMessages();
+        }
+    }
+    queueMatchedMessages();
+}
+
+
+// Updates key state with releases for held keys that were removed from the
+// tracked key set, without sending them to the parent application.
+void KeyDaemon::KeyLoop::readerKeysRemoved(const KeyReader& reader,
+        const KeyMessage* releases, const int count)
+{
+    #ifdef KD_MERGE_KEYBOARDS
+    std::lock_guard<std::mutex> mergeGuard(mergeLock);
+    const int deviceIndex = keyMerger.getDeviceIndex(reader.getPath());
+    const int mergedCount = keyMerger.process(deviceIndex, releases, count,
+            mergedMessages);
+    releases = mergedMessages;
+    if (mergedCount == 0)
+    {
+        return;
+    }
+    #else
+    const int mergedCount = count;
+    #endif
+    #ifdef KD_KEY_STATE
+    if (keyStatePublisher.isOpen())
+    {
+        std::lock_guard<std::mutex> lock(stateLock);
+        keyStatePublisher.update(releases, mergedCount);
+    }
+    #endif
+    // The ChordMatcher needs the releases to keep its held key count, and it
+    // never forwards keys the parent doesn't track:
+    matchKeyEvents(releases, mergedCount);
+}
+
+
+#ifdef KD_MERGE_KEYBOARDS
+// Merges a batch of tracked key events from one keyboard with the combined key
+// state of all keyboards, and queues the events that change it.
+void KeyDaemon::KeyLoop::readerKeyEvents(const KeyReader& reader,
+        const KeyMessage* messages, const int count)
+{
+    // Matching happens under this lock too, so events from all keyboards
+    // reach the matchers in the order they were merged:
+    std::lock_guard<std::mutex> lock(mergeLock);
+    const int deviceIndex = keyMerger.getDeviceIndex(reader.getPath());
+    const int mergedCount = keyMerger.process(deviceIndex, messages, count,
+            mergedMessages);
+    STAT_ADD(mergedDuplicates, count - mergedCount);
+    if (mergedCount > 0)
+    {
+        keyEvents(mergedMessages, mergedCount);
+    }
+}
+
+
+// Queues releases for keys that were only held by keyboards that have been
+// removed.
+void KeyDaemon::KeyLoop::releaseRemovedKeyboards
+(const std::vector<std::string>& eventFilePaths)
+{
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    const uint64_t timestamp = static_cast<uint64_t>(currentTime.tv_sec)
+            * 1000000 + currentTime.tv_nsec / 1000;
+    std::lock_guard<std::mutex> lock(mergeLock);
+    const std::vector<KeyMessage> releases
+            = keyMerger.removeMissingDevices(eventFilePaths, timestamp);
+    if (! releases.empty())
+    {
+        DBG_V(messagePrefix << __func__ << ": Releasing " << releases.size()
+                << " keys held by removed keyboards.");
+        keyEvents(releases.data(), static_cast<int>(releases.size()));
+    }
+}
+#endif
+
+
+// Runs on the writer thread, sending queued messages to the parent application
+// until the message queue is closed and empty.
+void KeyDaemon::KeyLoop::writeMessages()
+{
+    using KeyWireFormat::maxFrameMessages;
+    KeyMessage frameMessages[maxFrameMessages];
+    while (true)
+    {
+        // Send everything queued so far in as few frames as possible:
+        int count = 0;
+        while (count < maxFrameMessages
+                && messageQueue.pop(frameMessages[count]))
+        {
+            count++;
+        }
+        if (count > 0)
+        {
+            sendFrame(frameMessages, count);
+            continue;
+        }
+        if (messageQueue.isClosed())
+        {
+            return;
+        }
+        // Pushing and closing both wake the writer, so it never needs to
+        // wake on its own:
+        messageQueue.waitForMessages();
+    }
+}
+
+
+// Sends a single frame of messages to the parent application, using one pipe
+// write.
+void KeyDaemon::KeyLoop::sendFrame(const KeyMessage* messages, const int count)
+{
+    using namespace KeyWireFormat;
+    unsigned char frame[maxFrameSize];
+    for (int i = 0; i < count; i++)
+    {
+        encode(messages[i], messages[i].sequence, frame + (i * messageSize));
+    }
+    #ifdef KD_SHM_TRANSPORT
+    if (ringWriter.isOpen())
+    {
+        #ifdef KD_QUEUE_BLOCK
+        // Wait for the parent to make room in a full ring, unless the daemon
+        // is stopping:
+        while (! ringWriter.write(frame, count))
+        {
+            if (messageQueue.isClosed())
+            {
+                STAT_ADD(droppedMessages, count);
+                break;
+            }
+            ringWriter.waitForSpace(count, ringWaitTimeoutMS);
+        }
+        #else
+        // Drop the frame if the ring is full. The parent will find the gap in
+        // sequence numbers:
+        if (! ringWriter.write(frame, count))
+        {
+            STAT_ADD(droppedMessages, count);
+        }
+        #endif
+        return;
+    }
+    #endif
+    messageParent(frame, count * messageSize);
+    STAT_INC(parentWrites);
 }
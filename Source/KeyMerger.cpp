@@ -0,0 +1,180 @@
+#include "KeyMerger.h"
+#include "KDDebug.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef KD_DEBUG
+static const constexpr char* messagePrefix = "KeyDaemon::KeyMerger::";
+#endif
+
+
+// Gets the bit used for a device index in holdingDevices masks.
+static inline uint64_t deviceBit(const int deviceIndex)
+{
+    return static_cast<uint64_t>(1) << deviceIndex;
+}
+
+
+// Finds the lowest device index in a non-empty holdingDevices mask.
+static inline int8_t firstDevice(const uint64_t devices)
+{
+    return static_cast<int8_t>(__builtin_ctzll(devices));
+}
+
+
+// Starts with no keys held by any keyboard.
+KeyDaemon::KeyMerger::KeyMerger()
+{
+    memset(repeatingDevices, -1, sizeof(repeatingDevices));
+}
+
+
+// Gets the index used to track a keyboard event file, assigning a new index
+// if the file hasn't been seen before.
+int KeyDaemon::KeyMerger::getDeviceIndex(const std::string& eventFilePath)
+{
+    int unusedIndex = -1;
+    for (size_t i = 0; i < devicePaths.size(); i++)
+    {
+        if (devicePaths[i] == eventFilePath)
+        {
+            return static_cast<int>(i);
+        }
+        if (unusedIndex < 0 && devicePaths[i].empty())
+        {
+            unusedIndex = static_cast<int>(i);
+        }
+    }
+    if (unusedIndex < 0)
+    {
+        if (devicePaths.size() >= maxDevices)
+        {
+            DBG(messagePrefix << __func__ << ": Too many keyboards, events "
+                    << "from \"" << eventFilePath << "\" won't be merged.");
+            return -1;
+        }
+        unusedIndex = static_cast<int>(devicePaths.size());
+        devicePaths.emplace_back();
+    }
+    devicePaths[unusedIndex] = eventFilePath;
+    DBG_V(messagePrefix << __func__ << ": Tracking \"" << eventFilePath
+            << "\" as device " << unusedIndex);
+    return unusedIndex;
+}
+
+
+// Removes key events that don't change any key's combined state from a batch
+// of events read from one keyboard.
+int KeyDaemon::KeyMerger::process(const int deviceIndex,
+        const KeyMessage* messages, const int count, KeyMessage* output)
+{
+    if (deviceIndex < 0)
+    {
+        std::copy(messages, messages + count, output);
+        return count;
+    }
+    const uint64_t device = deviceBit(deviceIndex);
+    int outputCount = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const unsigned int keyCode
+                = static_cast<unsigned int>(messages[i].keyCode);
+        if (keyCode >= KEY_CNT)
+        {
+            output[outputCount++] = messages[i];
+            continue;
+        }
+        uint64_t& holders = holdingDevices[keyCode];
+        int8_t& repeatingDevice = repeatingDevices[keyCode];
+        bool keepEvent;
+        if (messages[i].event == EventType::released)
+        {
+            holders &= ~device;
+            // Releases of keys no keyboard was known to hold are kept, in
+            // case the key was pressed before the keyboard was read:
+            keepEvent = (holders == 0);
+            if (keepEvent)
+            {
+                repeatingDevice = -1;
+            }
+            else if (repeatingDevice == deviceIndex)
+            {
+                repeatingDevice = firstDevice(holders);
+            }
+        }
+        else
+        {
+            // Repeats of keys pressed before the keyboard was read start
+            // holding the key, just like presses:
+            keepEvent = (holders == 0)
+                    || (messages[i].event == EventType::held
+                        && repeatingDevice == deviceIndex);
+            holders |= device;
+            if (repeatingDevice < 0)
+            {
+                repeatingDevice = static_cast<int8_t>(deviceIndex);
+            }
+        }
+        if (keepEvent)
+        {
+            output[outputCount++] = messages[i];
+        }
+        else
+        {
+            duplicateCount++;
+        }
+    }
+    return outputCount;
+}
+
+
+// Stops tracking every keyboard whose event file is no longer present,
+// releasing keys that only those keyboards held.
+std::vector<KeyDaemon::KeyMessage> KeyDaemon::KeyMerger::removeMissingDevices
+(const std::vector<std::string>& eventFilePaths, const uint64_t timestamp)
+{
+    uint64_t removedDevices = 0;
+    for (size_t i = 0; i < devicePaths.size(); i++)
+    {
+        if (! devicePaths[i].empty() && std::find(eventFilePaths.begin(),
+                eventFilePaths.end(), devicePaths[i]) == eventFilePaths.end())
+        {
+            DBG_V(messagePrefix << __func__ << ": Device " << i << " at \""
+                    << devicePaths[i] << "\" was removed.");
+            removedDevices |= deviceBit(static_cast<int>(i));
+            devicePaths[i].clear();
+        }
+    }
+    std::vector<KeyMessage> releases;
+    if (removedDevices == 0)
+    {
+        return releases;
+    }
+    for (int keyCode = 0; keyCode < KEY_CNT; keyCode++)
+    {
+        uint64_t& holders = holdingDevices[keyCode];
+        if ((holders & removedDevices) == 0)
+        {
+            continue;
+        }
+        holders &= ~removedDevices;
+        if (holders == 0)
+        {
+            repeatingDevices[keyCode] = -1;
+            releases.push_back({ keyCode, EventType::released, timestamp });
+        }
+        else if ((removedDevices & deviceBit(repeatingDevices[keyCode])) != 0)
+        {
+            repeatingDevices[keyCode] = firstDevice(holders);
+        }
+    }
+    return releases;
+}
+
+
+// Gets the total number of key events removed because another keyboard
+// already pressed, held, or still holds their key.
+unsigned long KeyDaemon::KeyMerger::getDuplicateCount() const
+{
+    return duplicateCount;
+}
@@ -1,25 +1,40 @@
 #include "KeyReader.h"
+#include "KeyFilter.h"
+#include "KeyStats.h"
+#include "BakedKeys.h"
 #include "KDDebug.h"
 #include <sys/ioctl.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
 #include <signal.h>
-#include <algorithm>
+#include <time.h>
 
 #ifdef KD_DEBUG
 // Print the application and class name before all info/error messages:
 static const constexpr char* messagePrefix = "KeyDaemon: KeyReader::";
 #endif
 
+// Number of bits stored in each key state bitmap word:
+static const constexpr int wordBits = sizeof(unsigned long) * 8;
+
 // Initializes the KeyReader and starts listening for relevant keyboard events.
 KeyDaemon::KeyReader::KeyReader(const char* eventFilePath,
-        const std::vector<int>& keyCodes, Listener* listener) :
+        const KeySetBuffer& trackedKeys, Listener* listener,
+        const bool startThread) :
     InputReader(eventFilePath),
-    trackedCodes(keyCodes),
-    listener(listener)
+    trackedKeys(trackedKeys),
+    listener(listener),
+    inputStopped(false),
+    fileOpened(false),
+    eventFileDescriptor(-1)
 {
-    if (! startReading())
+    if (! startThread)
+    {
+        DBG_V(messagePrefix << __func__ << ": Created unthreaded reader for \""
+                << eventFilePath << "\"");
+    }
+    else if (! startReading())
     {
         DBG(messagePrefix << __func__ 
                 << ": Failed to start listening for key events from \""
@@ -48,14 +63,123 @@ int KeyDaemon::KeyReader::openFile()
         #ifdef DEBUG
             perror(messagePrefix);
         #endif
+        inputStopped = true;
+        if (listener != nullptr)
+        {
+            listener->readerStopped();
+        }
         return 0;
     }
     DBG_V(messagePrefix << __func__ 
             << ": Opened keyboard event file \"" << getPath() << "\"");
+    // Save the descriptor first, so updateEventMask can't miss a key set
+    // replaced while the mask is installed:
+    eventFileDescriptor = keyEventFileDescriptor;
+    if (installEventMask(keyEventFileDescriptor))
+    {
+        STAT_INC(kernelFilteredFiles);
+    }
+    kernelMonotonicTime = useMonotonicClock(keyEventFileDescriptor);
+    syncKeyState();
+    fileOpened = true;
+    if (listener != nullptr)
+    {
+        listener->readerOpened();
+    }
     return keyEventFileDescriptor;
 }
 
 
+// Updates the kernel event mask of the open event file after the tracked key
+// set is replaced.
+bool KeyDaemon::KeyReader::updateEventMask()
+{
+    const int fileDescriptor = eventFileDescriptor;
+    return fileDescriptor >= 0 && installEventMask(fileDescriptor);
+}
+
+
+// Asks the kernel to timestamp input events using CLOCK_MONOTONIC instead of
+// CLOCK_REALTIME.
+bool KeyDaemon::KeyReader::useMonotonicClock(const int fileDescriptor)
+{
+    int clockID = CLOCK_MONOTONIC;
+    if (ioctl(fileDescriptor, EVIOCSCLOCKID, &clockID) != 0)
+    {
+        DBG(messagePrefix << __func__
+                << ": Kernel monotonic timestamps unsupported for \""
+                << getPath() << "\", timestamping events on read.");
+        return false;
+    }
+    return true;
+}
+
+
+// Asks the kernel to only report tracked key events and synchronization
+// events from the event file.
+bool KeyDaemon::KeyReader::installEventMask(const int fileDescriptor)
+{
+#ifdef EVIOCSMASK
+    // KeySet bitmaps use the same layout as kernel event masks. If the set
+    // is replaced while installing, install it again so the newest set wins:
+    unsigned int generation;
+    int maskResult;
+    do
+    {
+        const KeySet maskKeys = trackedKeys.copy(generation);
+        struct input_mask keyMask;
+        keyMask.type = EV_KEY;
+        keyMask.codes_size = KeySet::getBitmapSize();
+        keyMask.codes_ptr = reinterpret_cast<unsigned long>
+                (maskKeys.getBitmap());
+        maskResult = ioctl(fileDescriptor, EVIOCSMASK, &keyMask);
+    }
+    while (maskResult == 0 && trackedKeys.changedSince(generation));
+    if (maskResult != 0)
+    {
+        DBG(messagePrefix << __func__
+                << ": Kernel event masks unsupported for \"" << getPath()
+                << "\", filtering events in user space.");
+        return false;
+    }
+    // Block every other event type the device sends, like miscellaneous,
+    // LED, and pointer events on combo devices, as they're never reported.
+    // Synchronization events are kept to find packet boundaries and dropped
+    // events. The kernel copies no more of each mask than the type needs, so
+    // a single empty mask sized for key codes fits every type:
+    static const constexpr int bitsPerWord = sizeof(unsigned long) * 8;
+    unsigned long typeBits[(EV_CNT + bitsPerWord - 1) / bitsPerWord] = {};
+    if (ioctl(fileDescriptor, EVIOCGBIT(0, sizeof(typeBits)), typeBits) < 0)
+    {
+        typeBits[EV_MSC / bitsPerWord] |= 1UL << (EV_MSC % bitsPerWord);
+    }
+    static const unsigned long emptyBits[(KEY_CNT + bitsPerWord - 1)
+            / bitsPerWord] = {};
+    for (int type = 0; type < EV_CNT; type++)
+    {
+        if (type == EV_SYN || type == EV_KEY
+                || ((typeBits[type / bitsPerWord] >> (type % bitsPerWord)) & 1)
+                    == 0)
+        {
+            continue;
+        }
+        struct input_mask emptyMask;
+        emptyMask.type = type;
+        emptyMask.codes_size = sizeof(emptyBits);
+        emptyMask.codes_ptr = reinterpret_cast<unsigned long>(emptyBits);
+        // Types without kernel mask support, like EV_REP, are rejected and
+        // still filtered in processInput:
+        ioctl(fileDescriptor, EVIOCSMASK, &emptyMask);
+    }
+    DBG_V(messagePrefix << __func__ << ": Installed kernel event mask for \""
+            << getPath() << "\"");
+    return true;
+#else
+    return false;
+#endif
+}
+
+
 // Processes new input from the input file.
 void KeyDaemon::KeyReader::processInput(const int inputBytes)
 {
@@ -69,39 +193,222 @@ void KeyDaemon::KeyReader::processInput(const int inputBytes)
         stopReading();
         return;
     }
+    if (inputBytes <= 0)
+    {
+        DBG(messagePrefix << __func__ << ": Reading from \"" << getPath()
+                << "\" failed, notifying listener.");
+        eventFileDescriptor = -1;
+        inputStopped = true;
+        listener->readerStopped();
+        return;
+    }
     const int eventsRead = inputBytes / sizeof(struct input_event);
     DBG_V(messagePrefix << __func__ << ": Read " << eventsRead 
             << " input events from \"" << getPath() << "\":");
-    if (eventsRead > 0)
+    processEventRange(0, eventsRead);
+}
+
+
+// Processes a range of input events already read into the input buffer.
+void KeyDaemon::KeyReader::processEventRange(const int startIndex,
+        const int endIndex)
+{
+    if (trackedKeys.getGeneration() != keyGeneration)
     {
-        for (int i = 0; i < eventsRead; i++)
+        syncKeyState();
+    }
+    int eventIndex = startIndex;
+    while (eventIndex < endIndex)
+    {
+        if (! resyncPending)
         {
-            if (eventBuffer[i].type != EV_KEY || eventBuffer[i].value < 0
-                    || eventBuffer[i].value 
-                    >= (int) EventType::trackedTypeCount)
+            eventIndex = processEvents(eventIndex, endIndex);
+            continue;
+        }
+        // Discard events until the end of the incomplete report, then
+        // replace them with the keyboard's current state:
+        while (eventIndex < endIndex && (eventBuffer[eventIndex].type
+                    != EV_SYN || eventBuffer[eventIndex].code != SYN_REPORT))
+        {
+            eventIndex++;
+        }
+        if (eventIndex < endIndex)
+        {
+            eventIndex++;
+            resyncPending = false;
+            syncKeyState();
+        }
+    }
+}
+
+
+// Filters and reports a range of input events from the input buffer, stopping
+// early after a SYN_DROPPED event.
+int KeyDaemon::KeyReader::processEvents(const int startIndex,
+        const int endIndex)
+{
+    const struct input_event* events = eventBuffer + startIndex;
+    const int eventCount = endIndex - startIndex;
+    #ifdef KD_BAKED_KEYS
+    // Built-in key codes let the filter check codes against constants:
+    int trackedCount = KeyFilter::findTracked(events, eventCount,
+            BakedKeys::Set(), trackedIndices);
+    #else
+    // Filter again if the tracked key set is replaced while in use:
+    unsigned int generation;
+    int trackedCount;
+    do
+    {
+        trackedCount = KeyFilter::findTracked(events, eventCount,
+                trackedKeys.read(generation), trackedIndices);
+    }
+    while (trackedKeys.changedSince(generation));
+    #endif
+    int nextIndex = endIndex;
+    for (int i = 0; i < trackedCount; i++)
+    {
+        if (events[trackedIndices[i]].type == EV_SYN)
+        {
+            DBG(messagePrefix << __func__ << ": Kernel dropped events from \""
+                    << getPath() << "\", resyncing key state.");
+            STAT_INC(droppedInputEvents);
+            resyncPending = true;
+            nextIndex = startIndex + trackedIndices[i] + 1;
+            trackedCount = i;
+            break;
+        }
+    }
+    STAT_ADD(userFilteredEvents, (nextIndex - startIndex) - trackedCount
+            - (resyncPending ? 1 : 0));
+    STAT_ADD(trackedEvents, trackedCount);
+    if (trackedCount == 0)
+    {
+        return nextIndex;
+    }
+    uint64_t readTime = 0;
+    if (! kernelMonotonicTime)
+    {
+        struct timespec currentTime;
+        clock_gettime(CLOCK_MONOTONIC, &currentTime);
+        readTime = static_cast<uint64_t>(currentTime.tv_sec) * 1000000
+                + currentTime.tv_nsec / 1000;
+    }
+    for (int i = 0; i < trackedCount; i++)
+    {
+        const struct input_event& event = events[trackedIndices[i]];
+        DBG_V(messagePrefix << __func__ << ": Event " << trackedIndices[i]
+                << ": Sending tracked event of type " << event.type
+                << ", value " << event.value << ", code " << event.code
+                << " to Listener.");
+        trackedMessages[i].keyCode = event.code;
+        trackedMessages[i].event = (EventType) event.value;
+        trackedMessages[i].timestamp = kernelMonotonicTime
+                ? (static_cast<uint64_t>(event.input_event_sec) * 1000000
+                    + event.input_event_usec)
+                : readTime;
+        if (event.value != static_cast<int>(EventType::held))
+        {
+            const unsigned long keyBit = 1UL << (event.code % wordBits);
+            unsigned long& heldWord = heldKeys[event.code / wordBits];
+            heldWord = (event.value == 0) ? (heldWord & ~keyBit)
+                    : (heldWord | keyBit);
+        }
+    }
+    listener->readerKeyEvents(*this, trackedMessages, trackedCount);
+    return nextIndex;
+}
+
+
+// Asks the kernel which keys the keyboard is holding, and reports each tracked
+// key whose state differs from the state the KeyReader last reported.
+void KeyDaemon::KeyReader::syncKeyState()
+{
+    const KeySet syncKeys = trackedKeys.copy(keyGeneration);
+    const unsigned long* trackedBits = syncKeys.getBitmap();
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    const uint64_t syncTime = static_cast<uint64_t>(currentTime.tv_sec)
+            * 1000000 + currentTime.tv_nsec / 1000;
+    // Release held keys that are no longer tracked, so the listener doesn't
+    // keep treating them as held:
+    int syncCount = 0;
+    for (int word = 0; word < keyWordCount; word++)
+    {
+        unsigned long removedKeys = heldKeys[word] & ~trackedBits[word];
+        heldKeys[word] &= trackedBits[word];
+        while (listener != nullptr && removedKeys != 0)
+        {
+            const int bit = __builtin_ctzl(removedKeys);
+            removedKeys &= removedKeys - 1;
+            trackedMessages[syncCount++] = { (word * wordBits) + bit,
+                    EventType::released, syncTime };
+            if (syncCount == eventBufSize)
             {
-                continue;
+                listener->readerKeysRemoved(*this, trackedMessages,
+                        syncCount);
+                syncCount = 0;
             }
-            if (std::binary_search(trackedCodes.begin(), trackedCodes.end(),
-                        eventBuffer[i].code))
+        }
+    }
+    if (syncCount > 0)
+    {
+        DBG_V(messagePrefix << __func__ << ": Releasing " << syncCount
+                << " untracked keys from \"" << getPath() << "\".");
+        listener->readerKeysRemoved(*this, trackedMessages, syncCount);
+        syncCount = 0;
+    }
+    unsigned long kernelKeys[keyWordCount] = {};
+    if (listener == nullptr || ioctl(eventFileDescriptor,
+            EVIOCGKEY(sizeof(kernelKeys)), kernelKeys) < 0)
+    {
+        DBG(messagePrefix << __func__ << ": Unable to read key state from \""
+                << getPath() << "\".");
+        return;
+    }
+    for (int word = 0; word < keyWordCount; word++)
+    {
+        unsigned long changedKeys = (kernelKeys[word] ^ heldKeys[word])
+                & trackedBits[word];
+        while (changedKeys != 0)
+        {
+            const int bit = __builtin_ctzl(changedKeys);
+            changedKeys &= changedKeys - 1;
+            const int keyCode = (word * wordBits) + bit;
+            const bool isHeld = ((kernelKeys[word] >> bit) & 1) != 0;
+            const EventType type = isHeld ? EventType::pressed
+                    : EventType::released;
+            heldKeys[word] ^= (1UL << bit);
+            if (syncKeys.accepts(keyCode, static_cast<unsigned int>(type)))
             {
-                DBG_V(messagePrefix << __func__ << ": Event " << i
-                        << ": Sending tracked event of type "
-                        << eventBuffer[i].type << ", value " 
-                        << eventBuffer[i].value << ", code "
-                        << eventBuffer[i].code << " to Listener.");
-                listener->keyEvent(eventBuffer[i].code,
-                        (EventType) eventBuffer[i].value);
+                trackedMessages[syncCount++] = { keyCode, type, syncTime };
             }
-            else
+            if (syncCount == eventBufSize)
             {
-                DBG_V(messagePrefix << __func__ << ": Event " << i
-                        << ": Ignoring event of type " << eventBuffer[i].type
-                        << ", value " << eventBuffer[i].value 
-                        << " with untracked code " << eventBuffer[i].code);
+                listener->readerKeyEvents(*this, trackedMessages, syncCount);
+                syncCount = 0;
             }
         }
     }
+    DBG_V(messagePrefix << __func__ << ": Sending " << syncCount
+            << " key state changes from \"" << getPath() << "\".");
+    if (syncCount > 0)
+    {
+        listener->readerKeyEvents(*this, trackedMessages, syncCount);
+    }
+}
+
+
+// Checks if the KeyReader has permanently stopped reading input.
+bool KeyDaemon::KeyReader::hasStopped() const
+{
+    return inputStopped;
+}
+
+
+// Checks if the KeyReader opened its event file.
+bool KeyDaemon::KeyReader::hasOpened() const
+{
+    return fileOpened;
 }
 
 
@@ -0,0 +1,34 @@
+#include "KeySet.h"
+
+
+// Builds the key bitmap and event type table on construction.
+KeyDaemon::KeySet::KeySet(const std::vector<int>& keyCodes,
+        const std::vector<EventMask>& eventMasks)
+{
+    for (size_t i = 0; i < keyCodes.size(); i++)
+    {
+        const int& code = keyCodes[i];
+        const EventMask mask = (i < eventMasks.size())
+                ? (eventMasks[i] & allEventTypes) : allEventTypes;
+        if (code >= 0 && code < KEY_CNT && mask != 0)
+        {
+            bitmap[code / wordBits] |= (1UL << (code % wordBits));
+            this->eventMasks[code] |= static_cast<uint8_t>(mask);
+        }
+    }
+}
+
+
+// Gets the event types tracked for a key code.
+KeyDaemon::EventMask KeyDaemon::KeySet::getEventMask
+(const unsigned int keyCode) const
+{
+    return (keyCode < KEY_CNT) ? eventMasks[keyCode] : 0;
+}
+
+
+// Gets the set's bitmap data.
+const unsigned long* KeyDaemon::KeySet::getBitmap() const
+{
+    return bitmap;
+}
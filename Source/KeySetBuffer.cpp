@@ -0,0 +1,32 @@
+#include "KeySetBuffer.h"
+
+
+// Copies the initial tracked key set on construction.
+KeyDaemon::KeySetBuffer::KeySetBuffer(const KeySet& keys) :
+sets{ keys, keys },
+sequence(0) { }
+
+
+// Copies a consistent snapshot of the active key set, for uses that can't be
+// repeated if the set changes.
+KeyDaemon::KeySet KeyDaemon::KeySetBuffer::copy
+(unsigned int& generation) const
+{
+    KeySet keys = read(generation);
+    while (changedSince(generation))
+    {
+        keys = read(generation);
+    }
+    return keys;
+}
+
+
+// Replaces the active key set.
+void KeyDaemon::KeySetBuffer::replace(const KeySet& keys)
+{
+    const unsigned int start = sequence.load(std::memory_order_relaxed);
+    sequence.store(start + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    sets[((start / 2) + 1) & 1] = keys;
+    sequence.store(start + 2, std::memory_order_release);
+}
@@ -0,0 +1,97 @@
+#include "KeyStatePublisher.h"
+#include "SharedFile.h"
+#include "KDDebug.h"
+
+#ifdef KD_DEBUG
+// Print the application and class name before all info/error messages:
+static const constexpr char* messagePrefix = "KeyDaemon: KeyStatePublisher::";
+#endif
+
+
+// Opens and maps the key state page on construction.
+KeyDaemon::KeyStatePublisher::KeyStatePublisher(const char* pagePath)
+{
+    void* mapping = SharedFile::open(pagePath, sizeof(KeyStatePage::Page));
+    if (mapping == nullptr)
+    {
+        return;
+    }
+    KeyStatePage::Page* mappedPage = static_cast<KeyStatePage::Page*>(mapping);
+    if (mappedPage->magic != KeyStatePage::magic
+            || mappedPage->version != KeyStatePage::version)
+    {
+        DBG(messagePrefix << __func__ << ": Key state page \"" << pagePath
+                << "\" has an unexpected layout.");
+        SharedFile::unmap(mapping, sizeof(KeyStatePage::Page));
+        return;
+    }
+    page = mappedPage;
+    DBG_V(messagePrefix << __func__ << ": Mapped key state page \""
+            << pagePath << "\"");
+}
+
+
+// Unmaps the key state page on destruction.
+KeyDaemon::KeyStatePublisher::~KeyStatePublisher()
+{
+    SharedFile::unmap(page, sizeof(KeyStatePage::Page));
+    page = nullptr;
+}
+
+
+// Checks if the key state page was successfully opened and mapped.
+bool KeyDaemon::KeyStatePublisher::isOpen() const
+{
+    return page != nullptr;
+}
+
+
+// Applies a batch of key events to the published key state.
+void KeyDaemon::KeyStatePublisher::update
+(const KeyMessage* messages, const int count)
+{
+    using namespace KeyStatePage;
+    if (page == nullptr)
+    {
+        return;
+    }
+    // Apply events to a local copy first, so readers aren't made to retry
+    // when nothing changes, as with key repeat events:
+    uint64_t pressedKeys[wordCount];
+    bool changed = false;
+    for (unsigned int i = 0; i < wordCount; i++)
+    {
+        pressedKeys[i] = page->pressedKeys[i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        const unsigned int keyCode = messages[i].keyCode;
+        if (keyCode >= KEY_CNT)
+        {
+            continue;
+        }
+        uint64_t& word = pressedKeys[wordIndex(keyCode)];
+        const uint64_t oldWord = word;
+        if (messages[i].event == EventType::released)
+        {
+            word &= ~bitMask(keyCode);
+        }
+        else
+        {
+            word |= bitMask(keyCode);
+        }
+        changed |= (word != oldWord);
+    }
+    if (! changed)
+    {
+        return;
+    }
+    const uint32_t sequence = page->sequence.load(std::memory_order_relaxed);
+    page->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (unsigned int i = 0; i < wordCount; i++)
+    {
+        page->pressedKeys[i].store(pressedKeys[i], std::memory_order_relaxed);
+    }
+    page->sequence.store(sequence + 2, std::memory_order_release);
+}
@@ -0,0 +1,127 @@
+#include "KeyStateReader.h"
+#include "SharedFile.h"
+#include "KDDebug.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <new>
+
+#ifdef KD_DEBUG
+static const constexpr char* messagePrefix = "KeyDaemon::KeyStateReader::";
+#endif
+
+
+// Checks if a key was held down when the snapshot was taken.
+bool KeyDaemon::KeyStateReader::Snapshot::isPressed
+(const unsigned int keyCode) const
+{
+    using namespace KeyStatePage;
+    return keyCode < KEY_CNT
+            && (pressedKeys[wordIndex(keyCode)] & bitMask(keyCode)) != 0;
+}
+
+
+// Saves the key state page path on construction.
+KeyDaemon::KeyStateReader::KeyStateReader(const char* pagePath) :
+pagePath(pagePath) { }
+
+
+// Unmaps and removes the key state page on destruction.
+KeyDaemon::KeyStateReader::~KeyStateReader()
+{
+    SharedFile::unmap(const_cast<KeyStatePage::Page*>(page),
+            sizeof(KeyStatePage::Page));
+    unlink(pagePath.c_str());
+}
+
+
+// Creates a new key state page with owner-only permissions and no held keys,
+// replacing any existing page.
+bool KeyDaemon::KeyStateReader::create()
+{
+    using KeyStatePage::Page;
+    SharedFile::unmap(const_cast<Page*>(page), sizeof(Page));
+    page = nullptr;
+    void* mapping = SharedFile::create(pagePath.c_str(), sizeof(Page));
+    if (mapping == nullptr)
+    {
+        return false;
+    }
+    Page* newPage = new (mapping) Page;
+    newPage->version = KeyStatePage::version;
+    newPage->sequence.store(0, std::memory_order_relaxed);
+    for (std::atomic<uint64_t>& word : newPage->pressedKeys)
+    {
+        word.store(0, std::memory_order_relaxed);
+    }
+    newPage->magic = KeyStatePage::magic;
+    // Only the daemon should ever change key state:
+    if (mprotect(mapping, sizeof(Page), PROT_READ) != 0)
+    {
+        DBG(messagePrefix << __func__
+                << ": Failed to make key state page read-only.");
+    }
+    page = newPage;
+    return true;
+}
+
+
+// Gets the current page generation number, which changes each time the
+// daemon publishes a change in key state.
+uint32_t KeyDaemon::KeyStateReader::getGeneration() const
+{
+    if (page == nullptr)
+    {
+        return 0;
+    }
+    return page->sequence.load(std::memory_order_acquire) / 2;
+}
+
+
+// Copies the current key state.
+bool KeyDaemon::KeyStateReader::readSnapshot(Snapshot& snapshot) const
+{
+    using namespace KeyStatePage;
+    if (page == nullptr)
+    {
+        return false;
+    }
+    uint32_t startSequence;
+    uint32_t endSequence;
+    do
+    {
+        startSequence = page->sequence.load(std::memory_order_acquire);
+        for (unsigned int i = 0; i < wordCount; i++)
+        {
+            snapshot.pressedKeys[i]
+                    = page->pressedKeys[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        endSequence = page->sequence.load(std::memory_order_relaxed);
+    }
+    while ((startSequence & 1) != 0 || startSequence != endSequence);
+    snapshot.generation = startSequence / 2;
+    return true;
+}
+
+
+// Checks if a single key is currently held down.
+bool KeyDaemon::KeyStateReader::isPressed(const unsigned int keyCode) const
+{
+    using namespace KeyStatePage;
+    if (page == nullptr || keyCode >= KEY_CNT)
+    {
+        return false;
+    }
+    uint32_t startSequence;
+    uint64_t word;
+    do
+    {
+        startSequence = page->sequence.load(std::memory_order_acquire);
+        word = page->pressedKeys[wordIndex(keyCode)].load(
+                std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    while ((startSequence & 1) != 0
+            || startSequence != page->sequence.load(std::memory_order_relaxed));
+    return (word & bitMask(keyCode)) != 0;
+}
@@ -0,0 +1,82 @@
+#include "KeyStats.h"
+#ifdef KD_STATS
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+using Clock = std::chrono::steady_clock;
+
+// Counter names, in the same order as the KeyStats::Counter enum:
+static const char* counterNames[] =
+{
+    "loopWakeups",
+    "idleWakeups",
+    "kernelFilteredFiles",
+    "userFilteredEvents",
+    "trackedEvents",
+    "parentWrites",
+    "droppedMessages",
+    "queueDrops",
+    "blockedPushes",
+    "peakQueueDepth",
+    "skippedDevices",
+    "suppressedRepeats",
+    "mergedDuplicates",
+    "droppedInputEvents"
+};
+
+static const constexpr int counterCount
+        = static_cast<int>(KeyDaemon::KeyStats::Counter::counterCount);
+
+static_assert(sizeof(counterNames) / sizeof(counterNames[0]) == counterCount,
+        "Every KeyStats counter must have a name.");
+
+// Current counter values:
+static std::atomic<unsigned long> counters[counterCount];
+
+// Time when counting started:
+static const Clock::time_point startTime = Clock::now();
+
+
+// Adds to one of the daemon's performance counters.
+void KeyDaemon::KeyStats::add(const Counter counter, const unsigned long amount)
+{
+    counters[static_cast<int>(counter)].fetch_add(amount,
+            std::memory_order_relaxed);
+}
+
+
+// Raises one of the daemon's performance counters to a new value, if the value
+// is larger than the current count.
+void KeyDaemon::KeyStats::raise(const Counter counter,
+        const unsigned long value)
+{
+    std::atomic<unsigned long>& peak = counters[static_cast<int>(counter)];
+    unsigned long current = peak.load(std::memory_order_relaxed);
+    while (value > current && ! peak.compare_exchange_weak(current, value,
+                std::memory_order_relaxed)) { }
+}
+
+
+// Prints all counter values to stderr, along with their average rate per
+// second since the daemon started.
+void KeyDaemon::KeyStats::printAll()
+{
+    const double seconds = std::chrono::duration<double>
+            (Clock::now() - startTime).count();
+    fprintf(stderr, "KeyDaemon stats over %.2f seconds:\n", seconds);
+    for (int i = 0; i < counterCount; i++)
+    {
+        const unsigned long value = counters[i].load();
+        if (i == static_cast<int>(Counter::peakQueueDepth))
+        {
+            // Peak values have no meaningful rate:
+            fprintf(stderr, "  %-24s %10lu  (peak)\n", counterNames[i],
+                    value);
+            continue;
+        }
+        fprintf(stderr, "  %-24s %10lu  (%.3f/s)\n", counterNames[i], value,
+                (seconds > 0) ? (value / seconds) : 0.0);
+    }
+}
+#endif
@@ -1,8 +1,14 @@
 #include "KeyLoop.h"
 #include "KeyCode.h"
+#include "ChordMatcher.h"
+#include "SequenceMatcher.h"
+#include "GestureDetector.h"
+#include "RepeatThrottle.h"
 #include "KeyExitCode.h"
+#include "BakedKeys.h"
 #include "KDDebug.h"
 #include <iostream>
+#include <algorithm>
 
 #ifdef KD_DEBUG
 static const constexpr char* messagePrefix = "DaemonFramework Main: ";
@@ -12,15 +18,87 @@ int main(int argc, char** argv)
 {
     using namespace KeyDaemon;
     DBG_V(messagePrefix << "Launching daemon with " << argc << " arguments.");
-    std::vector<int> keyCodes = KeyCode::parseCodes(argc, argv);
+    std::vector<std::vector<int>> chords;
+    std::vector<std::vector<int>> sequences;
+    std::vector<KeyGesture> gestures;
+    std::vector<EventMask> eventMasks;
+    RepeatPolicy repeatPolicy;
+    unsigned int repeatRateHz;
+    if (! KeyCode::parseRepeatPolicy(argc, argv, repeatPolicy, repeatRateHz)
+            || repeatRateHz > RepeatThrottle::maxRateHz)
+    {
+        DBG(messagePrefix << "Exiting: repeat policy argument was invalid.");
+        return (int) KeyExitCode::badTrackedKeys;
+    }
+    const int repeatArgCount = std::count_if(argv, argv + argc,
+            KeyCode::isRepeatArg);
+    bool hasKeyCodeArgs = true;
+    #ifdef KD_BAKED_KEYS
+    // Tracked keys are fixed at build time, so any key code arguments are an
+    // attempt to change them:
+    if (KeyCode::countCodeArgs(argc, argv) > repeatArgCount)
+    {
+        DBG(messagePrefix << "Exiting: key code arguments are not accepted "
+                << "when tracked keys are built in.");
+        return (int) KeyExitCode::badTrackedKeys;
+    }
+    std::vector<int> keyCodes = BakedKeys::getCodes();
+    #else
+    if (! KeyCode::parseChords(argc, argv, chords)
+            || chords.size() > ChordMatcher::maxChords
+            || ! std::all_of(chords.begin(), chords.end(),
+                ChordMatcher::isValidChord))
+    {
+        DBG(messagePrefix << "Exiting: chord arguments were invalid.");
+        return (int) KeyExitCode::badTrackedKeys;
+    }
+    if (! KeyCode::parseSequences(argc, argv, sequences)
+            || sequences.size() > SequenceMatcher::maxSequences
+            || ! std::all_of(sequences.begin(), sequences.end(),
+                SequenceMatcher::isValidSequence))
+    {
+        DBG(messagePrefix << "Exiting: sequence arguments were invalid.");
+        return (int) KeyExitCode::badTrackedKeys;
+    }
+    if (! KeyCode::parseGestures(argc, argv, gestures)
+            || gestures.size() > GestureDetector::maxGestureKeys
+            || ! std::all_of(gestures.begin(), gestures.end(),
+                GestureDetector::isValidGesture))
+    {
+        DBG(messagePrefix << "Exiting: gesture arguments were invalid.");
+        return (int) KeyExitCode::badTrackedKeys;
+    }
+    // Parents may register chords, sequences, or gestures without tracking
+    // any individual keys:
+    hasKeyCodeArgs = KeyCode::countCodeArgs(argc, argv) > static_cast<int>(
+            chords.size() + sequences.size() + gestures.size()
+            + repeatArgCount);
+    std::vector<int> keyCodes = hasKeyCodeArgs
+            ? KeyCode::parseCodes(argc, argv, eventMasks) : std::vector<int>();
+    #endif
     
-    if (keyCodes.empty())
+    if (keyCodes.empty() && (hasKeyCodeArgs
+            || (chords.empty() && sequences.empty() && gestures.empty())))
     {
         DBG(messagePrefix << "Exiting: tracked key codes were invalid.");
         return (int) KeyExitCode::badTrackedKeys;
     }
-    DBG_V(messagePrefix << "Daemon tracking " << keyCodes.size() << " keys.");
-    KeyDaemon::KeyLoop daemonLoop(keyCodes);
+    // Chord, sequence, and gesture keys are read from keyboards too, so they
+    // count towards the key limit along with individually tracked keys:
+    const size_t readKeyCount = KeyLoop::countReadKeys(keyCodes, chords,
+            sequences, gestures);
+    if (readKeyCount > KD_KEY_LIMIT)
+    {
+        DBG(messagePrefix << "Exiting: " << readKeyCount << " distinct key "
+                << "codes exceeds maximum key code count " << KD_KEY_LIMIT);
+        return (int) KeyExitCode::badTrackedKeys;
+    }
+    DBG_V(messagePrefix << "Daemon tracking " << keyCodes.size()
+            << " keys, " << chords.size() << " chords, "
+            << sequences.size() << " sequences, and " << gestures.size()
+            << " gesture keys.");
+    KeyDaemon::KeyLoop daemonLoop(keyCodes, eventMasks, chords, sequences,
+            gestures, repeatPolicy, repeatRateHz);
     int returnCode = daemonLoop.runLoop();
     DBG(messagePrefix << "KeyDaemon exiting with code " << returnCode);
 }
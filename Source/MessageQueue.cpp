@@ -0,0 +1,347 @@
+#include "MessageQueue.h"
+#include "KeyStats.h"
+#include <chrono>
+
+// Fraction of the queue that may be filled before the dropRepeats policy
+// starts discarding key repeat messages, as a shift of the queue capacity:
+static const constexpr size_t repeatReserveShift = 2;
+static const constexpr size_t repeatLimit
+        = KeyDaemon::MessageQueue::capacity
+        - (KeyDaemon::MessageQueue::capacity >> repeatReserveShift);
+
+// Maximum time in milliseconds a producer sleeps before checking the queue
+// again, under the block policy:
+static const constexpr int spaceWaitTimeoutMS = 10;
+
+
+// Prepares an empty queue on construction.
+KeyDaemon::MessageQueue::MessageQueue(const OverflowPolicy policy) :
+policy(policy), pushState(0), popPosition(0), peakDepth(0), dropCount(0),
+closed(false), consumerWaiting(false), producersWaiting(0)
+{
+    for (size_t i = 0; i < capacity; i++)
+    {
+        cells[i].position.store(i, std::memory_order_relaxed);
+    }
+}
+
+
+// Adds a message to the end of the queue, applying the overflow policy if the
+// queue is full.
+bool KeyDaemon::MessageQueue::push(const KeyMessage& message)
+{
+    return push(&message, 1) == 1;
+}
+
+
+// Adds several messages to the end of the queue at once, applying the overflow
+// policy if the queue can't hold them.
+int KeyDaemon::MessageQueue::push(const KeyMessage* messages, const int count)
+{
+    int pushedCount = 0;
+    int runStart = 0;
+    // Repeats dropped since the last run, skipped by the next run's sequence
+    // numbers:
+    unsigned int skipped = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (isDroppedRepeat(messages[i]))
+        {
+            if (i > runStart)
+            {
+                pushedCount += pushRun(messages + runStart, i - runStart,
+                        skipped);
+                skipped = 0;
+            }
+            runStart = i + 1;
+            skipped++;
+            dropCount.fetch_add(1, std::memory_order_relaxed);
+            STAT_INC(queueDrops);
+        }
+        else if (i + 1 == count || i + 1 - runStart == maxBatchSize)
+        {
+            pushedCount += pushRun(messages + runStart, i + 1 - runStart,
+                    skipped);
+            skipped = 0;
+            runStart = i + 1;
+        }
+    }
+    if (skipped > 0)
+    {
+        // No message followed the dropped repeats, so their sequence numbers
+        // are reserved on their own:
+        pushState.fetch_add(uint64_t(skipped) << positionBits,
+                std::memory_order_relaxed);
+    }
+    if (pushedCount > 0)
+    {
+        wakeConsumer();
+    }
+    return pushedCount;
+}
+
+
+// Removes the oldest message from the queue, if any.
+bool KeyDaemon::MessageQueue::pop(KeyMessage& message)
+{
+    if (! tryPop(message))
+    {
+        return false;
+    }
+    wakeProducers();
+    return true;
+}
+
+
+// Blocks the writer thread until messages are available, the queue is closed,
+// or the timeout period ends.
+void KeyDaemon::MessageQueue::waitForMessages(const int timeoutMS)
+{
+    consumerWaiting.store(true);
+    // Producers check consumerWaiting after pushing, so either they will see
+    // the flag or this will see their message:
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::unique_lock<std::mutex> lock(waitLock);
+    const auto canWake = [this]() { return getDepth() > 0 || isClosed(); };
+    if (timeoutMS < 0)
+    {
+        messagesAvailable.wait(lock, canWake);
+    }
+    else
+    {
+        messagesAvailable.wait_for(lock,
+                std::chrono::milliseconds(timeoutMS), canWake);
+    }
+    consumerWaiting.store(false, std::memory_order_relaxed);
+}
+
+
+// Closes the queue, rejecting new messages and waking all waiting threads.
+void KeyDaemon::MessageQueue::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(waitLock);
+        closed = true;
+    }
+    messagesAvailable.notify_all();
+    spaceAvailable.notify_all();
+}
+
+
+// Checks if the queue has been closed.
+bool KeyDaemon::MessageQueue::isClosed() const
+{
+    return closed.load(std::memory_order_relaxed);
+}
+
+
+// Gets the approximate number of queued messages.
+size_t KeyDaemon::MessageQueue::getDepth() const
+{
+    const size_t popped = popPosition.load(std::memory_order_relaxed);
+    const size_t pushed = static_cast<size_t>(
+            pushState.load(std::memory_order_relaxed) & positionMask);
+    // Positions are read separately, so the pop position may have passed the
+    // push position that was read:
+    return (pushed > popped) ? (pushed - popped) : 0;
+}
+
+
+// Gets the largest number of messages held in the queue at once.
+size_t KeyDaemon::MessageQueue::getPeakDepth() const
+{
+    return peakDepth.load(std::memory_order_relaxed);
+}
+
+
+// Gets the number of messages discarded by the overflow policy or rejected
+// because the queue was closed.
+unsigned long KeyDaemon::MessageQueue::getDropCount() const
+{
+    return dropCount.load(std::memory_order_relaxed);
+}
+
+
+// Checks if the overflow policy drops a message before it is queued.
+bool KeyDaemon::MessageQueue::isDroppedRepeat(const KeyMessage& message) const
+{
+    return policy == OverflowPolicy::dropRepeats
+            && message.event == EventType::held
+            && getDepth() >= repeatLimit;
+}
+
+
+// Adds a run of messages at once, applying the overflow policy until the queue
+// has room for all of them.
+int KeyDaemon::MessageQueue::pushRun(const KeyMessage* messages,
+        const int count, const unsigned int skipped)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    while (! closed.load(std::memory_order_relaxed))
+    {
+        if (tryPush(messages, count, skipped))
+        {
+            return count;
+        }
+        if (policy == OverflowPolicy::block)
+        {
+            // Earlier runs from the same batch may be what fills the queue, so
+            // the writer must be awake to make room:
+            wakeConsumer();
+            STAT_INC(blockedPushes);
+            waitForSpace(count, spaceWaitTimeoutMS);
+            continue;
+        }
+        KeyMessage discarded;
+        if (tryPop(discarded))
+        {
+            dropCount.fetch_add(1, std::memory_order_relaxed);
+            STAT_INC(queueDrops);
+        }
+    }
+    dropCount.fetch_add(count, std::memory_order_relaxed);
+    STAT_ADD(queueDrops, count);
+    return 0;
+}
+
+
+// Adds a run of messages if the queue has room for all of them.
+bool KeyDaemon::MessageQueue::tryPush(const KeyMessage* messages,
+        const int count, const unsigned int skipped)
+{
+    uint64_t state = pushState.load(std::memory_order_relaxed);
+    size_t position;
+    while (true)
+    {
+        position = static_cast<size_t>(state & positionMask);
+        // Check every cell in the run, as producers discarding messages may
+        // release them out of order:
+        bool positionChanged = false;
+        for (int i = 0; i < count; i++)
+        {
+            const size_t cellPosition = cells[(position + i) & (capacity - 1)]
+                    .position.load(std::memory_order_acquire);
+            if (cellPosition < position + i)
+            {
+                // The cell still holds a message from the previous lap:
+                return false;
+            }
+            if (cellPosition > position + i)
+            {
+                positionChanged = true;
+                break;
+            }
+        }
+        if (positionChanged)
+        {
+            state = pushState.load(std::memory_order_relaxed);
+        }
+        else if (pushState.compare_exchange_weak(state, state + count
+                    + (uint64_t(skipped) << positionBits),
+                std::memory_order_relaxed))
+        {
+            break;
+        }
+    }
+    // Numbers for the skipped repeats come directly before the run:
+    const unsigned int sequence = static_cast<unsigned int>(
+            position + (state >> positionBits) + skipped);
+    for (int i = 0; i < count; i++)
+    {
+        Cell& cell = cells[(position + i) & (capacity - 1)];
+        cell.message = messages[i];
+        cell.message.sequence = sequence + static_cast<unsigned int>(i);
+    }
+    for (int i = count - 1; i >= 0; i--)
+    {
+        cells[(position + i) & (capacity - 1)].position.store(
+                position + i + 1, std::memory_order_release);
+    }
+    const size_t depth = position + count
+            - popPosition.load(std::memory_order_relaxed);
+    size_t peak = peakDepth.load(std::memory_order_relaxed);
+    while (depth > peak && depth <= capacity
+            && ! peakDepth.compare_exchange_weak(peak, depth,
+                    std::memory_order_relaxed)) { }
+    return true;
+}
+
+
+// Removes the oldest message if the queue isn't empty.
+bool KeyDaemon::MessageQueue::tryPop(KeyMessage& message)
+{
+    size_t position = popPosition.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true)
+    {
+        cell = &cells[position & (capacity - 1)];
+        const size_t cellPosition
+                = cell->position.load(std::memory_order_acquire);
+        if (cellPosition == position + 1)
+        {
+            if (popPosition.compare_exchange_weak(position, position + 1,
+                    std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (cellPosition < position + 1)
+        {
+            // No message has been pushed at this position yet:
+            return false;
+        }
+        else
+        {
+            position = popPosition.load(std::memory_order_relaxed);
+        }
+    }
+    message = cell->message;
+    cell->position.store(position + capacity, std::memory_order_release);
+    return true;
+}
+
+
+// Blocks a producer thread until the queue has room, the queue is closed, or
+// the timeout period ends.
+void KeyDaemon::MessageQueue::waitForSpace(const int count,
+        const int timeoutMS)
+{
+    producersWaiting.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    {
+        std::unique_lock<std::mutex> lock(waitLock);
+        spaceAvailable.wait_for(lock, std::chrono::milliseconds(timeoutMS),
+                [this, count]()
+                {
+                    return getDepth() + count <= capacity || isClosed();
+                });
+    }
+    producersWaiting.fetch_sub(1, std::memory_order_relaxed);
+}
+
+
+// Wakes the writer thread if it is waiting for messages.
+void KeyDaemon::MessageQueue::wakeConsumer()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (consumerWaiting.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(waitLock);
+        messagesAvailable.notify_one();
+    }
+}
+
+
+// Wakes producer threads waiting for space, if any.
+void KeyDaemon::MessageQueue::wakeProducers()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (producersWaiting.load(std::memory_order_relaxed) > 0)
+    {
+        std::lock_guard<std::mutex> lock(waitLock);
+        spaceAvailable.notify_all();
+    }
+}
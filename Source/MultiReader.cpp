@@ -0,0 +1,237 @@
+#include "MultiReader.h"
+#include "KDDebug.h"
+#include <unistd.h>
+#include <utility>
+
+#ifdef KD_DEBUG
+// Print the application and class name before all info/error messages:
+static const constexpr char* messagePrefix = "KeyDaemon: MultiReader::";
+#endif
+
+
+// Opens all event files on construction.
+KeyDaemon::MultiReader::MultiReader
+(const std::vector<std::string>& eventFilePaths,
+        const KeySetBuffer& trackedKeys, KeyReader::Listener* listener) :
+openFileCount(0),
+listener(listener)
+{
+    for (const std::string& path : eventFilePaths)
+    {
+        KeyReader* reader = new KeyReader(path.c_str(), trackedKeys, listener,
+                false);
+        const int fileDescriptor = reader->openFile();
+        if (fileDescriptor <= 0)
+        {
+            delete reader;
+            continue;
+        }
+        readers.push_back(reader);
+        fileDescriptors.push_back(fileDescriptor);
+        openFileCount++;
+    }
+    DBG_V(messagePrefix << __func__ << ": Opened " << openFileCount
+            << " of " << eventFilePaths.size() << " event files.");
+}
+
+
+// Closes all event files on destruction.
+KeyDaemon::MultiReader::~MultiReader()
+{
+    for (size_t i = 0; i < readers.size(); i++)
+    {
+        if (fileDescriptors[i] >= 0)
+        {
+            close(fileDescriptors[i]);
+        }
+        delete readers[i];
+    }
+    readers.clear();
+    fileDescriptors.clear();
+}
+
+
+// Gets the number of event files that are still open for reading.
+int KeyDaemon::MultiReader::getOpenFileCount() const
+{
+    return openFileCount;
+}
+
+
+// Updates the kernel event masks of all open event files after the tracked key
+// set is replaced.
+void KeyDaemon::MultiReader::updateEventMasks()
+{
+    for (KeyReader* reader : readers)
+    {
+        reader->updateEventMask();
+    }
+}
+
+
+// Starts the read thread, if any event files were opened.
+void KeyDaemon::MultiReader::startThread()
+{
+    if (openFileCount > 0 && ! readThread.joinable())
+    {
+        readThread = std::thread(&MultiReader::readLoop, this);
+    }
+}
+
+
+// Signals the read thread to exit, and waits for it to finish.
+void KeyDaemon::MultiReader::stopThread()
+{
+    if (readThread.joinable())
+    {
+        signalStop();
+        readThread.join();
+    }
+}
+
+
+// Gets the number of event files the MultiReader opened, including files that
+// have since been closed.
+size_t KeyDaemon::MultiReader::getFileCount() const
+{
+    return fileDescriptors.size();
+}
+
+
+// Gets the descriptor of an event file.
+int KeyDaemon::MultiReader::getFileDescriptor(const size_t fileIndex) const
+{
+    return fileDescriptors[fileIndex];
+}
+
+
+// Gets the buffer where input from an event file should be read.
+void* KeyDaemon::MultiReader::getBuffer(const size_t fileIndex)
+{
+    return readers[fileIndex]->getBuffer();
+}
+
+
+// Gets the size in bytes of each event file input buffer.
+int KeyDaemon::MultiReader::getBufferSize() const
+{
+    return KeyReader::eventBufSize * sizeof(struct input_event);
+}
+
+
+// Passes new input from an event file to its KeyReader.
+void KeyDaemon::MultiReader::processInput
+(const size_t fileIndex, const int inputBytes)
+{
+    readers[fileIndex]->processInput(inputBytes);
+}
+
+
+// Passes new input from several event files to their KeyReaders, merging
+// their events in kernel timestamp order.
+void KeyDaemon::MultiReader::processInputs(PendingInput* inputs,
+        const int count)
+{
+    if (count == 1)
+    {
+        processInput(inputs[0].fileIndex, inputs[0].inputBytes);
+        return;
+    }
+    auto eventCount = [](const PendingInput& input)
+    {
+        return static_cast<int>(input.inputBytes
+                / sizeof(struct input_event));
+    };
+    auto eventTime = [this](const PendingInput& input, const int eventIndex)
+    {
+        const struct input_event& event
+                = readers[input.fileIndex]->eventBuffer[eventIndex];
+        return std::make_pair(event.input_event_sec, event.input_event_usec);
+    };
+    for (int i = 0; i < count; i++)
+    {
+        inputs[i].nextEvent = 0;
+    }
+    while (true)
+    {
+        // Find the input with the earliest unprocessed event, and the input
+        // with the next earliest, breaking ties in array order:
+        int first = -1;
+        int second = -1;
+        for (int i = 0; i < count; i++)
+        {
+            if (inputs[i].nextEvent >= eventCount(inputs[i]))
+            {
+                continue;
+            }
+            const auto time = eventTime(inputs[i], inputs[i].nextEvent);
+            if (first < 0 || time < eventTime(inputs[first],
+                        inputs[first].nextEvent))
+            {
+                second = first;
+                first = i;
+            }
+            else if (second < 0 || time < eventTime(inputs[second],
+                        inputs[second].nextEvent))
+            {
+                second = i;
+            }
+        }
+        if (first < 0)
+        {
+            return;
+        }
+        // Pass on complete reports from the earliest input until it reaches
+        // one that starts after the other input's next event. Every event in
+        // a report shares the same timestamp:
+        PendingInput& input = inputs[first];
+        const struct input_event* events
+                = readers[input.fileIndex]->eventBuffer;
+        const int endLimit = eventCount(input);
+        int endIndex = input.nextEvent;
+        while (endIndex < endLimit)
+        {
+            while (endIndex < endLimit && (events[endIndex].type != EV_SYN
+                        || events[endIndex].code != SYN_REPORT))
+            {
+                endIndex++;
+            }
+            if (endIndex < endLimit)
+            {
+                endIndex++;
+            }
+            if (second >= 0 && endIndex < endLimit
+                    && eventTime(input, endIndex) > eventTime(inputs[second],
+                        inputs[second].nextEvent))
+            {
+                break;
+            }
+        }
+        readers[input.fileIndex]->processEventRange(input.nextEvent,
+                endIndex);
+        input.nextEvent = endIndex;
+    }
+}
+
+
+// Closes an event file after it is removed or encounters an error, and
+// notifies the listener that the file was closed.
+void KeyDaemon::MultiReader::closeFile(const size_t fileIndex)
+{
+    int& fileDescriptor = fileDescriptors[fileIndex];
+    if (fileDescriptor < 0)
+    {
+        return;
+    }
+    readers[fileIndex]->eventFileDescriptor = -1;
+    close(fileDescriptor);
+    fileDescriptor = -1;
+    openFileCount--;
+    DBG(messagePrefix << __func__ << ": Closed \""
+            << readers[fileIndex]->getPath() << "\", " << openFileCount
+            << " event files remaining.");
+    if (listener != nullptr)
+    {
+        listener->readerStopped();
+    }
+}
@@ -0,0 +1,111 @@
+#include "RepeatThrottle.h"
+#include "KDDebug.h"
+#include <ctime>
+
+#ifdef KD_DEBUG
+static const constexpr char* messagePrefix = "KeyDaemon::RepeatThrottle::";
+#endif
+
+
+// Saves the repeat policy on construction.
+KeyDaemon::RepeatThrottle::RepeatThrottle(const RepeatPolicy policy,
+        const unsigned int rateHz) : policy(policy)
+{
+    if (policy == RepeatPolicy::rateLimit)
+    {
+        if (rateHz == 0 || rateHz > maxRateHz)
+        {
+            DBG(messagePrefix << __func__ << ": Invalid repeat rate " << rateHz
+                    << ", sending all repeats.");
+            this->policy = RepeatPolicy::passThrough;
+            return;
+        }
+        intervalUS = 1000000 / rateHz;
+    }
+    DBG_V(messagePrefix << __func__ << ": Using repeat policy "
+            << static_cast<int>(this->policy) << ".");
+}
+
+
+// Checks if key events need to pass through the RepeatThrottle.
+bool KeyDaemon::RepeatThrottle::isActive() const
+{
+    return policy != RepeatPolicy::passThrough;
+}
+
+
+// Applies the repeat policy to a key event that would otherwise be sent to
+// the parent.
+int KeyDaemon::RepeatThrottle::process(const KeyMessage& message,
+        KeyMessage* output)
+{
+    const unsigned int keyCode = static_cast<unsigned int>(message.keyCode);
+    if (policy == RepeatPolicy::passThrough || keyCode >= KEY_CNT)
+    {
+        output[0] = message;
+        return 1;
+    }
+    if (message.event == EventType::pressed)
+    {
+        repeatCounts[keyCode] = 0;
+        lastRepeatTimes[keyCode] = 0;
+        output[0] = message;
+        return 1;
+    }
+    if (message.event == EventType::released)
+    {
+        int outputCount = 0;
+        if (policy == RepeatPolicy::collapse && repeatCounts[keyCode] > 0)
+        {
+            KeyMessage& countMessage = output[outputCount++];
+            countMessage.keyCode = (repeatCounts[keyCode] > maxRepeatCount)
+                    ? maxRepeatCount : repeatCounts[keyCode];
+            countMessage.event = EventType::released;
+            countMessage.timestamp = message.timestamp;
+            countMessage.kind = MessageKind::repeatCount;
+        }
+        repeatCounts[keyCode] = 0;
+        output[outputCount++] = message;
+        return outputCount;
+    }
+    bool sendRepeat = false;
+    if (policy == RepeatPolicy::collapse)
+    {
+        sendRepeat = (repeatCounts[keyCode] == 0);
+        if (repeatCounts[keyCode] < UINT32_MAX)
+        {
+            repeatCounts[keyCode]++;
+        }
+    }
+    else if (policy == RepeatPolicy::rateLimit)
+    {
+        uint64_t repeatTime = message.timestamp;
+        if (repeatTime == 0)
+        {
+            struct timespec currentTime;
+            clock_gettime(CLOCK_MONOTONIC, &currentTime);
+            repeatTime = static_cast<uint64_t>(currentTime.tv_sec) * 1000000
+                    + currentTime.tv_nsec / 1000;
+        }
+        sendRepeat = (lastRepeatTimes[keyCode] == 0
+                || repeatTime >= lastRepeatTimes[keyCode] + intervalUS);
+        if (sendRepeat)
+        {
+            lastRepeatTimes[keyCode] = repeatTime;
+        }
+    }
+    if (! sendRepeat)
+    {
+        suppressedCount++;
+        return 0;
+    }
+    output[0] = message;
+    return 1;
+}
+
+
+// Gets the total number of repeat events the policy has kept from the parent.
+unsigned long KeyDaemon::RepeatThrottle::getSuppressedCount() const
+{
+    return suppressedCount;
+}
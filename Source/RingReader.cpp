@@ -0,0 +1,122 @@
+#include "RingReader.h"
+#include "SharedFile.h"
+#include "KDDebug.h"
+#include <unistd.h>
+#include <algorithm>
+#include <new>
+
+#ifdef KD_DEBUG
+static const constexpr char* messagePrefix = "KeyDaemon::RingReader::";
+#endif
+
+// Maximum time in milliseconds to sleep while waiting for messages, so the
+// read thread periodically checks if it should stop:
+static const constexpr int waitTimeoutMS = 100;
+
+
+// Saves the ring file path on construction.
+KeyDaemon::RingReader::RingReader(const char* ringPath) :
+ringPath(ringPath), reading(false) { }
+
+
+// Stops reading, unmaps the ring, and removes the ring file on destruction.
+KeyDaemon::RingReader::~RingReader()
+{
+    stop();
+    unlink(ringPath.c_str());
+}
+
+
+// Creates a new, empty ring file with owner-only permissions, replacing any
+// existing ring file, and starts reading messages from it.
+bool KeyDaemon::RingReader::start(DaemonFramework::Pipe::Listener* listener)
+{
+    stop();
+    void* mapping = SharedFile::create(ringPath.c_str(), KeyRing::fileSize);
+    if (mapping == nullptr)
+    {
+        return false;
+    }
+    header = new (mapping) KeyRing::Header;
+    header->version = KeyRing::version;
+    header->capacity = KeyRing::capacity;
+    header->messageSize = KeyWireFormat::messageSize;
+    header->writeIndex.store(0, std::memory_order_relaxed);
+    header->readIndex.store(0, std::memory_order_relaxed);
+    header->consumerWaiting.store(0, std::memory_order_relaxed);
+    header->producerWaiting.store(0, std::memory_order_relaxed);
+    header->magic = KeyRing::magic;
+    ringData = static_cast<unsigned char*>(mapping) + KeyRing::dataOffset;
+    this->listener = listener;
+    reading = true;
+    readThread = std::thread(&RingReader::readLoop, this);
+    DBG_V(messagePrefix << __func__ << ": Reading from ring file \""
+            << ringPath << "\"");
+    return true;
+}
+
+
+// Stops the read thread, if it is running, and unmaps the ring.
+void KeyDaemon::RingReader::stop()
+{
+    reading = false;
+    if (readThread.joinable())
+    {
+        KeyRing::futexWake(&header->writeIndex);
+        readThread.join();
+    }
+    SharedFile::unmap(header, KeyRing::fileSize);
+    header = nullptr;
+    ringData = nullptr;
+}
+
+
+// Passes new messages to the listener, sleeping whenever the ring is empty,
+// until the RingReader is stopped.
+void KeyDaemon::RingReader::readLoop()
+{
+    using KeyWireFormat::messageSize;
+    while (reading)
+    {
+        const uint32_t readIndex
+                = header->readIndex.load(std::memory_order_relaxed);
+        uint32_t writeIndex
+                = header->writeIndex.load(std::memory_order_acquire);
+        if (writeIndex == readIndex)
+        {
+            header->consumerWaiting.store(1, std::memory_order_relaxed);
+            // The producer updates writeIndex before checking
+            // consumerWaiting, so one of the two sides always sees the
+            // other's update:
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            writeIndex = header->writeIndex.load(std::memory_order_relaxed);
+            if (writeIndex == readIndex && reading)
+            {
+                KeyRing::futexWait(&header->writeIndex, readIndex,
+                        waitTimeoutMS);
+            }
+            header->consumerWaiting.store(0, std::memory_order_relaxed);
+            continue;
+        }
+        // Deliver messages up to the end of the ring. Any wrapped messages are
+        // delivered on the next loop.
+        const uint32_t startSlot = readIndex & (KeyRing::capacity - 1);
+        const uint32_t messageCount = std::min(writeIndex - readIndex,
+                KeyRing::capacity - startSlot);
+        if (listener != nullptr)
+        {
+            listener->processData(ringData + (startSlot * messageSize),
+                    messageCount * messageSize);
+        }
+        header->readIndex.store(readIndex + messageCount,
+                std::memory_order_release);
+        // Wake the producer if it's waiting for room in a full ring, clearing
+        // the flag so it is only woken once each time it sleeps:
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (header->producerWaiting.load(std::memory_order_relaxed) != 0
+                && header->producerWaiting.exchange(0) != 0)
+        {
+            KeyRing::futexWake(&header->readIndex);
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#include "RingWriter.h"
+#include "SharedFile.h"
+#include "KDDebug.h"
+#include <cstring>
+#include <algorithm>
+
+#ifdef KD_DEBUG
+// Print the application and class name before all info/error messages:
+static const constexpr char* messagePrefix = "KeyDaemon: RingWriter::";
+#endif
+
+
+// Opens and maps the ring file on construction.
+KeyDaemon::RingWriter::RingWriter(const char* ringPath)
+{
+    void* mapping = SharedFile::open(ringPath, KeyRing::fileSize);
+    if (mapping == nullptr)
+    {
+        return;
+    }
+    KeyRing::Header* ringHeader = static_cast<KeyRing::Header*>(mapping);
+    if (ringHeader->magic != KeyRing::magic
+            || ringHeader->version != KeyRing::version
+            || ringHeader->capacity != KeyRing::capacity
+            || ringHeader->messageSize != KeyWireFormat::messageSize)
+    {
+        DBG(messagePrefix << __func__ << ": Ring file \"" << ringPath
+                << "\" has an unexpected layout.");
+        SharedFile::unmap(mapping, KeyRing::fileSize);
+        return;
+    }
+    header = ringHeader;
+    ringData = static_cast<unsigned char*>(mapping) + KeyRing::dataOffset;
+    DBG_V(messagePrefix << __func__ << ": Mapped ring file \"" << ringPath
+            << "\"");
+}
+
+
+// Unmaps the ring file on destruction.
+KeyDaemon::RingWriter::~RingWriter()
+{
+    SharedFile::unmap(header, KeyRing::fileSize);
+    header = nullptr;
+}
+
+
+// Checks if the ring file was successfully opened and mapped.
+bool KeyDaemon::RingWriter::isOpen() const
+{
+    return header != nullptr;
+}
+
+
+// Copies encoded messages into the ring, waking the parent if it is waiting
+// for new messages.
+bool KeyDaemon::RingWriter::write
+(const unsigned char* messageData, const int messageCount)
+{
+    using KeyWireFormat::messageSize;
+    if (header == nullptr)
+    {
+        return false;
+    }
+    const uint32_t writeIndex
+            = header->writeIndex.load(std::memory_order_relaxed);
+    const uint32_t readIndex
+            = header->readIndex.load(std::memory_order_acquire);
+    if ((writeIndex - readIndex) + messageCount > KeyRing::capacity)
+    {
+        return false;
+    }
+    // Copy messages in up to two parts, in case they wrap around the end of
+    // the ring:
+    const uint32_t startSlot = writeIndex & (KeyRing::capacity - 1);
+    const uint32_t firstCount = std::min<uint32_t>(messageCount,
+            KeyRing::capacity - startSlot);
+    std::memcpy(ringData + (startSlot * messageSize), messageData,
+            firstCount * messageSize);
+    std::memcpy(ringData, messageData + (firstCount * messageSize),
+            (messageCount - firstCount) * messageSize);
+    header->writeIndex.store(writeIndex + messageCount,
+            std::memory_order_release);
+    // The consumer sets consumerWaiting before checking writeIndex, so one
+    // of the two sides always sees the other's update. Clearing the flag
+    // ensures the consumer is only woken once each time it sleeps:
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (header->consumerWaiting.load(std::memory_order_relaxed) != 0
+            && header->consumerWaiting.exchange(0) != 0)
+    {
+        KeyRing::futexWake(&header->writeIndex);
+    }
+    return true;
+}
+
+
+// Sleeps until the parent has read enough messages to make room in the ring,
+// or until a timeout expires.
+void KeyDaemon::RingWriter::waitForSpace
+(const int messageCount, const int timeoutMS)
+{
+    if (header == nullptr)
+    {
+        return;
+    }
+    const uint32_t writeIndex
+            = header->writeIndex.load(std::memory_order_relaxed);
+    const uint32_t readIndex
+            = header->readIndex.load(std::memory_order_acquire);
+    if ((writeIndex - readIndex) + messageCount <= KeyRing::capacity)
+    {
+        return;
+    }
+    header->producerWaiting.store(1, std::memory_order_relaxed);
+    // The consumer updates readIndex before checking producerWaiting, so one
+    // of the two sides always sees the other's update:
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (header->readIndex.load(std::memory_order_relaxed) == readIndex)
+    {
+        KeyRing::futexWait(&header->readIndex, readIndex, timeoutMS);
+    }
+    header->producerWaiting.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,182 @@
+#include "SequenceMatcher.h"
+#include "KDDebug.h"
+#include <ctime>
+
+#ifdef KD_DEBUG
+static const constexpr char* messagePrefix = "KeyDaemon::SequenceMatcher::";
+#endif
+
+// Marks trie transitions that haven't been filled in yet:
+static const constexpr uint16_t noState = UINT16_MAX;
+
+
+// Compiles registered sequences into the matcher's transition table on
+// construction.
+KeyDaemon::SequenceMatcher::SequenceMatcher
+(const std::vector<std::vector<int>>& sequences, const unsigned int timeoutMS) :
+timeoutUS(static_cast<uint64_t>(timeoutMS) * 1000)
+{
+    std::vector<int> validIndices;
+    for (size_t i = 0; i < sequences.size(); i++)
+    {
+        if (i >= maxSequences || ! isValidSequence(sequences[i]))
+        {
+            DBG(messagePrefix << __func__ << ": Ignoring invalid sequence "
+                    << i);
+            continue;
+        }
+        validIndices.push_back(static_cast<int>(i));
+        for (const int keyCode : sequences[i])
+        {
+            if (keySymbols[keyCode] == otherKeySymbol)
+            {
+                keySymbols[keyCode] = static_cast<uint16_t>(symbolCount++);
+            }
+        }
+    }
+    if (validIndices.empty())
+    {
+        return;
+    }
+
+    // Build the trie of registered sequences:
+    transitions.assign(symbolCount, noState);
+    completedSequences.assign(1, -1);
+    for (const int index : validIndices)
+    {
+        uint16_t trieState = 0;
+        for (const int keyCode : sequences[index])
+        {
+            const size_t transition = (trieState * symbolCount)
+                    + keySymbols[keyCode];
+            if (transitions[transition] == noState)
+            {
+                transitions[transition] = static_cast<uint16_t>
+                        (completedSequences.size());
+                transitions.resize(transitions.size() + symbolCount,
+                        noState);
+                completedSequences.push_back(-1);
+            }
+            trieState = transitions[transition];
+        }
+        // If the same sequence is registered twice, the first one is used:
+        if (completedSequences[trieState] == -1)
+        {
+            completedSequences[trieState] = static_cast<int8_t>(index);
+        }
+    }
+
+    // Visit states in breadth-first order, so each state's fallback state is
+    // complete before the state itself is. A state's fallback is the state
+    // reached by the longest suffix of its key presses that is also a prefix
+    // of some sequence:
+    const size_t stateCount = completedSequences.size();
+    std::vector<uint16_t> fallbacks(stateCount, 0);
+    std::vector<uint16_t> stateQueue;
+    stateQueue.reserve(stateCount);
+    stateQueue.push_back(0);
+    for (size_t queueIndex = 0; queueIndex < stateQueue.size(); queueIndex++)
+    {
+        const uint16_t current = stateQueue[queueIndex];
+        const uint16_t fallback = fallbacks[current];
+        for (int symbol = 0; symbol < symbolCount; symbol++)
+        {
+            uint16_t& next = transitions[(current * symbolCount) + symbol];
+            const uint16_t fallbackNext = (current == 0) ? 0
+                    : transitions[(fallback * symbolCount) + symbol];
+            if (next == noState)
+            {
+                next = fallbackNext;
+                continue;
+            }
+            fallbacks[next] = fallbackNext;
+            // Complete sequences that end with the state's key presses:
+            if (completedSequences[next] == -1)
+            {
+                completedSequences[next] = completedSequences[fallbackNext];
+            }
+            stateQueue.push_back(next);
+        }
+    }
+    DBG_V(messagePrefix << __func__ << ": Compiled " << validIndices.size()
+            << " sequences into " << stateCount << " states over "
+            << symbolCount << " input symbols.");
+}
+
+
+// Checks if a list of key codes can be registered as a sequence.
+bool KeyDaemon::SequenceMatcher::isValidSequence
+(const std::vector<int>& sequenceKeys)
+{
+    if (sequenceKeys.size() < 2 || sequenceKeys.size() > maxSequenceKeys)
+    {
+        return false;
+    }
+    for (const int keyCode : sequenceKeys)
+    {
+        if (keyCode <= KEY_RESERVED || keyCode >= KEY_CNT)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Checks if any sequences were registered.
+bool KeyDaemon::SequenceMatcher::hasSequences() const
+{
+    return ! transitions.empty();
+}
+
+
+// Gets the number of states in the compiled automaton.
+int KeyDaemon::SequenceMatcher::getStateCount() const
+{
+    return static_cast<int>(completedSequences.size());
+}
+
+
+// Advances the matcher with a new key event, and checks if it completed a
+// registered sequence.
+int KeyDaemon::SequenceMatcher::process(const KeyMessage& message,
+        KeyMessage* output)
+{
+    const unsigned int keyCode = static_cast<unsigned int>(message.keyCode);
+    if (message.event != EventType::pressed || keyCode >= KEY_CNT
+            || transitions.empty())
+    {
+        return 0;
+    }
+    if (timeoutUS > 0)
+    {
+        uint64_t pressTime = message.timestamp;
+        if (pressTime == 0)
+        {
+            struct timespec currentTime;
+            clock_gettime(CLOCK_MONOTONIC, &currentTime);
+            pressTime = static_cast<uint64_t>(currentTime.tv_sec) * 1000000
+                    + currentTime.tv_nsec / 1000;
+        }
+        if (state != 0 && pressTime > lastPressTime + timeoutUS)
+        {
+            DBG_V(messagePrefix << __func__
+                    << ": Sequence timed out, restarting.");
+            state = 0;
+        }
+        lastPressTime = pressTime;
+    }
+    state = transitions[(state * symbolCount) + keySymbols[keyCode]];
+    const int sequenceIndex = completedSequences[state];
+    if (sequenceIndex < 0)
+    {
+        return 0;
+    }
+    state = 0;
+    KeyMessage& sequenceMessage = output[0];
+    sequenceMessage.keyCode = sequenceIndex;
+    sequenceMessage.event = EventType::pressed;
+    sequenceMessage.timestamp = message.timestamp;
+    sequenceMessage.kind = MessageKind::sequence;
+    return 1;
+}
@@ -0,0 +1,90 @@
+#include "SharedFile.h"
+#include "KDDebug.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef KD_DEBUG
+static const constexpr char* messagePrefix = "KeyDaemon::SharedFile::";
+#endif
+
+
+// Creates a new zero-filled file with owner-only permissions, replacing any
+// existing file at the same path, and maps it into memory for reading and
+// writing.
+void* KeyDaemon::SharedFile::create(const char* path, const size_t size)
+{
+    // Never reuse an existing file, as it may not have been created by this
+    // user or with the correct permissions:
+    unlink(path);
+    const int fileDescriptor = ::open(path,
+            O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+            S_IRUSR | S_IWUSR);
+    if (fileDescriptor < 0)
+    {
+        DBG(messagePrefix << __func__ << ": Failed to create \"" << path
+                << "\"");
+        return nullptr;
+    }
+    void* mapping = MAP_FAILED;
+    if (ftruncate(fileDescriptor, size) == 0)
+    {
+        mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                fileDescriptor, 0);
+    }
+    close(fileDescriptor);
+    if (mapping == MAP_FAILED)
+    {
+        DBG(messagePrefix << __func__ << ": Failed to map \"" << path
+                << "\"");
+        unlink(path);
+        return nullptr;
+    }
+    return mapping;
+}
+
+
+// Maps an existing shared file into memory for reading and writing, if it is
+// safe to use.
+void* KeyDaemon::SharedFile::open(const char* path, const size_t size)
+{
+    const int fileDescriptor = ::open(path, O_RDWR | O_NOFOLLOW | O_CLOEXEC);
+    if (fileDescriptor < 0)
+    {
+        DBG(messagePrefix << __func__ << ": Failed to open \"" << path
+                << "\"");
+        return nullptr;
+    }
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat) != 0 || ! S_ISREG(fileStat.st_mode)
+            || fileStat.st_uid != getuid()
+            || (fileStat.st_mode & (S_IRWXG | S_IRWXO)) != 0
+            || fileStat.st_size < (off_t) size)
+    {
+        DBG(messagePrefix << __func__ << ": \"" << path
+                << "\" has an invalid type, size, owner, or permissions.");
+        close(fileDescriptor);
+        return nullptr;
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+            fileDescriptor, 0);
+    close(fileDescriptor);
+    if (mapping == MAP_FAILED)
+    {
+        DBG(messagePrefix << __func__ << ": Failed to map \"" << path
+                << "\"");
+        return nullptr;
+    }
+    return mapping;
+}
+
+
+// Unmaps shared file data.
+void KeyDaemon::SharedFile::unmap(void* data, const size_t size)
+{
+    if (data != nullptr)
+    {
+        munmap(data, size);
+    }
+}
@@ -0,0 +1,292 @@
+#include "UringReader.h"
+#include "KDDebug.h"
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+
+#ifdef KD_DEBUG
+// Print the application and class name before all info/error messages:
+static const constexpr char* messagePrefix = "KeyDaemon: UringReader::";
+#endif
+
+// Request ID used to identify the shutdown event file read:
+static const constexpr unsigned long long stopRequestID = ~0ULL;
+
+
+// io_uring system call wrappers, as glibc does not provide them:
+static int ioUringSetup(const unsigned int entries,
+        struct io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int ioUringEnter(const int ringFD, const unsigned int toSubmit,
+        const unsigned int minComplete, const unsigned int flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, ringFD, toSubmit,
+                minComplete, flags, nullptr, 0));
+}
+
+
+// Opens all event files, creates the io_uring instance, and starts the read
+// thread.
+KeyDaemon::UringReader::UringReader
+(const std::vector<std::string>& eventFilePaths,
+        const KeySetBuffer& trackedKeys, KeyReader::Listener* listener) :
+MultiReader(eventFilePaths, trackedKeys, listener)
+{
+    stopFD = eventfd(0, EFD_CLOEXEC);
+    if (stopFD < 0 || ! initRing(getFileCount() + 1))
+    {
+        DBG(messagePrefix << __func__
+                << ": io_uring is unavailable, closing event files.");
+        if (ringFD >= 0)
+        {
+            close(ringFD);
+            ringFD = -1;
+        }
+        for (size_t i = 0; i < getFileCount(); i++)
+        {
+            closeFile(i);
+        }
+        return;
+    }
+    fileBuffers.resize(getFileCount());
+    pendingInputs.reserve(getFileCount());
+    for (size_t i = 0; i < getFileCount(); i++)
+    {
+        fileBuffers[i].iov_base = getBuffer(i);
+        fileBuffers[i].iov_len = getBufferSize();
+        queueRead(getFileDescriptor(i), &fileBuffers[i], i);
+    }
+    stopBuffer.iov_base = &stopValue;
+    stopBuffer.iov_len = sizeof(stopValue);
+    queueRead(stopFD, &stopBuffer, stopRequestID);
+    startThread();
+}
+
+
+// Stops the read thread and releases the io_uring instance.
+KeyDaemon::UringReader::~UringReader()
+{
+    stopThread();
+    if (sqEntries != nullptr)
+    {
+        munmap(sqEntries, sqEntriesSize);
+    }
+    if (cqRing != nullptr && cqRing != sqRing)
+    {
+        munmap(cqRing, cqRingSize);
+    }
+    if (sqRing != nullptr)
+    {
+        munmap(sqRing, sqRingSize);
+    }
+    if (ringFD >= 0)
+    {
+        close(ringFD);
+    }
+    if (stopFD >= 0)
+    {
+        close(stopFD);
+    }
+}
+
+
+// Checks if the io_uring instance was successfully created.
+bool KeyDaemon::UringReader::isAvailable() const
+{
+    return ringFD >= 0;
+}
+
+
+// Checks if the kernel allows io_uring instances to be created, without
+// opening any event files.
+bool KeyDaemon::UringReader::isSupported()
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const int testFD = ioUringSetup(1, &params);
+    if (testFD < 0)
+    {
+        DBG(messagePrefix << __func__ << ": io_uring_setup failed, errno="
+                << errno);
+        return false;
+    }
+    close(testFD);
+    return true;
+}
+
+
+// Creates and maps the io_uring submission and completion queues.
+bool KeyDaemon::UringReader::initRing(const unsigned int entryCount)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ringFD = ioUringSetup(entryCount, &params);
+    if (ringFD < 0)
+    {
+        DBG(messagePrefix << __func__ << ": io_uring_setup failed, errno="
+                << errno);
+        return false;
+    }
+    sqRingSize = params.sq_off.array
+            + params.sq_entries * sizeof(unsigned int);
+    cqRingSize = params.cq_off.cqes
+            + params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap && cqRingSize > sqRingSize)
+    {
+        sqRingSize = cqRingSize;
+    }
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ringFD, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED)
+    {
+        sqRing = nullptr;
+        return false;
+    }
+    if (singleMap)
+    {
+        cqRing = sqRing;
+    }
+    else
+    {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ringFD, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED)
+        {
+            cqRing = nullptr;
+            return false;
+        }
+    }
+    sqEntriesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* entries = mmap(nullptr, sqEntriesSize, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ringFD, IORING_OFF_SQES);
+    if (entries == MAP_FAILED)
+    {
+        return false;
+    }
+    sqEntries = static_cast<struct io_uring_sqe*>(entries);
+
+    char* sqBytes = static_cast<char*>(sqRing);
+    sqHead = reinterpret_cast<unsigned int*>(sqBytes + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned int*>(sqBytes + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned int*>
+            (sqBytes + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned int*>(sqBytes + params.sq_off.array);
+    char* cqBytes = static_cast<char*>(cqRing);
+    cqHead = reinterpret_cast<unsigned int*>(cqBytes + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned int*>(cqBytes + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned int*>
+            (cqBytes + params.cq_off.ring_mask);
+    cqEntries = reinterpret_cast<struct io_uring_cqe*>
+            (cqBytes + params.cq_off.cqes);
+    DBG_V(messagePrefix << __func__ << ": Created io_uring with "
+            << params.sq_entries << " submission entries.");
+    return true;
+}
+
+
+// Submits queued reads and handles completed reads until the UringReader is
+// destroyed or all files are closed.
+void KeyDaemon::UringReader::readLoop()
+{
+    while (getOpenFileCount() > 0)
+    {
+        // Submit all re-queued reads and wait for new input in one call:
+        const int submitted = ioUringEnter(ringFD, pendingSubmissions, 1,
+                IORING_ENTER_GETEVENTS);
+        if (submitted < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+            {
+                continue;
+            }
+            DBG(messagePrefix << __func__ << ": io_uring_enter failed, errno="
+                    << errno);
+            return;
+        }
+        pendingSubmissions -= submitted;
+        // Handle every completed read before waiting again, processing input
+        // from different keyboards in timestamp order:
+        pendingInputs.clear();
+        unsigned int head = *cqHead;
+        const unsigned int tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        while (head != tail)
+        {
+            const struct io_uring_cqe& completion = cqEntries[head & *cqMask];
+            head++;
+            if (completion.user_data == stopRequestID)
+            {
+                DBG_V(messagePrefix << __func__
+                        << ": Received shutdown signal.");
+                __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+                return;
+            }
+            const size_t fileIndex = completion.user_data;
+            const int result = completion.res;
+            if (result > 0)
+            {
+                // The file's buffer is reused once its read is queued again:
+                pendingInputs.push_back({ fileIndex, result, 0 });
+                continue;
+            }
+            if (result != -EINTR && result != -EAGAIN)
+            {
+                DBG(messagePrefix << __func__ << ": Reading event file "
+                        << fileIndex << " stopped, result=" << result);
+                closeFile(fileIndex);
+                continue;
+            }
+            queueRead(getFileDescriptor(fileIndex), &fileBuffers[fileIndex],
+                    fileIndex);
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        processInputs(pendingInputs.data(),
+                static_cast<int>(pendingInputs.size()));
+        for (const PendingInput& input : pendingInputs)
+        {
+            queueRead(getFileDescriptor(input.fileIndex),
+                    &fileBuffers[input.fileIndex], input.fileIndex);
+        }
+    }
+    DBG(messagePrefix << __func__ << ": All event files closed.");
+}
+
+
+// Wakes the read thread so it can exit.
+void KeyDaemon::UringReader::signalStop()
+{
+    const unsigned long long signalValue = 1;
+    if (write(stopFD, &signalValue, sizeof(signalValue)) < 0)
+    {
+        DBG(messagePrefix << __func__
+                << ": Failed to signal read thread shutdown.");
+    }
+}
+
+
+// Adds a read request to the submission queue.
+void KeyDaemon::UringReader::queueRead(const int fileDescriptor,
+        struct iovec* buffer, const unsigned long long requestID)
+{
+    const unsigned int tail = *sqTail;
+    const unsigned int index = tail & *sqMask;
+    struct io_uring_sqe& entry = sqEntries[index];
+    memset(&entry, 0, sizeof(entry));
+    // IORING_OP_READV is used instead of IORING_OP_READ to support kernels
+    // older than 5.6:
+    entry.opcode = IORING_OP_READV;
+    entry.fd = fileDescriptor;
+    entry.addr = reinterpret_cast<unsigned long long>(buffer);
+    entry.len = 1;
+    entry.off = 0;
+    entry.user_data = requestID;
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    pendingSubmissions++;
+}
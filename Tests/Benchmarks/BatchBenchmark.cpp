@@ -0,0 +1,240 @@
+/**
+ * @file  BatchBenchmark.cpp
+ *
+ * @brief  Counts the pipe writes and parent wakeups needed to deliver a
+ *         replayed typing workload, comparing one write per key event against
+ *         one framed write per event file read.
+ *
+ *  A named pipe stands in for a keyboard event file, and a KeyReader reads
+ * from it exactly as it would read from a real event file. Each keystroke is
+ * replayed as a single write containing its press, any key repeats, and its
+ * release, along with the scan code and synchronization events a real keyboard
+ * sends, so the KeyReader finds all of a keystroke's tracked events in one
+ * read. A second thread stands in for the parent application, reading from
+ * the output pipe and counting each read that returns data as a wakeup.
+ *
+ * Usage: BatchBenchmark [keystrokeCount]
+ */
+
+#include "KeyReader.h"
+#include "KeySetBuffer.h"
+#include "KeyWireFormat.h"
+#include <linux/input.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace KeyDaemon::KeyWireFormat;
+
+// Number of keystrokes replayed by default:
+static const constexpr int defaultKeystrokeCount = 5000;
+
+// Sends key events to the output pipe, counting each write:
+class PipeListener : public KeyDaemon::KeyReader::Listener
+{
+public:
+    /**
+     * @param outputFD    The output pipe's write file descriptor.
+     *
+     * @param sendFrames  Whether tracked events from each read should be sent
+     *                    in framed writes, or sent one at a time.
+     */
+    PipeListener(const int outputFD, const bool sendFrames) :
+        outputFD(outputFD), sendFrames(sendFrames), writeCount(0) { }
+
+    virtual void keyEvent(const int keyCode, const KeyDaemon::EventType type,
+            const uint64_t timestamp) override
+    {
+        const KeyDaemon::KeyMessage message = { keyCode, type, timestamp };
+        sendMessages(&message, 1);
+    }
+
+    virtual void keyEvents(const KeyDaemon::KeyMessage* messages,
+            const int count) override
+    {
+        if (! sendFrames)
+        {
+            Listener::keyEvents(messages, count);
+            return;
+        }
+        // Send frames the same way KeyLoop::keyEvents does:
+        for (int sent = 0; sent < count; sent += maxFrameMessages)
+        {
+            sendMessages(messages + sent,
+                    std::min(count - sent, maxFrameMessages));
+        }
+    }
+
+    std::atomic<long> writeCount;
+
+private:
+    void sendMessages(const KeyDaemon::KeyMessage* messages, const int count)
+    {
+        unsigned char frame[maxFrameSize];
+        for (int i = 0; i < count; i++)
+        {
+            encode(messages[i], 0, frame + (i * messageSize));
+        }
+        if (write(outputFD, frame, count * messageSize) > 0)
+        {
+            writeCount++;
+        }
+    }
+
+    const int outputFD;
+    const bool sendFrames;
+};
+
+
+/**
+ * @brief  Generates one keystroke's worth of input events.
+ *
+ * @param keyCode      The key that is pressed.
+ *
+ * @param repeatCount  Number of key repeat events sent while the key is held.
+ *
+ * @return             The keystroke's input events.
+ */
+static std::vector<struct input_event> generateKeystroke(const int keyCode,
+        const int repeatCount)
+{
+    std::vector<struct input_event> events;
+    auto addReport = [&events, keyCode](const int value)
+    {
+        struct input_event event = {};
+        event.type = EV_MSC;
+        event.code = MSC_SCAN;
+        event.value = 0x70000 + keyCode;
+        events.push_back(event);
+        event.type = EV_KEY;
+        event.code = keyCode;
+        event.value = value;
+        events.push_back(event);
+        event.type = EV_SYN;
+        event.code = SYN_REPORT;
+        event.value = 0;
+        events.push_back(event);
+    };
+    addReport(1);
+    for (int i = 0; i < repeatCount; i++)
+    {
+        addReport(2);
+    }
+    addReport(0);
+    return events;
+}
+
+
+/**
+ * @brief  Replays the typing workload using one message delivery method, and
+ *         prints the results.
+ *
+ * @param fifoPath        Path to the stand-in event file.
+ *
+ * @param keystrokeCount  Number of keystrokes to replay.
+ *
+ * @param sendFrames      Whether tracked events are sent in framed writes.
+ */
+static void runBenchmark(const std::string& fifoPath,
+        const int keystrokeCount, const bool sendFrames)
+{
+    static const int typedKeys[] = { KEY_H, KEY_E, KEY_L, KEY_L, KEY_O,
+            KEY_SPACE, KEY_W, KEY_O, KEY_R, KEY_L, KEY_D, KEY_ENTER };
+    static const int typedKeyCount = sizeof(typedKeys) / sizeof(int);
+    std::vector<int> trackedCodes(typedKeys, typedKeys + typedKeyCount);
+    const KeyDaemon::KeySet trackedSet(trackedCodes);
+    const KeyDaemon::KeySetBuffer trackedKeys(trackedSet);
+
+    int outputPipe[2];
+    if (pipe(outputPipe) != 0)
+    {
+        std::cerr << "Failed to create output pipe\n";
+        return;
+    }
+    // Hold the event pipe open for writing, so the reader never sees end of
+    // file:
+    const int eventFD = open(fifoPath.c_str(), O_RDWR);
+    PipeListener listener(outputPipe[1], sendFrames);
+    KeyDaemon::KeyReader reader(fifoPath.c_str(), trackedKeys, &listener);
+
+    std::atomic<long> messagesReceived(0);
+    std::atomic<long> parentWakeups(0);
+    std::thread parentThread([&outputPipe, &messagesReceived, &parentWakeups]
+    {
+        unsigned char frame[maxFrameSize];
+        int bytesRead;
+        while ((bytesRead = read(outputPipe[0], frame, sizeof(frame))) > 0)
+        {
+            parentWakeups++;
+            messagesReceived += bytesRead / messageSize;
+        }
+    });
+
+    long messagesSent = 0;
+    for (int i = 0; i < keystrokeCount; i++)
+    {
+        // Most keys are tapped, but some are held long enough to repeat:
+        const int repeatCount = (i % 7 == 0) ? 3 : ((i % 3 == 0) ? 1 : 0);
+        const std::vector<struct input_event> keystroke = generateKeystroke(
+                typedKeys[i % typedKeyCount], repeatCount);
+        messagesSent += 2 + repeatCount;
+        const size_t writeSize = keystroke.size() * sizeof(struct input_event);
+        if (write(eventFD, keystroke.data(), writeSize) != (ssize_t) writeSize)
+        {
+            std::cerr << "Failed to write keystroke " << i << "\n";
+            break;
+        }
+        while (messagesReceived < messagesSent)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    reader.stopReading();
+    close(eventFD);
+    close(outputPipe[1]);
+    parentThread.join();
+    close(outputPipe[0]);
+    std::cout << (sendFrames ? "  framed:    " : "  per-event: ")
+            << "messages=" << messagesReceived
+            << " pipeWrites=" << listener.writeCount
+            << " parentWakeups=" << parentWakeups << "\n";
+}
+
+
+int main(int argc, char** argv)
+{
+    const int keystrokeCount = (argc > 1) ? std::atoi(argv[1])
+            : defaultKeystrokeCount;
+    if (keystrokeCount <= 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " [keystrokeCount]\n";
+        return 1;
+    }
+    char tempDir[] = "/tmp/kdBatchBenchXXXXXX";
+    if (mkdtemp(tempDir) == nullptr)
+    {
+        std::cerr << "Failed to create temporary directory\n";
+        return 1;
+    }
+    const std::string fifoPath = std::string(tempDir) + "/event0";
+    if (mkfifo(fifoPath.c_str(), 0600) != 0)
+    {
+        std::cerr << "Failed to create pipe " << fifoPath << "\n";
+        return 1;
+    }
+    std::cout << "Replaying " << keystrokeCount << " keystrokes:\n";
+    runBenchmark(fifoPath, keystrokeCount, false);
+    runBenchmark(fifoPath, keystrokeCount, true);
+    unlink(fifoPath.c_str());
+    rmdir(tempDir);
+    return 0;
+}
@@ -0,0 +1,260 @@
+/**
+ * @file  FilterBenchmark.cpp
+ *
+ * @brief  Measures how many input events per second can be read and filtered
+ *         during bursts of keyboard input, comparing the original 16-event
+ *         reads with per-event filtering against KD_EVENT_BUF_SIZE reads with
+ *         the KeyFilter batch pass.
+ *
+ *  Bursts are replayed through a pipe, so both methods pay for the read
+ * system calls needed to consume them. By default, bursts are generated to
+ * resemble a barcode scanner typing digits followed by Enter, with scan code
+ * and synchronization events around each key event. A file of raw input_event
+ * data recorded from a real event file (e.g. using
+ * `cat /dev/input/eventN > burst.bin`) may be replayed instead.
+ *
+ * Usage: FilterBenchmark [repeatCount] [recordedBurstFile]
+ */
+
+#include "KeyFilter.h"
+#include <linux/input.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cstdlib>
+
+using Clock = std::chrono::steady_clock;
+
+// Number of times the burst is replayed by default:
+static const constexpr int defaultRepeatCount = 2000;
+
+// Read size in events used before KD_EVENT_BUF_SIZE was added:
+static const constexpr int originalBufSize = 16;
+
+// Characters in each generated barcode burst:
+static const constexpr int barcodeLength = 48;
+
+// Maximum bytes written to the pipe at once, leaving room under the default
+// 64KiB pipe capacity:
+static const constexpr size_t maxPipeWrite = 60000;
+
+// Counts tracked events so filtering work can't be optimized away:
+static long trackedEventCount = 0;
+
+
+/**
+ * @brief  Generates a burst of events resembling barcode scanner input.
+ *
+ * @return  The list of generated input events.
+ */
+static std::vector<struct input_event> generateBurst()
+{
+    static const int digitCodes[] = { KEY_0, KEY_1, KEY_2, KEY_3, KEY_4,
+            KEY_5, KEY_6, KEY_7, KEY_8, KEY_9 };
+    std::vector<struct input_event> events;
+    auto addEvent = [&events](int type, int code, int value)
+    {
+        struct input_event event = {};
+        event.type = type;
+        event.code = code;
+        event.value = value;
+        events.push_back(event);
+    };
+    for (int i = 0; i <= barcodeLength; i++)
+    {
+        const int code = (i == barcodeLength) ? KEY_ENTER
+                : digitCodes[(i * 7) % 10];
+        for (const int value : { 1, 0 })
+        {
+            addEvent(EV_MSC, MSC_SCAN, 0x70000 + code);
+            addEvent(EV_KEY, code, value);
+            addEvent(EV_SYN, SYN_REPORT, 0);
+        }
+    }
+    return events;
+}
+
+
+/**
+ * @brief  Loads a burst of raw input events from a file.
+ *
+ * @param path  The path to a file of recorded input_event data.
+ *
+ * @return      The list of recorded events.
+ */
+static std::vector<struct input_event> loadBurst(const char* path)
+{
+    std::ifstream burstFile(path, std::ios::binary);
+    std::vector<struct input_event> events;
+    struct input_event event;
+    while (burstFile.read(reinterpret_cast<char*>(&event), sizeof(event)))
+    {
+        events.push_back(event);
+    }
+    return events;
+}
+
+
+/**
+ * @brief  Filters events one at a time, as KeyReader did before batch
+ *         filtering was added.
+ */
+static void filterScalar(const struct input_event* events,
+        const int eventCount, const std::vector<int>& trackedCodes,
+        const KeyDaemon::KeySet& trackedKeys)
+{
+    for (int i = 0; i < eventCount; i++)
+    {
+        if (events[i].type != EV_KEY || events[i].value < 0
+                || events[i].value
+                >= (int) KeyDaemon::EventType::trackedTypeCount)
+        {
+            continue;
+        }
+        if (std::binary_search(trackedCodes.begin(), trackedCodes.end(),
+                    events[i].code))
+        {
+            trackedEventCount++;
+        }
+    }
+}
+
+
+/**
+ * @brief  Filters events using the KeyFilter batch pass.
+ */
+static void filterBatch(const struct input_event* events,
+        const int eventCount, const std::vector<int>& trackedCodes,
+        const KeyDaemon::KeySet& trackedKeys)
+{
+    static unsigned short trackedIndices[KD_EVENT_BUF_SIZE];
+    const int trackedCount = KeyDaemon::KeyFilter::findTracked(events,
+            eventCount, trackedKeys, trackedIndices);
+    for (int i = 0; i < trackedCount; i++)
+    {
+        trackedEventCount += (events[trackedIndices[i]].code != 0);
+    }
+}
+
+
+/**
+ * @brief  Replays bursts through a pipe, reading and filtering them.
+ *
+ * @param burst        The events in one burst.
+ *
+ * @param repeatCount  The number of times to replay the burst.
+ *
+ * @param bufSize      The maximum number of events to read at once.
+ *
+ * @param filter       The filtering function to use.
+ *
+ * @param readCount    Used to return the number of read calls made.
+ *
+ * @return             The total time in seconds spent reading and filtering.
+ */
+template <typename FilterFunction>
+static double replayBursts(const std::vector<struct input_event>& burst,
+        const int repeatCount, const int bufSize, FilterFunction filter,
+        long& readCount)
+{
+    std::vector<int> trackedCodes = { KEY_0, KEY_1, KEY_2, KEY_3, KEY_4,
+            KEY_5, KEY_6, KEY_7, KEY_8, KEY_9, KEY_ENTER };
+    std::sort(trackedCodes.begin(), trackedCodes.end());
+    const KeyDaemon::KeySet trackedKeys(trackedCodes);
+    std::vector<struct input_event> buffer(bufSize);
+    int pipeFDs[2];
+    if (pipe(pipeFDs) != 0)
+    {
+        return 0;
+    }
+    const char* burstData = reinterpret_cast<const char*>(burst.data());
+    const size_t burstBytes = burst.size() * sizeof(struct input_event);
+    const size_t chunkBytes = std::min(burstBytes, (maxPipeWrite
+                / sizeof(struct input_event)) * sizeof(struct input_event));
+    Clock::duration readTime(0);
+    readCount = 0;
+    for (int repeat = 0; repeat < repeatCount; repeat++)
+    {
+        for (size_t offset = 0; offset < burstBytes; offset += chunkBytes)
+        {
+            const size_t writeSize = std::min(chunkBytes, burstBytes - offset);
+            if (write(pipeFDs[1], burstData + offset, writeSize)
+                    != (ssize_t) writeSize)
+            {
+                std::cerr << "Failed to write burst data.\n";
+                return 0;
+            }
+            const Clock::time_point startTime = Clock::now();
+            size_t bytesRead = 0;
+            while (bytesRead < writeSize)
+            {
+                const int inputBytes = read(pipeFDs[0], buffer.data(),
+                        bufSize * sizeof(struct input_event));
+                if (inputBytes <= 0)
+                {
+                    break;
+                }
+                readCount++;
+                bytesRead += inputBytes;
+                filter(buffer.data(), inputBytes / sizeof(struct input_event),
+                        trackedCodes, trackedKeys);
+            }
+            readTime += Clock::now() - startTime;
+        }
+    }
+    close(pipeFDs[0]);
+    close(pipeFDs[1]);
+    return std::chrono::duration<double>(readTime).count();
+}
+
+
+int main(int argc, char** argv)
+{
+    const int repeatCount = (argc > 1) ? std::atoi(argv[1])
+            : defaultRepeatCount;
+    if (repeatCount <= 0)
+    {
+        std::cerr << "Usage: " << argv[0]
+                << " [repeatCount] [recordedBurstFile]\n";
+        return 1;
+    }
+    const std::vector<struct input_event> burst = (argc > 2)
+            ? loadBurst(argv[2]) : generateBurst();
+    if (burst.empty())
+    {
+        std::cerr << "No input events to replay.\n";
+        return 1;
+    }
+    const double totalEvents = static_cast<double>(burst.size())
+            * repeatCount;
+    std::cout << "Replaying " << repeatCount << " bursts of " << burst.size()
+            << " events:\n";
+
+    long readCount;
+    trackedEventCount = 0;
+    const double scalarTime = replayBursts(burst, repeatCount,
+            originalBufSize, filterScalar, readCount);
+    const long scalarTracked = trackedEventCount;
+    std::cout << "  " << originalBufSize << "-event reads, scalar filter: "
+            << (totalEvents / scalarTime) << " events/s, " << readCount
+            << " reads\n";
+
+    trackedEventCount = 0;
+    const double batchTime = replayBursts(burst, repeatCount,
+            KD_EVENT_BUF_SIZE, filterBatch, readCount);
+    std::cout << "  " << KD_EVENT_BUF_SIZE << "-event reads, batch filter: "
+            << (totalEvents / batchTime) << " events/s, " << readCount
+            << " reads\n";
+    if (trackedEventCount != scalarTracked)
+    {
+        std::cerr << "Filter results differ: " << scalarTracked << " vs "
+                << trackedEventCount << "\n";
+        return 1;
+    }
+    std::cout << "  Speedup: " << (scalarTime / batchTime) << "x\n";
+    return 0;
+}
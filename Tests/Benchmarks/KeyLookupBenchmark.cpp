@@ -0,0 +1,116 @@
+/**
+ * @file  KeyLookupBenchmark.cpp
+ *
+ * @brief  Compares tracked key lookup speed using binary search over a sorted
+ *         key code list against lookup using a KeySet bitmap.
+ *
+ * Usage: KeyLookupBenchmark [lookupCount]
+ */
+
+#include "KeySet.h"
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+using Clock = std::chrono::steady_clock;
+
+// Number of key code lookups timed by default:
+static const constexpr int defaultLookupCount = 10000000;
+
+// Largest key code selected when choosing tracked keys and input events:
+static const constexpr int maxTestCode = 239;
+
+// Tracked key set sizes to compare:
+static const int keySetSizes[] = { 1, 3, 10, 30, 100, 239 };
+
+
+/**
+ * @brief  Times a lookup function over a list of input key codes.
+ *
+ * @param inputCodes  The key codes to look up.
+ *
+ * @param lookup      A function returning whether a key code is tracked.
+ *
+ * @param hitCount    Used to return the number of tracked codes found.
+ *
+ * @return            The average lookup time in nanoseconds.
+ */
+template <typename LookupFunction>
+static double timeLookups(const std::vector<unsigned short>& inputCodes,
+        LookupFunction lookup, long& hitCount)
+{
+    hitCount = 0;
+    const Clock::time_point startTime = Clock::now();
+    for (const unsigned short code : inputCodes)
+    {
+        hitCount += lookup(code) ? 1 : 0;
+    }
+    const Clock::time_point endTime = Clock::now();
+    return std::chrono::duration<double, std::nano>(endTime - startTime)
+            .count() / inputCodes.size();
+}
+
+
+int main(int argc, char** argv)
+{
+    const int lookupCount = (argc > 1) ? std::atoi(argv[1])
+            : defaultLookupCount;
+    if (lookupCount <= 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " [lookupCount]\n";
+        return 1;
+    }
+    std::mt19937 randomGen(239);
+    std::uniform_int_distribution<int> codeDistribution(1, maxTestCode);
+    std::vector<unsigned short> inputCodes(lookupCount);
+    for (unsigned short& code : inputCodes)
+    {
+        code = codeDistribution(randomGen);
+    }
+    std::vector<int> allCodes;
+    for (int i = 1; i <= maxTestCode; i++)
+    {
+        allCodes.push_back(i);
+    }
+
+    std::cout << "Timing " << lookupCount << " lookups per key set size:\n";
+    std::cout << std::setw(8) << "keys" << std::setw(16) << "binary ns"
+            << std::setw(16) << "bitmap ns" << std::setw(10) << "speedup"
+            << "\n";
+    for (const int setSize : keySetSizes)
+    {
+        std::shuffle(allCodes.begin(), allCodes.end(), randomGen);
+        std::vector<int> trackedCodes(allCodes.begin(),
+                allCodes.begin() + setSize);
+        std::sort(trackedCodes.begin(), trackedCodes.end());
+        const KeyDaemon::KeySet trackedKeys(trackedCodes);
+
+        long binaryHits, bitmapHits;
+        const double binaryTime = timeLookups(inputCodes,
+                [&trackedCodes](const unsigned short code)
+                {
+                    return std::binary_search(trackedCodes.begin(),
+                            trackedCodes.end(), code);
+                }, binaryHits);
+        const double bitmapTime = timeLookups(inputCodes,
+                [&trackedKeys](const unsigned short code)
+                {
+                    return trackedKeys.contains(code);
+                }, bitmapHits);
+        if (binaryHits != bitmapHits)
+        {
+            std::cerr << "Lookup results differ for " << setSize
+                    << " keys!\n";
+            return 1;
+        }
+        std::cout << std::setw(8) << setSize << std::fixed
+                << std::setprecision(3) << std::setw(16) << binaryTime
+                << std::setw(16) << bitmapTime << std::setw(9)
+                << (binaryTime / bitmapTime) << "x\n";
+    }
+    return 0;
+}
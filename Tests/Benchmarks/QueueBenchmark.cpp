@@ -0,0 +1,253 @@
+/**
+ * @file  QueueBenchmark.cpp
+ *
+ * @brief  Measures how long reader threads are held up by a parent
+ *         application that can't keep up, comparing direct sends under a
+ *         shared lock against each MessageQueue overflow policy.
+ *
+ *  Several producer threads stand in for KeyReader threads, each sending a
+ * burst of keystrokes at a time. A consumer thread stands in for the message
+ * writer, sleeping after each frame it takes as if the output pipe were full.
+ * When sending directly, producers take a shared lock and do the slow send
+ * themselves, the way reader threads used to send messages. The benchmark
+ * reports the slowest batch each producer had to wait for, how many presses,
+ * releases, and repeats were dropped, and whether messages arrived with
+ * increasing sequence numbers.
+ *
+ * Usage: QueueBenchmark [keystrokesPerThread]
+ */
+
+#include "MessageQueue.h"
+#include "KeyWireFormat.h"
+#include <linux/input-event-codes.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+using Clock = std::chrono::steady_clock;
+using Policy = KeyDaemon::MessageQueue::OverflowPolicy;
+using KeyDaemon::KeyMessage;
+using KeyDaemon::EventType;
+using KeyDaemon::KeyWireFormat::maxFrameMessages;
+
+// Number of keystrokes each producer sends by default:
+static const constexpr int defaultKeystrokeCount = 20000;
+
+// Number of producer threads:
+static const constexpr int producerCount = 2;
+
+// Keystrokes each producer sends at once, as if they were found in one read:
+static const constexpr int burstKeystrokes = 8;
+
+// Time the consumer spends on each frame, as if writing to a full pipe:
+static const constexpr auto frameDelay = std::chrono::microseconds(200);
+
+// Message counts by event type:
+struct TypeCounts
+{
+    std::atomic<long> counts[(int) EventType::trackedTypeCount];
+
+    TypeCounts()
+    {
+        for (std::atomic<long>& count : counts)
+        {
+            count = 0;
+        }
+    }
+
+    void add(const EventType type)
+    {
+        counts[(int) type]++;
+    }
+
+    long get(const EventType type) const
+    {
+        return counts[(int) type];
+    }
+};
+
+
+/**
+ * @brief  Generates one burst of keystrokes, with some keys held long enough
+ *         to repeat.
+ *
+ * @param burstIndex  Index of the burst within the producer's workload.
+ *
+ * @return            The burst's key messages.
+ */
+static std::vector<KeyMessage> generateBurst(const int burstIndex)
+{
+    std::vector<KeyMessage> messages;
+    for (int i = 0; i < burstKeystrokes; i++)
+    {
+        const int keystroke = (burstIndex * burstKeystrokes) + i;
+        const int keyCode = KEY_A + (keystroke % 20);
+        const int repeatCount = (keystroke % 5 == 0) ? 6 : 0;
+        messages.push_back({ keyCode, EventType::pressed });
+        for (int r = 0; r < repeatCount; r++)
+        {
+            messages.push_back({ keyCode, EventType::held });
+        }
+        messages.push_back({ keyCode, EventType::released });
+    }
+    return messages;
+}
+
+
+/**
+ * @brief  Runs the workload with one delivery method, and prints the results.
+ *
+ * @param name            The delivery method's name.
+ *
+ * @param keystrokeCount  Number of keystrokes each producer sends.
+ *
+ * @param useQueue        Whether messages pass through a MessageQueue, or are
+ *                        sent directly by producers.
+ *
+ * @param policy          The queue's overflow policy, if used.
+ */
+static void runBenchmark(const char* name, const int keystrokeCount,
+        const bool useQueue, const Policy policy)
+{
+    KeyDaemon::MessageQueue queue(policy);
+    std::mutex sendLock;
+    TypeCounts sent;
+    TypeCounts received;
+    std::atomic<bool> sequenceOrdered(true);
+
+    std::thread consumer([&]
+    {
+        if (! useQueue)
+        {
+            return;
+        }
+        KeyMessage frame[maxFrameMessages];
+        bool first = true;
+        unsigned int lastSequence = 0;
+        while (true)
+        {
+            int count = 0;
+            while (count < maxFrameMessages && queue.pop(frame[count]))
+            {
+                count++;
+            }
+            if (count == 0)
+            {
+                if (queue.isClosed())
+                {
+                    return;
+                }
+                queue.waitForMessages();
+                continue;
+            }
+            for (int i = 0; i < count; i++)
+            {
+                received.add(frame[i].event);
+                if (! first && frame[i].sequence <= lastSequence)
+                {
+                    sequenceOrdered = false;
+                }
+                first = false;
+                lastSequence = frame[i].sequence;
+            }
+            std::this_thread::sleep_for(frameDelay);
+        }
+    });
+
+    const int burstCount = keystrokeCount / burstKeystrokes;
+    std::vector<double> worstWaitMS(producerCount, 0);
+    std::vector<std::thread> producers;
+    const Clock::time_point startTime = Clock::now();
+    for (int p = 0; p < producerCount; p++)
+    {
+        producers.emplace_back([&, p]
+        {
+            for (int b = 0; b < burstCount; b++)
+            {
+                const std::vector<KeyMessage> burst = generateBurst(b);
+                const Clock::time_point burstStart = Clock::now();
+                if (useQueue)
+                {
+                    for (const KeyMessage& message : burst)
+                    {
+                        queue.push(message);
+                    }
+                }
+                else
+                {
+                    // Send frames under a shared lock, as reader threads did
+                    // before the writer thread was added:
+                    std::lock_guard<std::mutex> lock(sendLock);
+                    for (size_t s = 0; s < burst.size();
+                            s += maxFrameMessages)
+                    {
+                        const size_t end = std::min(burst.size(),
+                                s + maxFrameMessages);
+                        for (size_t i = s; i < end; i++)
+                        {
+                            received.add(burst[i].event);
+                        }
+                        std::this_thread::sleep_for(frameDelay);
+                    }
+                }
+                const double waitMS = std::chrono::duration<double,
+                        std::milli>(Clock::now() - burstStart).count();
+                worstWaitMS[p] = std::max(worstWaitMS[p], waitMS);
+                for (const KeyMessage& message : burst)
+                {
+                    sent.add(message.event);
+                }
+            }
+        });
+    }
+    for (std::thread& producer : producers)
+    {
+        producer.join();
+    }
+    const double producerSeconds = std::chrono::duration<double>
+            (Clock::now() - startTime).count();
+    queue.close();
+    consumer.join();
+
+    auto dropped = [&sent, &received](const EventType type)
+    {
+        return sent.get(type) - received.get(type);
+    };
+    std::cout << "  " << name << ": producerTime="
+            << producerSeconds << "s worstBatchWait="
+            << *std::max_element(worstWaitMS.begin(), worstWaitMS.end())
+            << "ms\n      dropped presses=" << dropped(EventType::pressed)
+            << " releases=" << dropped(EventType::released)
+            << " repeats=" << dropped(EventType::held);
+    if (useQueue)
+    {
+        std::cout << " peakDepth=" << queue.getPeakDepth()
+                << " ordered=" << (sequenceOrdered ? "yes" : "NO");
+    }
+    std::cout << "\n";
+}
+
+
+int main(int argc, char** argv)
+{
+    const int keystrokeCount = (argc > 1) ? std::atoi(argv[1])
+            : defaultKeystrokeCount;
+    if (keystrokeCount < burstKeystrokes)
+    {
+        std::cerr << "Usage: " << argv[0] << " [keystrokesPerThread]\n";
+        return 1;
+    }
+    std::cout << producerCount << " producers sending " << keystrokeCount
+            << " keystrokes each, queue capacity "
+            << KeyDaemon::MessageQueue::capacity << ":\n";
+    runBenchmark("direct     ", keystrokeCount, false, Policy::block);
+    runBenchmark("block      ", keystrokeCount, true, Policy::block);
+    runBenchmark("dropOldest ", keystrokeCount, true, Policy::dropOldest);
+    runBenchmark("dropRepeats", keystrokeCount, true, Policy::dropRepeats);
+    return 0;
+}
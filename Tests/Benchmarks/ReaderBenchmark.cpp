@@ -0,0 +1,254 @@
+/**
+ * @file  ReaderBenchmark.cpp
+ *
+ * @brief  Compares the thread count, memory use, and per-event latency of
+ *         one KeyReader thread per event file against a single EpollReader or
+ *         UringReader.
+ *
+ *  Named pipes stand in for keyboard event files, so the benchmark doesn't
+ * need access to real input devices. Each reader model runs in its own child
+ * process so that its thread and memory measurements aren't affected by the
+ * other model.
+ *
+ * Usage: ReaderBenchmark [fileCount] [eventCount]
+ */
+
+#include "KeyReader.h"
+#include "EpollReader.h"
+#include "UringReader.h"
+#include "KeySetBuffer.h"
+#include <linux/input.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+using Clock = std::chrono::steady_clock;
+
+// Reader models that can be tested:
+enum class ReaderType
+{
+    threads,
+    epoll,
+    uring
+};
+
+// Number of stand-in event files used by default:
+static const constexpr int defaultFileCount = 8;
+
+// Number of key events sent by default:
+static const constexpr int defaultEventCount = 5000;
+
+// Counts events received from the tested reader:
+class CountingListener : public KeyDaemon::KeyReader::Listener
+{
+public:
+    std::atomic<int> eventCount;
+    std::atomic<Clock::rep> lastEventTime;
+
+    CountingListener() : eventCount(0), lastEventTime(0) { }
+
+    virtual void keyEvent(const int keyCode, const KeyDaemon::EventType type,
+            const uint64_t timestamp) override
+    {
+        lastEventTime = Clock::now().time_since_epoch().count();
+        eventCount++;
+    }
+};
+
+
+/**
+ * @brief  Reads a numeric field from /proc/self/status.
+ *
+ * @param fieldName  The status field to read, including the trailing colon.
+ *
+ * @return           The field's value, or -1 if it wasn't found.
+ */
+static long readStatusField(const std::string& fieldName)
+{
+    std::ifstream statusFile("/proc/self/status");
+    std::string label;
+    while (statusFile >> label)
+    {
+        if (label == fieldName)
+        {
+            long value;
+            statusFile >> value;
+            return value;
+        }
+        statusFile.ignore(256, '\n');
+    }
+    return -1;
+}
+
+
+/**
+ * @brief  Runs the benchmark with one reader model and prints the results.
+ *
+ * @param readerType  The reader model to test.
+ *
+ * @param fifoPaths   Paths to all stand-in event files.
+ *
+ * @param eventCount  Number of key events to send.
+ */
+static void runBenchmark(const ReaderType readerType,
+        const std::vector<std::string>& fifoPaths, const int eventCount)
+{
+    // Hold each pipe open for writing, so readers never see end of file:
+    std::vector<int> writeFDs;
+    for (const std::string& path : fifoPaths)
+    {
+        writeFDs.push_back(open(path.c_str(), O_RDWR));
+    }
+    const KeyDaemon::KeySetBuffer trackedKeys(KeyDaemon::KeySet({ KEY_A }));
+    CountingListener listener;
+    std::vector<KeyDaemon::KeyReader*> keyReaders;
+    KeyDaemon::MultiReader* multiReader = nullptr;
+    if (readerType == ReaderType::epoll)
+    {
+        multiReader = new KeyDaemon::EpollReader(fifoPaths, trackedKeys,
+                &listener);
+    }
+    else if (readerType == ReaderType::uring)
+    {
+        KeyDaemon::UringReader* uringReader = new KeyDaemon::UringReader
+                (fifoPaths, trackedKeys, &listener);
+        if (! uringReader->isAvailable())
+        {
+            std::cout << "uring:   io_uring unavailable, skipping.\n";
+            delete uringReader;
+            return;
+        }
+        multiReader = uringReader;
+    }
+    else
+    {
+        for (const std::string& path : fifoPaths)
+        {
+            keyReaders.push_back(new KeyDaemon::KeyReader(path.c_str(),
+                        trackedKeys, &listener));
+        }
+    }
+    // Give reader threads time to start before measuring:
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    const long threadCount = readStatusField("Threads:");
+    const long rssKB = readStatusField("VmRSS:");
+
+    std::vector<double> latencies;
+    latencies.reserve(eventCount);
+    struct input_event event = {};
+    event.type = EV_KEY;
+    event.code = KEY_A;
+    for (int i = 0; i < eventCount; i++)
+    {
+        event.value = (i % 2 == 0) ? 1 : 0;
+        const int expectedCount = listener.eventCount + 1;
+        const Clock::time_point sendTime = Clock::now();
+        if (write(writeFDs[i % writeFDs.size()], &event, sizeof(event))
+                != sizeof(event))
+        {
+            std::cerr << "Failed to write event " << i << "\n";
+            break;
+        }
+        while (listener.eventCount < expectedCount)
+        {
+            std::this_thread::yield();
+        }
+        const Clock::time_point receiveTime
+                = Clock::time_point(Clock::duration(listener.lastEventTime));
+        latencies.push_back(std::chrono::duration<double, std::micro>
+                (receiveTime - sendTime).count());
+    }
+
+    for (KeyDaemon::KeyReader* reader : keyReaders)
+    {
+        reader->stopReading();
+        delete reader;
+    }
+    delete multiReader;
+    for (const int fd : writeFDs)
+    {
+        close(fd);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (const double latency : latencies)
+    {
+        total += latency;
+    }
+    const size_t count = latencies.size();
+    static const char* readerNames[] = { "threads:", "epoll:  ", "uring:  " };
+    std::cout << readerNames[static_cast<int>(readerType)]
+            << " threads=" << threadCount
+            << " rssKB=" << rssKB
+            << " events=" << count;
+    if (count > 0)
+    {
+        std::cout << " meanUS=" << (total / count)
+                << " medianUS=" << latencies[count / 2]
+                << " p99US=" << latencies[(count * 99) / 100];
+    }
+    std::cout << "\n";
+}
+
+
+int main(int argc, char** argv)
+{
+    const int fileCount = (argc > 1) ? std::atoi(argv[1]) : defaultFileCount;
+    const int eventCount = (argc > 2) ? std::atoi(argv[2])
+            : defaultEventCount;
+    if (fileCount <= 0 || eventCount <= 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " [fileCount] [eventCount]\n";
+        return 1;
+    }
+    char tempDir[] = "/tmp/kdReaderBenchXXXXXX";
+    if (mkdtemp(tempDir) == nullptr)
+    {
+        std::cerr << "Failed to create temporary directory\n";
+        return 1;
+    }
+    std::vector<std::string> fifoPaths;
+    for (int i = 0; i < fileCount; i++)
+    {
+        const std::string path = std::string(tempDir) + "/event"
+                + std::to_string(i);
+        if (mkfifo(path.c_str(), 0600) != 0)
+        {
+            std::cerr << "Failed to create pipe " << path << "\n";
+            return 1;
+        }
+        fifoPaths.push_back(path);
+    }
+    std::cout << "Reading " << eventCount << " events from " << fileCount
+            << " event files:\n";
+    for (const ReaderType readerType :
+            { ReaderType::threads, ReaderType::epoll, ReaderType::uring })
+    {
+        std::cout.flush();
+        const pid_t childProcess = fork();
+        if (childProcess == 0)
+        {
+            runBenchmark(readerType, fifoPaths, eventCount);
+            std::cout.flush();
+            _exit(0);
+        }
+        waitpid(childProcess, nullptr, 0);
+    }
+    for (const std::string& path : fifoPaths)
+    {
+        unlink(path.c_str());
+    }
+    rmdir(tempDir);
+    return 0;
+}
@@ -0,0 +1,212 @@
+/**
+ * @file  SequenceBenchmark.cpp
+ *
+ * @brief  Measures the cost of matching key presses against a growing number
+ *         of registered key sequences, comparing the daemon's
+ *         SequenceMatcher against buffering recent presses and comparing the
+ *         buffer with every sequence.
+ *
+ *  Each run registers a set of leader key sequences, e.g. Scroll Lock
+ * followed by two or three digits, and then feeds both matchers the same
+ * stream of random presses drawn from the sequence keys. The buffered matcher
+ * checks every registered sequence against its buffer after each press, the
+ * way parent applications matched sequences before the daemon did. The
+ * benchmark reports the average time each matcher spends on one key event,
+ * and checks that both matchers found the same number of sequences.
+ *
+ * Usage: SequenceBenchmark [eventCount]
+ */
+
+#include "SequenceMatcher.h"
+#include <linux/input-event-codes.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+using Clock = std::chrono::steady_clock;
+using KeyDaemon::KeyMessage;
+using KeyDaemon::EventType;
+using KeyDaemon::SequenceMatcher;
+
+// Number of key events sent to each matcher by default:
+static const constexpr int defaultEventCount = 2000000;
+
+// Registered sequence counts to compare:
+static const constexpr int sequenceCounts[] = { 1, 4, 16, 64 };
+
+// Keys that may follow the leader key in a sequence:
+static const constexpr int digitKeys[] = { KEY_1, KEY_2, KEY_3, KEY_4, KEY_5,
+        KEY_6, KEY_7, KEY_8, KEY_9, KEY_0 };
+static const constexpr int digitCount = sizeof(digitKeys) / sizeof(int);
+
+
+/**
+ * @brief  Matches sequences by buffering recent key presses, and comparing
+ *         the end of the buffer with every registered sequence.
+ */
+class BufferedMatcher
+{
+public:
+    BufferedMatcher(const std::vector<std::vector<int>>& sequences) :
+    sequences(sequences) { }
+
+    /**
+     * @brief  Adds a key event to the buffer, and checks if it completed a
+     *         registered sequence.
+     *
+     * @param message  A tracked key event.
+     *
+     * @return         The index of the completed sequence, or -1.
+     */
+    int process(const KeyMessage& message)
+    {
+        if (message.event != EventType::pressed)
+        {
+            return -1;
+        }
+        buffer.push_back(message.keyCode);
+        if (buffer.size() > SequenceMatcher::maxSequenceKeys)
+        {
+            buffer.erase(buffer.begin());
+        }
+        // Prefer the longest completed sequence, matching SequenceMatcher:
+        int matchIndex = -1;
+        size_t matchSize = 0;
+        for (size_t i = 0; i < sequences.size(); i++)
+        {
+            const std::vector<int>& sequence = sequences[i];
+            if (sequence.size() > buffer.size()
+                    || sequence.size() <= matchSize)
+            {
+                continue;
+            }
+            if (std::equal(sequence.begin(), sequence.end(),
+                    buffer.end() - sequence.size()))
+            {
+                matchIndex = static_cast<int>(i);
+                matchSize = sequence.size();
+            }
+        }
+        if (matchIndex >= 0)
+        {
+            buffer.clear();
+        }
+        return matchIndex;
+    }
+
+private:
+    const std::vector<std::vector<int>> sequences;
+    std::vector<int> buffer;
+};
+
+
+/**
+ * @brief  Creates distinct leader key sequences, using two digits for the
+ *         first sequences and three digits once two-digit sequences would
+ *         start to overlap.
+ *
+ * @param count  The number of sequences to create.
+ *
+ * @return       The new sequences.
+ */
+static std::vector<std::vector<int>> createSequences(const int count)
+{
+    std::vector<std::vector<int>> sequences;
+    for (int i = 0; i < count; i++)
+    {
+        std::vector<int> sequence = { KEY_SCROLLLOCK };
+        if (i < digitCount)
+        {
+            sequence.push_back(digitKeys[i]);
+            sequence.push_back(digitKeys[(i + 1) % digitCount]);
+        }
+        else
+        {
+            sequence.push_back(digitKeys[i % digitCount]);
+            sequence.push_back(digitKeys[(i / digitCount) % digitCount]);
+            sequence.push_back(digitKeys[(i * 7) % digitCount]);
+        }
+        sequences.push_back(sequence);
+    }
+    return sequences;
+}
+
+
+/**
+ * @brief  Creates a random stream of key presses and releases drawn from
+ *         the leader key and digit keys.
+ *
+ * @param eventCount  The number of events to create.
+ *
+ * @return            The new key events.
+ */
+static std::vector<KeyMessage> createEvents(const int eventCount)
+{
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int> keyDistribution(0, digitCount);
+    std::vector<KeyMessage> events;
+    events.reserve(eventCount);
+    while (static_cast<int>(events.size()) + 1 < eventCount)
+    {
+        const int keyIndex = keyDistribution(random);
+        const int keyCode = (keyIndex == digitCount) ? KEY_SCROLLLOCK
+                : digitKeys[keyIndex];
+        events.push_back({ keyCode, EventType::pressed });
+        events.push_back({ keyCode, EventType::released });
+    }
+    return events;
+}
+
+
+int main(int argc, char** argv)
+{
+    const int eventCount = (argc > 1) ? std::atoi(argv[1])
+            : defaultEventCount;
+    if (eventCount < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [eventCount]\n";
+        return 1;
+    }
+    const std::vector<KeyMessage> events = createEvents(eventCount);
+    std::cout << "Matching " << events.size() << " key events:\n";
+    for (const int sequenceCount : sequenceCounts)
+    {
+        const std::vector<std::vector<int>> sequences
+                = createSequences(sequenceCount);
+        SequenceMatcher sequenceMatcher(sequences, 0);
+        BufferedMatcher bufferedMatcher(sequences);
+        KeyMessage output[SequenceMatcher::maxOutputMessages];
+
+        long automatonMatches = 0;
+        Clock::time_point startTime = Clock::now();
+        for (const KeyMessage& event : events)
+        {
+            automatonMatches += sequenceMatcher.process(event, output);
+        }
+        const double automatonNS = std::chrono::duration<double, std::nano>
+                (Clock::now() - startTime).count() / events.size();
+
+        long bufferedMatches = 0;
+        startTime = Clock::now();
+        for (const KeyMessage& event : events)
+        {
+            bufferedMatches += (bufferedMatcher.process(event) >= 0) ? 1 : 0;
+        }
+        const double bufferedNS = std::chrono::duration<double, std::nano>
+                (Clock::now() - startTime).count() / events.size();
+
+        std::cout << "  " << sequenceCount << " sequences ("
+                << sequenceMatcher.getStateCount() << " states): automaton="
+                << automatonNS << "ns/event buffered=" << bufferedNS
+                << "ns/event matches=" << automatonMatches;
+        if (automatonMatches != bufferedMatches)
+        {
+            std::cout << " MISMATCH(buffered=" << bufferedMatches << ")";
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,411 @@
+/**
+ * @file  StartupBenchmark.cpp
+ *
+ * @brief  Breaks down the time the KeyDaemon needs between launch and its
+ *         first read, so the slowest startup phase can be found.
+ *
+ *  Startup is split into four phases, each timed on its own:
+ *
+ *  - spawn:     Forking and executing a new process, until its main function
+ *               runs. The benchmark executes itself with a probe argument, so
+ *               this doesn't include DaemonFramework launch checks.
+ *  - parse:     Parsing key code launch arguments like the ones a Controller
+ *               sends, using the daemon's KeyCode functions.
+ *  - discover:  Finding keyboard event files that can send tracked keys.
+ *  - ready:     Creating readers for the discovered files, until every
+ *               reader has opened its file and can read key events.
+ *
+ *  If no keyboards are found, or they can't be opened, named pipes stand in
+ * for keyboard event files when timing the ready phase.
+ *
+ * Usage: StartupBenchmark [runCount] [keyCount]
+ */
+
+#include "KeyReader.h"
+#include "KeySetBuffer.h"
+#include "EpollReader.h"
+#include "EventFiles.h"
+#include "KeyCode.h"
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+// Number of times each phase is timed by default:
+static const constexpr int defaultRunCount = 20;
+
+// Number of tracked key codes used by default, matching the TestParent:
+static const constexpr int defaultKeyCount = 239;
+
+// Number of stand-in event files used if no keyboards can be opened:
+static const constexpr int standInFileCount = 4;
+
+// Maximum time in milliseconds to wait for readers to open their files:
+static const constexpr int readyTimeoutMS = 1000;
+
+// Argument that makes the benchmark act as a spawned process:
+static const constexpr char* spawnProbeArg = "--spawnProbe";
+
+// Counts readers that opened their files or stopped:
+class ReadyListener : public KeyDaemon::KeyReader::Listener
+{
+public:
+    std::atomic<int> openedCount;
+    std::atomic<int> stoppedCount;
+
+    ReadyListener() : openedCount(0), stoppedCount(0) { }
+
+    virtual void keyEvent(const int keyCode, const KeyDaemon::EventType type,
+            const uint64_t timestamp) override { }
+
+    virtual void readerOpened() override
+    {
+        openedCount++;
+    }
+
+    virtual void readerStopped() override
+    {
+        stoppedCount++;
+    }
+};
+
+
+/**
+ * @brief  Gets the current CLOCK_MONOTONIC time, which spawned processes
+ *         share with the benchmark.
+ *
+ * @return  The current time in nanoseconds.
+ */
+static uint64_t getTimeNS()
+{
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    return static_cast<uint64_t>(currentTime.tv_sec) * 1000000000
+            + currentTime.tv_nsec;
+}
+
+
+/**
+ * @brief  Prints the mean, minimum, and maximum of a list of phase times.
+ *
+ * @param phaseName  The startup phase that was timed.
+ *
+ * @param timesNS    Each time the phase took, in nanoseconds.
+ *
+ * @param note       Optional extra information to print.
+ */
+static void printTimes(const char* phaseName,
+        const std::vector<uint64_t>& timesNS, const std::string& note = "")
+{
+    std::cout << phaseName;
+    if (! timesNS.empty())
+    {
+        uint64_t total = 0;
+        for (const uint64_t time : timesNS)
+        {
+            total += time;
+        }
+        std::cout << " runs=" << timesNS.size()
+                << " meanUS=" << (total / 1000.0 / timesNS.size())
+                << " minUS=" << (*std::min_element(timesNS.begin(),
+                        timesNS.end()) / 1000.0)
+                << " maxUS=" << (*std::max_element(timesNS.begin(),
+                        timesNS.end()) / 1000.0);
+    }
+    std::cout << note << "\n";
+}
+
+
+/**
+ * @brief  Times spawning a new process, from just before fork until the new
+ *         process's main function starts.
+ *
+ * @param executablePath  The benchmark's own executable path.
+ *
+ * @return                The spawn time in nanoseconds, or zero on failure.
+ */
+static uint64_t timeSpawn(const char* executablePath)
+{
+    int timePipe[2];
+    if (pipe(timePipe) != 0)
+    {
+        return 0;
+    }
+    const std::string pipeArg = std::to_string(timePipe[1]);
+    const uint64_t startTime = getTimeNS();
+    const pid_t childProcess = fork();
+    if (childProcess == 0)
+    {
+        close(timePipe[0]);
+        execl(executablePath, executablePath, spawnProbeArg, pipeArg.c_str(),
+                static_cast<char*>(nullptr));
+        _exit(1);
+    }
+    close(timePipe[1]);
+    uint64_t mainTime = 0;
+    if (childProcess < 0 || read(timePipe[0], &mainTime, sizeof(mainTime))
+            != sizeof(mainTime))
+    {
+        mainTime = 0;
+    }
+    close(timePipe[0]);
+    if (childProcess > 0)
+    {
+        waitpid(childProcess, nullptr, 0);
+    }
+    return (mainTime > startTime) ? (mainTime - startTime) : 0;
+}
+
+
+/**
+ * @brief  Builds launch arguments the way the Controller does.
+ *
+ * @param keyCodes  The tracked key codes to send.
+ *
+ * @return          The argument list, starting with an executable name.
+ */
+static std::vector<std::string> getLaunchArgs(const std::vector<int>& keyCodes)
+{
+    std::vector<std::string> arguments = { "KeyDaemon" };
+    for (const int code : keyCodes)
+    {
+        arguments.push_back(std::to_string(code));
+    }
+    return arguments;
+}
+
+
+/**
+ * @brief  Times parsing launch arguments with the same checks as the daemon's
+ *         main function.
+ *
+ * @param arguments  The launch arguments to parse.
+ *
+ * @return           The parse time in nanoseconds.
+ */
+static uint64_t timeParse(const std::vector<std::string>& arguments)
+{
+    using namespace KeyDaemon;
+    std::vector<char*> argv;
+    for (const std::string& argument : arguments)
+    {
+        argv.push_back(const_cast<char*>(argument.c_str()));
+    }
+    const int argc = static_cast<int>(argv.size());
+    const uint64_t startTime = getTimeNS();
+    RepeatPolicy repeatPolicy;
+    unsigned int repeatRateHz;
+    std::vector<std::vector<int>> chords;
+    std::vector<std::vector<int>> sequences;
+    std::vector<KeyGesture> gestures;
+    std::vector<EventMask> eventMasks;
+    KeyCode::parseRepeatPolicy(argc, argv.data(), repeatPolicy, repeatRateHz);
+    KeyCode::parseChords(argc, argv.data(), chords);
+    KeyCode::parseSequences(argc, argv.data(), sequences);
+    KeyCode::parseGestures(argc, argv.data(), gestures);
+    KeyCode::countCodeArgs(argc, argv.data());
+    const std::vector<int> keyCodes = KeyCode::parseCodes(argc, argv.data(),
+            eventMasks);
+    const uint64_t endTime = getTimeNS();
+    if (keyCodes.empty())
+    {
+        std::cerr << "Failed to parse launch arguments\n";
+    }
+    return endTime - startTime;
+}
+
+
+/**
+ * @brief  Times creating readers for a set of event files, until every
+ *         reader has opened its file or stopped.
+ *
+ * @param eventFilePaths  The event files to read.
+ *
+ * @param trackedKeys     The keys readers should track.
+ *
+ * @param useEpoll        Whether to use a single EpollReader instead of one
+ *                        KeyReader thread per file.
+ *
+ * @param openCount       Used to return the number of files opened.
+ *
+ * @return                The time in nanoseconds until all readers were
+ *                        ready.
+ */
+static uint64_t timeReady(const std::vector<std::string>& eventFilePaths,
+        const KeyDaemon::KeySetBuffer& trackedKeys, const bool useEpoll,
+        int& openCount)
+{
+    ReadyListener listener;
+    std::vector<KeyDaemon::KeyReader*> keyReaders;
+    KeyDaemon::MultiReader* multiReader = nullptr;
+    const uint64_t startTime = getTimeNS();
+    if (useEpoll)
+    {
+        // MultiReaders open all files before their constructors return:
+        multiReader = new KeyDaemon::EpollReader(eventFilePaths, trackedKeys,
+                &listener);
+        openCount = multiReader->getOpenFileCount();
+    }
+    else
+    {
+        for (const std::string& path : eventFilePaths)
+        {
+            keyReaders.push_back(new KeyDaemon::KeyReader(path.c_str(),
+                        trackedKeys, &listener));
+        }
+        const int readerCount = static_cast<int>(keyReaders.size());
+        const uint64_t timeoutTime = startTime
+                + static_cast<uint64_t>(readyTimeoutMS) * 1000000;
+        while (listener.openedCount + listener.stoppedCount < readerCount
+                && getTimeNS() < timeoutTime)
+        {
+            std::this_thread::yield();
+        }
+        openCount = listener.openedCount;
+    }
+    const uint64_t endTime = getTimeNS();
+    for (KeyDaemon::KeyReader* reader : keyReaders)
+    {
+        reader->stopReading();
+        delete reader;
+    }
+    delete multiReader;
+    return endTime - startTime;
+}
+
+
+/**
+ * @brief  Creates named pipes that stand in for keyboard event files, and
+ *         holds them open for writing so readers never block or see end of
+ *         file.
+ *
+ * @param tempDir   A temporary directory to create pipes in.
+ *
+ * @param writeFDs  Used to return the pipe file descriptors held open.
+ *
+ * @return          The stand-in event file paths.
+ */
+static std::vector<std::string> createStandInFiles(const std::string& tempDir,
+        std::vector<int>& writeFDs)
+{
+    std::vector<std::string> fifoPaths;
+    for (int i = 0; i < standInFileCount; i++)
+    {
+        const std::string path = tempDir + "/event" + std::to_string(i);
+        if (mkfifo(path.c_str(), 0600) != 0)
+        {
+            std::cerr << "Failed to create pipe " << path << "\n";
+            break;
+        }
+        fifoPaths.push_back(path);
+        writeFDs.push_back(open(path.c_str(), O_RDWR));
+    }
+    return fifoPaths;
+}
+
+
+int main(int argc, char** argv)
+{
+    if (argc > 2 && strcmp(argv[1], spawnProbeArg) == 0)
+    {
+        const uint64_t mainTime = getTimeNS();
+        const int timeFD = std::atoi(argv[2]);
+        const bool sent = write(timeFD, &mainTime, sizeof(mainTime))
+                == sizeof(mainTime);
+        return sent ? 0 : 1;
+    }
+    const int runCount = (argc > 1) ? std::atoi(argv[1]) : defaultRunCount;
+    const int keyCount = (argc > 2) ? std::atoi(argv[2]) : defaultKeyCount;
+    if (runCount <= 0 || keyCount <= 0 || keyCount >= KEY_CNT)
+    {
+        std::cerr << "Usage: " << argv[0] << " [runCount] [keyCount]\n";
+        return 1;
+    }
+    std::vector<int> keyCodes;
+    for (int code = 1; code <= keyCount; code++)
+    {
+        keyCodes.push_back(code);
+    }
+    const KeyDaemon::KeySet keySet(keyCodes);
+    const KeyDaemon::KeySetBuffer trackedKeys(keySet);
+    std::cout << "Timing " << runCount << " daemon startups tracking "
+            << keyCount << " keys:\n";
+
+    std::vector<uint64_t> spawnTimes;
+    std::vector<uint64_t> parseTimes;
+    std::vector<uint64_t> discoverTimes;
+    const std::vector<std::string> launchArgs = getLaunchArgs(keyCodes);
+    std::vector<std::string> eventFilePaths;
+    for (int i = 0; i < runCount; i++)
+    {
+        const uint64_t spawnTime = timeSpawn("/proc/self/exe");
+        if (spawnTime > 0)
+        {
+            spawnTimes.push_back(spawnTime);
+        }
+        parseTimes.push_back(timeParse(launchArgs));
+        const uint64_t discoverStart = getTimeNS();
+        eventFilePaths = KeyDaemon::EventFiles::getPaths(keySet);
+        discoverTimes.push_back(getTimeNS() - discoverStart);
+    }
+    printTimes("spawn:         ", spawnTimes);
+    printTimes("parse:         ", parseTimes);
+    printTimes("discover:      ", discoverTimes, " files="
+            + std::to_string(eventFilePaths.size()));
+
+    // Use stand-in files if no keyboards were found or none can be opened:
+    int openCount = 0;
+    if (! eventFilePaths.empty())
+    {
+        timeReady(eventFilePaths, trackedKeys, false, openCount);
+    }
+    char tempDir[] = "/tmp/kdStartupBenchXXXXXX";
+    std::vector<int> writeFDs;
+    const bool useStandIns = (openCount == 0);
+    if (useStandIns)
+    {
+        if (mkdtemp(tempDir) == nullptr)
+        {
+            std::cerr << "Failed to create temporary directory\n";
+            return 1;
+        }
+        eventFilePaths = createStandInFiles(tempDir, writeFDs);
+        std::cout << "No keyboards could be opened, using "
+                << eventFilePaths.size() << " stand-in event files.\n";
+    }
+    for (const bool useEpoll : { false, true })
+    {
+        std::vector<uint64_t> readyTimes;
+        for (int i = 0; i < runCount; i++)
+        {
+            readyTimes.push_back(timeReady(eventFilePaths, trackedKeys,
+                    useEpoll, openCount));
+        }
+        printTimes(useEpoll ? "ready(epoll):  " : "ready(threads):",
+                readyTimes, " opened=" + std::to_string(openCount));
+    }
+
+    for (const int fd : writeFDs)
+    {
+        close(fd);
+    }
+    if (useStandIns)
+    {
+        for (const std::string& path : eventFilePaths)
+        {
+            unlink(path.c_str());
+        }
+        rmdir(tempDir);
+    }
+    return 0;
+}
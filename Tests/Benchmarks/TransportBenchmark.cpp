@@ -0,0 +1,274 @@
+/**
+ * @file  TransportBenchmark.cpp
+ *
+ * @brief  Compares the latency and throughput of sending key messages through
+ *         a pipe against sending them through the shared memory RingWriter
+ *         and RingReader.
+ *
+ *  A child process stands in for the daemon, sending one message per event
+ * at a fixed rate, the same way the KeyLoop sends a single event. The parent
+ * process receives messages through a Pipe::Listener, just like the
+ * Controller. Each message's timestamp holds its send time in nanoseconds, so
+ * the listener can measure delivery latency.
+ *
+ * Usage: TransportBenchmark [eventCount]
+ */
+
+#include "RingWriter.h"
+#include "RingReader.h"
+#include "KeyWireFormat.h"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+#ifndef KD_TIMESTAMPS
+#error "TransportBenchmark must be built with KD_TIMESTAMPS to measure latency."
+#endif
+
+using Clock = std::chrono::steady_clock;
+using namespace KeyDaemon;
+
+// Number of events sent at each rate by default:
+static const constexpr int defaultEventCount = 50000;
+
+// Event rates tested, in events per second. Zero sends events as fast as
+// possible:
+static const constexpr int testedRates[] = { 10000, 50000, 200000, 0 };
+
+// Message transports that can be tested:
+enum class Transport
+{
+    pipe,
+    ring
+};
+
+
+/**
+ * @brief  Gets the current time in nanoseconds.
+ */
+static uint64_t currentTimeNS()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+            (Clock::now().time_since_epoch()).count();
+}
+
+
+// Records the latency of every received message:
+class LatencyListener : public DaemonFramework::Pipe::Listener
+{
+public:
+    LatencyListener(const int eventCount) : receivedCount(0)
+    {
+        latencies.reserve(eventCount);
+    }
+
+    virtual void processData(const unsigned char* data, const size_t size)
+        override
+    {
+        const uint64_t receiveTime = currentTimeNS();
+        for (size_t offset = 0; offset < size;
+                offset += KeyWireFormat::messageSize)
+        {
+            KeyMessage message;
+            if (KeyWireFormat::decode(data + offset, message, receiveTime))
+            {
+                latencies.push_back((receiveTime - message.timestamp)
+                        / 1000.0);
+            }
+        }
+        receivedCount = latencies.size();
+    }
+
+    std::vector<double> latencies;
+    std::atomic<size_t> receivedCount;
+};
+
+
+/**
+ * @brief  Sends events at a fixed rate from a child process.
+ *
+ * @param transport   The transport used to send messages.
+ *
+ * @param pipeFD      The pipe's write file descriptor.
+ *
+ * @param ringPath    The message ring's path.
+ *
+ * @param eventCount  Number of events to send.
+ *
+ * @param rate        Events to send per second, or zero to send events as
+ *                    fast as possible.
+ */
+static void sendEvents(const Transport transport, const int pipeFD,
+        const std::string& ringPath, const int eventCount, const int rate)
+{
+    RingWriter* ringWriter = nullptr;
+    if (transport == Transport::ring)
+    {
+        ringWriter = new RingWriter(ringPath.c_str());
+        if (! ringWriter->isOpen())
+        {
+            std::cerr << "Failed to open message ring.\n";
+            return;
+        }
+    }
+    const uint64_t startTime = currentTimeNS();
+    const uint64_t intervalNS = (rate > 0) ? (1000000000ULL / rate) : 0;
+    unsigned char encoded[KeyWireFormat::messageSize];
+    for (int i = 0; i < eventCount; i++)
+    {
+        const uint64_t sendTime = startTime + (i * intervalNS);
+        while (currentTimeNS() < sendTime) { }
+        KeyMessage message = { KEY_A, (i % 2 == 0) ? EventType::pressed
+                : EventType::released, currentTimeNS() };
+        KeyWireFormat::encode(message, i, encoded);
+        if (ringWriter != nullptr)
+        {
+            // Wait for room rather than dropping events, so every event's
+            // latency is measured:
+            while (! ringWriter->write(encoded, 1))
+            {
+                std::this_thread::yield();
+            }
+        }
+        else if (write(pipeFD, encoded, sizeof(encoded)) != sizeof(encoded))
+        {
+            std::cerr << "Failed to write to pipe.\n";
+            break;
+        }
+    }
+    delete ringWriter;
+}
+
+
+/**
+ * @brief  Runs the benchmark with one transport and rate, and prints the
+ *         results.
+ */
+static void runBenchmark(const Transport transport,
+        const std::string& ringPath, const int eventCount, const int rate)
+{
+    LatencyListener listener(eventCount);
+    RingReader ringReader(ringPath.c_str());
+    int pipeFDs[2] = { -1, -1 };
+    std::thread pipeThread;
+    if (transport == Transport::ring)
+    {
+        if (! ringReader.start(&listener))
+        {
+            std::cerr << "Failed to create message ring.\n";
+            return;
+        }
+    }
+    else
+    {
+        if (pipe(pipeFDs) != 0)
+        {
+            std::cerr << "Failed to create pipe.\n";
+            return;
+        }
+        pipeThread = std::thread([&pipeFDs, &listener]()
+        {
+            unsigned char frame[KeyWireFormat::maxFrameSize];
+            int bytesRead;
+            while ((bytesRead = read(pipeFDs[0], frame, sizeof(frame))) > 0)
+            {
+                listener.processData(frame, bytesRead);
+            }
+        });
+    }
+
+    const Clock::time_point startTime = Clock::now();
+    const pid_t childProcess = fork();
+    if (childProcess == 0)
+    {
+        sendEvents(transport, pipeFDs[1], ringPath, eventCount, rate);
+        _exit(0);
+    }
+    while (listener.receivedCount < (size_t) eventCount)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        if (waitpid(childProcess, nullptr, WNOHANG) != 0
+                && listener.receivedCount < (size_t) eventCount)
+        {
+            // Allow any remaining messages to arrive:
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            break;
+        }
+    }
+    const double seconds = std::chrono::duration<double>
+            (Clock::now() - startTime).count();
+    waitpid(childProcess, nullptr, 0);
+    if (transport == Transport::ring)
+    {
+        ringReader.stop();
+    }
+    else
+    {
+        close(pipeFDs[1]);
+        pipeThread.join();
+        close(pipeFDs[0]);
+    }
+
+    std::vector<double>& latencies = listener.latencies;
+    std::sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (const double latency : latencies)
+    {
+        total += latency;
+    }
+    const size_t count = latencies.size();
+    std::cout << (transport == Transport::ring ? "  ring: " : "  pipe: ")
+            << "events=" << count
+            << " eventsPerSec=" << (count / seconds);
+    if (count > 0)
+    {
+        std::cout << " meanUS=" << (total / count)
+                << " medianUS=" << latencies[count / 2]
+                << " p99US=" << latencies[(count * 99) / 100];
+    }
+    std::cout << "\n";
+}
+
+
+int main(int argc, char** argv)
+{
+    const int eventCount = (argc > 1) ? std::atoi(argv[1])
+            : defaultEventCount;
+    if (eventCount <= 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " [eventCount]\n";
+        return 1;
+    }
+    char tempDir[] = "/tmp/kdTransportBenchXXXXXX";
+    if (mkdtemp(tempDir) == nullptr)
+    {
+        std::cerr << "Failed to create temporary directory\n";
+        return 1;
+    }
+    const std::string ringPath = std::string(tempDir) + "/keyRing";
+    for (const int rate : testedRates)
+    {
+        if (rate > 0)
+        {
+            std::cout << "Sending " << eventCount << " events at " << rate
+                    << " events/s:\n";
+        }
+        else
+        {
+            std::cout << "Sending " << eventCount
+                    << " events as fast as possible:\n";
+        }
+        std::cout.flush();
+        runBenchmark(Transport::pipe, ringPath, eventCount, rate);
+        runBenchmark(Transport::ring, ringPath, eventCount, rate);
+    }
+    rmdir(tempDir);
+    return 0;
+}
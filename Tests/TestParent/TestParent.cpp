@@ -9,7 +9,10 @@
 #include <iostream>
 #include <cstdlib>
 #include <limits>
+#include <chrono>
+#include <algorithm>
 #include <unistd.h>
+#include <time.h>
 #include "Controller.h"
 #include "../Daemon/KeyCode.h"
 #include "EventType.h"
@@ -17,6 +20,20 @@
 // Print the application name before all info/error output:
 static const constexpr char* messagePrefix = "TestParent: ";
 
+// Maximum time in milliseconds to wait for the daemon to become ready:
+static const constexpr int readyTimeoutMS = 1000;
+
+#ifdef KD_CONTROL
+// Key code dropped from the tracked keys while swapping keys (KEY_A):
+static const constexpr int swappedKeyCode = 30;
+
+// Number of times tracked keys are replaced while swapping keys:
+static const constexpr int keySwapCount = 100;
+
+// Microseconds between tracked key replacements while swapping keys:
+static const constexpr int keySwapDelayUS = 20000;
+#endif
+
 // Prints key codes read from the PipeReader:
 class DaemonController : public KeyDaemon::Controller
 {
@@ -31,37 +48,196 @@ private:
                 = KeyDaemon::KeyCode::getKeyString(keyMessage.keyCode);
         std::string eventString = KeyDaemon::getEventString(keyMessage.event);
         std::cout << "Key " << keyString << "[" << keyMessage.keyCode
-                << "]: " << eventString << "\n";
+                << "]: " << eventString;
+        if (keyMessage.repeatCount > 0)
+        {
+            std::cout << " after " << keyMessage.repeatCount << " repeats";
+        }
+        if (keyMessage.timestamp != 0)
+        {
+            struct timespec currentTime;
+            clock_gettime(CLOCK_MONOTONIC, &currentTime);
+            const uint64_t timeUS = static_cast<uint64_t>(currentTime.tv_sec)
+                    * 1000000 + currentTime.tv_nsec / 1000;
+            std::cout << " (latency " << (timeUS - keyMessage.timestamp)
+                    << "us)";
+        }
+        std::cout << "\n";
+    }
+
+    virtual void handleChordEvent(const KeyDaemon::KeyMessage& chordMessage)
+    {
+        std::cout << "Chord " << chordMessage.keyCode << ": "
+                << KeyDaemon::getEventString(chordMessage.event) << "\n";
+    }
+
+    virtual void handleSequenceEvent
+    (const KeyDaemon::KeyMessage& sequenceMessage)
+    {
+        std::cout << "Sequence " << sequenceMessage.keyCode << ": completed\n";
+    }
+
+    virtual void handleGestureEvent(const KeyDaemon::KeyMessage& gestureMessage)
+    {
+        std::cout << "Key "
+                << KeyDaemon::KeyCode::getKeyString(gestureMessage.keyCode)
+                << "[" << gestureMessage.keyCode << "]: "
+                << ((gestureMessage.kind == KeyDaemon::MessageKind::longPress)
+                    ? "long press" : "double tap") << "\n";
+    }
+
+    virtual void handleMessageGap(const unsigned int lostCount)
+    {
+        std::cout << messagePrefix << lostCount
+                << " key messages were lost.\n";
+    }
+
+    virtual void handleDaemonReady(const KeyDaemon::KeyMessage& readyMessage)
+    {
+        std::cout << messagePrefix << "Daemon ready, reading "
+                << readyMessage.keyCode << " event files.\n";
     }
 };
 
 
+// Reads a list of numbers separated by any non-digit characters, e.g.
+// "30,48,46":
+static std::vector<int> parseNumbers(const char* numberList)
+{
+    std::vector<int> numbers;
+    const char* position = numberList;
+    while (*position != '\0')
+    {
+        char* end = nullptr;
+        const long number = std::strtol(position, &end, 10);
+        if (end == position)
+        {
+            position++;
+            continue;
+        }
+        numbers.push_back(static_cast<int>(number));
+        position = end;
+    }
+    return numbers;
+}
+
+
 int main(int argc, char** argv)
 {
     bool killParent = false;
+    bool swapKeys = false;
+    bool pressedOnly = false;
+    std::vector<std::vector<int>> chords;
+    std::vector<std::vector<int>> sequences;
+    std::vector<KeyDaemon::KeyGesture> gestures;
+    std::string repeatPolicy;
     for (int i = 1; i < argc; i++)
     {
         std::string arg(argv[i]);
+        const bool hasValue = (i + 1) < argc;
         if (arg == "-k" || arg == "--kill")
         {
             killParent = true;
         }
+        else if (arg == "-s" || arg == "--swap-keys")
+        {
+            swapKeys = true;
+        }
+        else if (arg == "-p" || arg == "--pressed-only")
+        {
+            pressedOnly = true;
+        }
+        else if ((arg == "-c" || arg == "--chord") && hasValue)
+        {
+            chords.push_back(parseNumbers(argv[++i]));
+        }
+        else if ((arg == "-q" || arg == "--sequence") && hasValue)
+        {
+            sequences.push_back(parseNumbers(argv[++i]));
+        }
+        else if ((arg == "-g" || arg == "--gesture") && hasValue)
+        {
+            // Gestures are written as "keyCode:longPressMS:doubleTapMS":
+            const std::vector<int> values = parseNumbers(argv[++i]);
+            if (values.size() == 3)
+            {
+                KeyDaemon::KeyGesture gesture;
+                gesture.keyCode = values[0];
+                gesture.longPressMS = values[1];
+                gesture.doubleTapMS = values[2];
+                gestures.push_back(gesture);
+            }
+        }
+        else if ((arg == "-r" || arg == "--repeat") && hasValue)
+        {
+            repeatPolicy = argv[++i];
+        }
     }
     using namespace KeyDaemon;
     DaemonController controller;
+    // Repeat policies are written as "suppress", "collapse", or
+    // "rateLimit:rateHz":
+    if (repeatPolicy == "suppress")
+    {
+        controller.setRepeatPolicy(RepeatPolicy::suppress);
+    }
+    else if (repeatPolicy == "collapse")
+    {
+        controller.setRepeatPolicy(RepeatPolicy::collapse);
+    }
+    else if (repeatPolicy.compare(0, 9, "rateLimit") == 0)
+    {
+        const std::vector<int> rate = parseNumbers(repeatPolicy.c_str());
+        controller.setRepeatPolicy(RepeatPolicy::rateLimit,
+                rate.empty() ? 0 : rate[0]);
+    }
     std::vector<int> trackedCodes;
     trackedCodes.reserve(239);
     for (int i = 1; i < 240; i++)
     {
         trackedCodes.push_back(i);
     }
-    controller.startKeyDaemon(trackedCodes);
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point launchTime = Clock::now();
+    // Optionally request only key presses, leaving releases to be read but
+    // filtered out by the daemon:
+    const std::vector<EventMask> eventMasks(pressedOnly ? trackedCodes.size()
+            : 0, getEventMask(EventType::pressed));
+    controller.startKeyDaemon(trackedCodes, chords, sequences, gestures,
+            eventMasks);
+    if (controller.waitForDaemonReady(readyTimeoutMS) >= 0)
+    {
+        std::cout << messagePrefix << "Daemon startup took "
+                << std::chrono::duration_cast<std::chrono::milliseconds>
+                    (Clock::now() - launchTime).count() << "ms.\n";
+    }
     if (killParent)
     {
         sleep(1);
         std::cout << "Killing TestParent to see how the daemon reacts: \n";
         exit(0);
     }
+    if (swapKeys)
+    {
+        #ifdef KD_CONTROL
+        // Repeatedly stop and start tracking one key, so its messages are
+        // still in flight when the parent starts rejecting them:
+        std::vector<int> swappedCodes = trackedCodes;
+        swappedCodes.erase(std::remove(swappedCodes.begin(),
+                swappedCodes.end(), swappedKeyCode), swappedCodes.end());
+        for (int i = 0; i < keySwapCount; i++)
+        {
+            controller.setTrackedKeys(((i % 2) == 0) ? swappedCodes
+                    : trackedCodes);
+            usleep(keySwapDelayUS);
+        }
+        controller.setTrackedKeys(trackedCodes);
+        std::cout << messagePrefix << "Finished swapping tracked keys.\n";
+        #else
+        std::cout << messagePrefix
+                << "Can't swap tracked keys without KD_CONTROL.\n";
+        #endif
+    }
     sleep(10);
     std::cout << "Timeout complete, stopping daemon.\n";
     controller.stopDaemon();
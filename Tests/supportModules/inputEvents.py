@@ -0,0 +1,32 @@
+"""inputEvents builds Linux input events for stand-in keyboard event files."""
+import struct, time
+
+# Linux input event constants:
+EV_SYN = 0
+EV_KEY = 1
+SYN_REPORT = 0
+SYN_DROPPED = 3
+KEY_A = 30
+KEY_B = 48
+KEY_C = 46
+
+"""
+Packs a single Linux input_event structure.
+Keyword Arguments:
+eventType -- The event type.
+code      -- The event code.
+value     -- The event value.
+"""
+def packEvent(eventType, code, value):
+    now = time.time()
+    return struct.pack('llHHi', int(now), int((now % 1) * 1000000), \
+                       eventType, code, value)
+
+"""
+Packs one key event followed by the report that ends its event group.
+Keyword Arguments:
+code  -- The key code.
+value -- The key event value: 1 for press, 0 for release, 2 for repeat.
+"""
+def packKeyEvent(code, value):
+    return packEvent(EV_KEY, code, value) + packEvent(EV_SYN, SYN_REPORT, 0)
@@ -22,6 +22,10 @@ class VarNames:
         self._configMode  = 'KD_CONFIG'
         self._verbose     = 'KD_VERBOSE'
         self._timeout     = 'DF_TIMEOUT'
+        self._backend     = 'KD_READER_BACKEND'
+        self._eventDir    = 'KD_EVENT_DIR'
+        self._control     = 'KD_CONTROL'
+        self._seqTimeout  = 'KD_SEQUENCE_TIMEOUT'
     """Return the daemon executable variable name."""
     @property
     def daemon(self):
@@ -66,6 +70,22 @@ class VarNames:
     @property
     def timeout(self):
         return self._timeout
+    """Return the daemon's event file reader backend variable name."""
+    @property
+    def readerBackend(self):
+        return self._backend
+    """Return the daemon's stand-in event file directory variable name."""
+    @property
+    def eventDir(self):
+        return self._eventDir
+    """Return the daemon control FIFO build variable name."""
+    @property
+    def control(self):
+        return self._control
+    """Return the daemon's key sequence timeout build variable name."""
+    @property
+    def sequenceTimeout(self):
+        return self._seqTimeout
 varNames = VarNames()
 
 """
@@ -96,6 +116,16 @@ verbose    -- Whether the daemon prints verbose messages.
               (default: True)
 timeout    -- Seconds before the daemon exits, or False to disable timeout.
               (default: 1)
+readerBackend -- The daemon's event file reading backend, either 'threads',
+                 'epoll', or 'uring'. (default: None, using the makefile's
+                 default backend)
+eventDir   -- A stand-in directory the daemon searches for event files instead
+              of /dev/input, ending in '/'. (default: None, using /dev/input)
+control    -- Whether the parent can send commands to the running daemon.
+              (default: False)
+sequenceTimeout -- Maximum milliseconds between key presses in a registered
+                   key sequence, or zero for no limit. (default: None, using
+                   the makefile's default timeout)
 """
 def getBuildArgs(daemon = paths.daemon, \
                  daemonDir = paths.secureExeDir, \
@@ -106,12 +136,18 @@ def getBuildArgs(daemon = paths.daemon, \
                  testArgs = None, \
                  debugBuild = True, \
                  verbose = True,
-                 timeout = 1):
+                 timeout = 1, \
+                 readerBackend = None, \
+                 eventDir = None, \
+                 control = False, \
+                 sequenceTimeout = None):
     if testArgs is not None:
         debugBuild = testArgs.debugBuild
         verbose = testArgs.useVerbose
         if testArgs.timeout is not None:
             timeout = testArgs.timeout
+        if testArgs.readerBackend is not None:
+            readerBackend = testArgs.readerBackend
     argList = [varNames.configMode + '=' + ('Debug' if debugBuild \
                                             else 'Release')]
     args = [(daemon, varNames.daemon), \
@@ -120,11 +156,15 @@ def getBuildArgs(daemon = paths.daemon, \
             (pipePath, varNames.pipePath), \
             (lockPath, varNames.lockPath), \
             (keyLimit, varNames.keyLimit), \
-            (timeout,  varNames.timeout)]
+            (timeout,  varNames.timeout), \
+            (readerBackend, varNames.readerBackend), \
+            (eventDir, varNames.eventDir), \
+            (sequenceTimeout, varNames.sequenceTimeout)]
     for value, varName in args:
         if value is not None:
             argList.append(varName + '=' + str(value))
     argList.append(varNames.verbose + '=' + ('1' if verbose else '0'))
+    argList.append(varNames.control + '=' + ('1' if control else '0'))
     argList.append(varNames.daemonPath + '=' + paths.daemonSecureExePath)
     return argList
 
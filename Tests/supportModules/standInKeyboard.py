@@ -0,0 +1,100 @@
+"""
+standInKeyboard runs KeyDaemon tests that type on a stand-in keyboard.
+
+The daemon is built to search a temporary event directory, where a FIFO takes
+the place of a keyboard event file. Scripted input is written to the FIFO once
+the daemon opens it, and the parent's logged output is checked after the
+daemon closes.
+"""
+import os, shutil, tempfile, threading, time
+from supportModules import make
+from supportModules.pathConstants import paths
+from supportModules.testResult import InitCode, ExitCode, Result
+from supportModules.inputEvents import packKeyEvent
+
+# Seconds the daemon runs before closing:
+daemonTimeout = 4
+
+# Seconds to wait after the daemon opens the stand-in keyboard before typing:
+startDelay = 0.5
+
+# Default seconds to wait after each key event:
+keyDelay = 0.1
+
+"""
+Returns a typing step that sends one key event.
+Keyword Arguments:
+code  -- The key code.
+value -- The key event value: 1 for press, 0 for release, 2 for repeat.
+delay -- Seconds to wait after sending the event. (default: keyDelay)
+"""
+def keyStep(code, value, delay = keyDelay):
+    return (packKeyEvent(code, value), delay)
+
+"""
+Returns typing steps that press and release each key in order.
+Keyword Arguments:
+codes -- The key codes to tap.
+delay -- Seconds to wait after each press and release. (default: keyDelay)
+"""
+def tapSteps(codes, delay = keyDelay):
+    steps = []
+    for code in codes:
+        steps += [keyStep(code, 1, delay), keyStep(code, 0, delay)]
+    return steps
+
+"""
+Opens the stand-in keyboard and writes every typing step to it.
+Keyword Arguments:
+eventPath -- The stand-in event file path.
+steps     -- A list of (data, delay) pairs, holding packed input events to
+             write and the seconds to wait after writing them.
+"""
+def typeSteps(eventPath, steps):
+    # Opening for writing blocks until the daemon opens the file for reading:
+    with open(eventPath, 'wb', buffering = 0) as eventFile:
+        time.sleep(startDelay)
+        for data, delay in steps:
+            eventFile.write(data)
+            time.sleep(delay)
+        time.sleep(0.5)
+
+"""
+Runs the daemon while typing on a stand-in keyboard, and checks the parent's
+output.
+Keyword Arguments:
+testObject  -- The Test object running the test.
+testArgs    -- A testArgs.Values argument object.
+description -- A description of the test.
+steps       -- Typing steps to write to the stand-in keyboard.
+checkOutput -- A function that takes the parent's logged output, and returns
+               whether it holds the expected key events.
+argList     -- Arguments to pass to the TestParent. (default: [])
+buildArgs   -- Additional make.getBuildArgs keyword arguments.
+"""
+def runTest(testObject, testArgs, description, steps, checkOutput, \
+            argList = [], **buildArgs):
+    eventDir = tempfile.mkdtemp(prefix = 'kdEvents')
+    try:
+        eventPath = os.path.join(eventDir, 'event0')
+        os.mkfifo(eventPath, 0o600)
+        keyboardThread = threading.Thread(target = typeSteps, \
+                                          args = (eventPath, steps), \
+                                          daemon = True)
+        keyboardThread.start()
+        makeArgs = make.getBuildArgs(testArgs = testArgs, \
+                                     timeout = daemonTimeout, \
+                                     eventDir = eventDir + '/', **buildArgs)
+        result = testObject.fullTest(makeArgs, paths.parentSecureExePath, \
+                                     argList = argList)
+        keyboardThread.join(1)
+        if result.getResultCode() == ExitCode.success:
+            keyOutput = ''
+            if os.path.isfile(paths.tempLogPath):
+                with open(paths.tempLogPath, 'r') as logFile:
+                    keyOutput = logFile.read()
+            if not checkOutput(keyOutput):
+                result = Result(InitCode.keyEventsMissing, ExitCode.success)
+        testObject.checkResult(result, description)
+    finally:
+        shutil.rmtree(eventDir, ignore_errors = True)
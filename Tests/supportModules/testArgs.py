@@ -6,13 +6,14 @@ import os
 """Holds the values of a test's command line arguments."""
 class Values():
     def __init__(self, verbose, debugBuild, printHelp, timeout, untilFailure, \
-                 logBuildArgs):
+                 logBuildArgs, readerBackend):
         self._verbose      = verbose
         self._debugBuild   = debugBuild
         self._printHelp    = printHelp
         self._timeout      = timeout
         self._untilFailure = untilFailure
         self._logBuildArgs = logBuildArgs
+        self._readerBackend = readerBackend
     """Return whether the test should print verbose output messages."""
     @property
     def useVerbose(self):
@@ -37,6 +38,10 @@ class Values():
     @property
     def logBuildArgs(self):
         return self._logBuildArgs
+    """Return the daemon's keyboard event reading backend, or None if unset."""
+    @property
+    def readerBackend(self):
+        return self._readerBackend
 
 """Read command line arguments and returns them as a TestArgs object."""
 def read():
@@ -46,6 +51,7 @@ def read():
     timeout      = None
     untilFailure = False
     logBuildArgs = None
+    readerBackend = None
     import sys
     for arg in sys.argv[1:]:
         if arg == '-v' or arg == '--verbose':
@@ -64,12 +70,16 @@ def read():
             timeout = int(arg[3:])
         elif arg[:11] == '--timeout=':
             timeout = int(arg[11:])
+        elif arg[:3] == '-b=':
+            readerBackend = arg[3:]
+        elif arg[:10] == '--backend=':
+            readerBackend = arg[10:]
         else:
             print('Warning: argument "' + arg + '" not recognized.')
     if logBuildArgs is None:
         logBuildArgs = False
     return Values(verbose, debug, printHelp, timeout, untilFailure, \
-                  logBuildArgs)
+                  logBuildArgs, readerBackend)
 
 """
 Prints help text describing the purpose of a test and all available command
@@ -91,6 +101,8 @@ def printHelp(testName, testDescription):
           + 'Build in Release mode instead of Debug.')
     print('\t-t, --timeout=[number]: ' \
           + 'Seconds to run the daemon before exiting.')
+    print('\t-b, --backend=[type]:   ' \
+          + 'Daemon event reader backend: threads, epoll, or uring.')
     print('\t-u, --until-failure:    ' \
           + 'Stop after the first failed test.')
     print('\t-l, --log-build-args: ' \
@@ -13,7 +13,8 @@ class InitCode(Enum):
     parentInitSuccess = 55,
     parentRunFailure = 56,
     parentRunSuccess = 57,
-    daemonRunSuccess = 58
+    daemonRunSuccess = 58,
+    keyEventsMissing = 59
 
 """
 Represents an exit code returned by a daemon.
@@ -84,7 +85,9 @@ def resultCodeDescription(resultCode):
             InitCode.parentRunSuccess: \
                     'Successfully started TestParent.',
             InitCode.daemonRunSuccess: \
-                    'Successfully started KeyDaemon.'
+                    'Successfully started KeyDaemon.',
+            InitCode.keyEventsMissing: \
+                    'TestParent did not receive the expected key events.'
     }
     if resultCode in titleDict:
         return titleDict[resultCode]
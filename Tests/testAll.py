@@ -1,13 +1,16 @@
 #!/usr/bin/python
 """Runs all KeyDaemon tests."""
 
-from testModules import basicBuild
+from testModules import basicBuild, hotplug, mergeKeyboards, changeKeys, \
+                        sequences, chords, gestures, repeatPolicy, \
+                        droppedEvents
 from supportModules import testArgs
 
 args = testArgs.read()
 if (args.printHelp):
     testDefs.printHelp('TestAll.py', 'Runs all DaemonFramework tests.')
-testModules = [basicBuild]
+testModules = [basicBuild, hotplug, mergeKeyboards, changeKeys, sequences, \
+               chords, gestures, repeatPolicy, droppedEvents]
 testObjects = []
 testCount = 0
 testsPassed = 0
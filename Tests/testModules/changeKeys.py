@@ -0,0 +1,89 @@
+"""
+Test that the parent doesn't report lost messages when it changes the daemon's
+tracked keys while key messages are still in flight.
+
+The daemon is built to search a stand-in event directory, where a FIFO takes
+the place of a keyboard event file, and to accept control commands so the
+parent can replace its tracked keys.
+"""
+
+import sys, os, shutil, tempfile, threading, time
+moduleDir = os.path.dirname(os.path.realpath(__file__))
+sys.path.insert(0, os.path.join(moduleDir, os.pardir))
+from supportModules import make, testArgs, pathConstants, testObject
+from supportModules.pathConstants import paths
+from supportModules.testObject import Test
+from supportModules.testResult import InitCode, ExitCode, Result
+from supportModules.inputEvents import KEY_A, packKeyEvent
+
+# Seconds the daemon runs before closing:
+daemonTimeout = 4
+
+# Number of times the stand-in keyboard taps the A key:
+tapCount = 200
+
+# Seconds between each key press and release:
+tapDelay = 0.005
+
+"""
+Opens a stand-in keyboard and taps the A key while the parent swaps its
+tracked keys.
+Keyword Arguments:
+eventPath -- The stand-in event file path.
+"""
+def typeOnKeyboard(eventPath):
+    # Opening for writing blocks until the daemon opens the file for reading:
+    with open(eventPath, 'wb', buffering = 0) as eventFile:
+        for i in range(tapCount):
+            for value in (1, 0):
+                eventFile.write(packKeyEvent(KEY_A, value))
+                time.sleep(tapDelay)
+        time.sleep(0.5)
+
+"""
+Creates Tests that change tracked keys while key messages are sent.
+Keyword Arguments:
+testArgs -- A testArgs.Values argument object.
+"""
+def getTests(testArgs):
+    title = 'Tracked key change tests:'
+    def testFunction(testObject):
+        eventDir = tempfile.mkdtemp(prefix = 'kdEvents')
+        try:
+            eventPath = os.path.join(eventDir, 'event0')
+            os.mkfifo(eventPath, 0o600)
+            keyboardThread = threading.Thread(target = typeOnKeyboard, \
+                                              args = (eventPath,), \
+                                              daemon = True)
+            keyboardThread.start()
+            makeArgs = make.getBuildArgs(testArgs = testArgs, \
+                                         timeout = daemonTimeout, \
+                                         eventDir = eventDir + '/', \
+                                         control = True)
+            result = testObject.fullTest(makeArgs, paths.parentSecureExePath, \
+                                         argList = ['--swap-keys'])
+            keyboardThread.join(1)
+            if result.getResultCode() == ExitCode.success:
+                keyOutput = ''
+                if os.path.isfile(paths.tempLogPath):
+                    with open(paths.tempLogPath, 'r') as logFile:
+                        keyOutput = logFile.read()
+                if '[' + str(KEY_A) + ']' not in keyOutput \
+                        or 'messages were lost' in keyOutput:
+                    result = Result(InitCode.keyEventsMissing, \
+                                    ExitCode.success)
+            testObject.checkResult(result, 'Changing tracked keys with ' \
+                                   + 'messages in flight reports no gaps')
+        finally:
+            shutil.rmtree(eventDir, ignore_errors = True)
+    testCount = 1
+    return Test(title, testFunction, testCount, testArgs)
+
+# Run this file's tests alone if executing this module as a script:
+if __name__ == '__main__':
+    args = testArgs.read()
+    if args.printHelp:
+        testArgs.printHelp('changeKeys.py', \
+                           'Test if the KeyDaemon parent reports lost ' \
+                           + 'messages when tracked keys change.')
+    changeKeyTests = getTests(args).runAll()
@@ -0,0 +1,70 @@
+"""
+Test that the daemon reports registered key chords pressed on a stand-in
+keyboard, in either key order, and ignores them while other keys are held.
+"""
+
+import sys, os
+moduleDir = os.path.dirname(os.path.realpath(__file__))
+sys.path.insert(0, os.path.join(moduleDir, os.pardir))
+from supportModules import testArgs, standInKeyboard
+from supportModules.testObject import Test
+from supportModules.standInKeyboard import keyStep
+from supportModules.inputEvents import KEY_A, KEY_B, KEY_C
+
+# The registered chord's keys:
+chordKeys = [KEY_A, KEY_B]
+
+"""
+Returns typing steps that press each key in order, then release them in
+reverse order.
+Keyword Arguments:
+codes -- The key codes to press together.
+"""
+def holdSteps(codes):
+    return [keyStep(code, 1) for code in codes] \
+            + [keyStep(code, 0) for code in reversed(codes)]
+
+"""
+Returns a function that checks how many times the parent reported the
+registered chord being pressed and released.
+Keyword Arguments:
+expectedCount -- The number of chord presses and releases the parent should
+                 get.
+"""
+def expectChords(expectedCount):
+    return lambda keyOutput: \
+            keyOutput.count('Chord 0: pressed') == expectedCount \
+            and keyOutput.count('Chord 0: released') == expectedCount
+
+"""
+Creates Tests that press key chords on a stand-in keyboard.
+Keyword Arguments:
+testArgs -- A testArgs.Values argument object.
+"""
+def getTests(testArgs):
+    title = 'Key chord tests:'
+    chordArgs = ['--chord', '+'.join(map(str, chordKeys))]
+    def testFunction(testObject):
+        extraKeys = [chordKeys[0], KEY_C, chordKeys[1]]
+        standInKeyboard.runTest(testObject, testArgs, \
+                                'Chords are pressed and released in either ' \
+                                + 'key order', \
+                                holdSteps(chordKeys) \
+                                + holdSteps(list(reversed(chordKeys))), \
+                                expectChords(2), chordArgs)
+        standInKeyboard.runTest(testObject, testArgs, \
+                                'Chords are ignored while other keys are ' \
+                                + 'held', \
+                                holdSteps(extraKeys), expectChords(0), \
+                                chordArgs)
+    testCount = 2
+    return Test(title, testFunction, testCount, testArgs)
+
+# Run this file's tests alone if executing this module as a script:
+if __name__ == '__main__':
+    args = testArgs.read()
+    if args.printHelp:
+        testArgs.printHelp('chords.py', \
+                           'Test if the KeyDaemon reports registered key ' \
+                           + 'chords.')
+    chordTests = getTests(args).runAll()
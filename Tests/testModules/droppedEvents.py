@@ -0,0 +1,63 @@
+"""
+Test that the daemon discards the rest of an input report after the kernel
+reports dropped events with SYN_DROPPED, and keeps reading input after the
+next complete report.
+
+Stand-in keyboard FIFOs can't report the keyboard's current key state, so this
+only checks that events from the incomplete report are never sent.
+"""
+
+import sys, os
+moduleDir = os.path.dirname(os.path.realpath(__file__))
+sys.path.insert(0, os.path.join(moduleDir, os.pardir))
+from supportModules import testArgs, standInKeyboard
+from supportModules.testObject import Test
+from supportModules.standInKeyboard import keyStep, tapSteps, keyDelay
+from supportModules.inputEvents import EV_SYN, EV_KEY, SYN_REPORT, \
+        SYN_DROPPED, KEY_A, KEY_B, KEY_C, packEvent
+
+"""
+Returns a typing step holding a SYN_DROPPED event, followed by a B key press
+that completes the incomplete report.
+"""
+def droppedReportStep():
+    return (packEvent(EV_SYN, SYN_DROPPED, 0) + packEvent(EV_KEY, KEY_B, 1) \
+            + packEvent(EV_SYN, SYN_REPORT, 0), keyDelay)
+
+"""
+Checks that the parent got every key event except the B key press sent in the
+incomplete report.
+Keyword Arguments:
+keyOutput -- The parent's logged output.
+"""
+def checkResync(keyOutput):
+    def count(code, eventName):
+        return keyOutput.count('[' + str(code) + ']: ' + eventName)
+    return count(KEY_A, 'pressed') == 1 and count(KEY_A, 'released') == 1 \
+            and count(KEY_B, 'pressed') == 0 and count(KEY_C, 'pressed') == 1
+
+"""
+Creates Tests that send dropped event reports from a stand-in keyboard.
+Keyword Arguments:
+testArgs -- A testArgs.Values argument object.
+"""
+def getTests(testArgs):
+    title = 'Dropped event tests:'
+    def testFunction(testObject):
+        standInKeyboard.runTest(testObject, testArgs, \
+                                'Events are discarded until the report ' \
+                                + 'after SYN_DROPPED ends', \
+                                [keyStep(KEY_A, 1), droppedReportStep(), \
+                                 keyStep(KEY_A, 0)] + tapSteps([KEY_C]), \
+                                checkResync)
+    testCount = 1
+    return Test(title, testFunction, testCount, testArgs)
+
+# Run this file's tests alone if executing this module as a script:
+if __name__ == '__main__':
+    args = testArgs.read()
+    if args.printHelp:
+        testArgs.printHelp('droppedEvents.py', \
+                           'Test if the KeyDaemon discards input after ' \
+                           + 'dropped events.')
+    droppedEventTests = getTests(args).runAll()
@@ -0,0 +1,79 @@
+"""
+Test that the daemon reports long presses and double taps made on a stand-in
+keyboard, but only when they meet the key's gesture thresholds.
+"""
+
+import sys, os
+moduleDir = os.path.dirname(os.path.realpath(__file__))
+sys.path.insert(0, os.path.join(moduleDir, os.pardir))
+from supportModules import testArgs, standInKeyboard
+from supportModules.testObject import Test
+from supportModules.standInKeyboard import keyStep
+from supportModules.inputEvents import KEY_A
+
+# Milliseconds KEY_A must be held before a long press is sent:
+longPressMS = 500
+
+# Maximum milliseconds between KEY_A presses for a double tap to be sent:
+doubleTapMS = 300
+
+"""
+Returns typing steps that press the A key, hold it, and release it.
+Keyword Arguments:
+holdMS  -- Milliseconds to hold the key.
+afterMS -- Milliseconds to wait after releasing the key.
+"""
+def holdKey(holdMS, afterMS):
+    return [keyStep(KEY_A, 1, holdMS / 1000), keyStep(KEY_A, 0, afterMS / 1000)]
+
+"""
+Returns a function that checks how many long presses and double taps the
+parent reported.
+Keyword Arguments:
+longPresses -- The number of long presses the parent should get.
+doubleTaps  -- The number of double taps the parent should get.
+"""
+def expectGestures(longPresses, doubleTaps):
+    keyName = '[' + str(KEY_A) + ']: '
+    return lambda keyOutput: \
+            keyOutput.count(keyName + 'long press') == longPresses \
+            and keyOutput.count(keyName + 'double tap') == doubleTaps
+
+"""
+Creates Tests that make timed gestures on a stand-in keyboard.
+Keyword Arguments:
+testArgs -- A testArgs.Values argument object.
+"""
+def getTests(testArgs):
+    title = 'Key gesture tests:'
+    gestureArgs = ['--gesture', str(KEY_A) + ':' + str(longPressMS) + ':' \
+                   + str(doubleTapMS)]
+    # Leave enough time between tests for double taps to expire:
+    pauseMS = (doubleTapMS * 3) / 2
+    def testFunction(testObject):
+        standInKeyboard.runTest(testObject, testArgs, \
+                                'Long presses are only sent for keys held ' \
+                                + 'past the threshold', \
+                                holdKey(longPressMS * 2, pauseMS) \
+                                + holdKey(longPressMS / 2, pauseMS), \
+                                expectGestures(1, 0), gestureArgs)
+        quickTapMS = doubleTapMS / 3
+        standInKeyboard.runTest(testObject, testArgs, \
+                                'Double taps are only sent for presses ' \
+                                + 'within the threshold', \
+                                holdKey(quickTapMS, quickTapMS) \
+                                + holdKey(quickTapMS, pauseMS) \
+                                + holdKey(quickTapMS, pauseMS) \
+                                + holdKey(quickTapMS, pauseMS), \
+                                expectGestures(0, 1), gestureArgs)
+    testCount = 2
+    return Test(title, testFunction, testCount, testArgs)
+
+# Run this file's tests alone if executing this module as a script:
+if __name__ == '__main__':
+    args = testArgs.read()
+    if args.printHelp:
+        testArgs.printHelp('gestures.py', \
+                           'Test if the KeyDaemon reports long presses and ' \
+                           + 'double taps.')
+    gestureTests = getTests(args).runAll()
@@ -0,0 +1,86 @@
+"""
+Test that the daemon waits for keyboards when none are connected, and starts
+and stops reading keyboards connected or removed while it runs.
+
+The daemon is built to search a stand-in event directory, where FIFOs take the
+place of keyboard event files.
+"""
+
+import sys, os, shutil, tempfile, threading, time
+moduleDir = os.path.dirname(os.path.realpath(__file__))
+sys.path.insert(0, os.path.join(moduleDir, os.pardir))
+from supportModules import make, testArgs, pathConstants, testObject
+from supportModules.pathConstants import paths
+from supportModules.testObject import Test
+from supportModules.testResult import InitCode, ExitCode, Result
+from supportModules.inputEvents import KEY_A, packKeyEvent
+
+# Seconds the daemon runs before closing, long enough to connect a keyboard:
+daemonTimeout = 4
+
+"""
+Creates a stand-in keyboard event file after a delay, sends one tapped key,
+and then removes the keyboard.
+Keyword Arguments:
+eventPath -- The stand-in event file path.
+"""
+def connectKeyboard(eventPath):
+    time.sleep(1)
+    os.mkfifo(eventPath, 0o600)
+    # Opening for writing blocks until the daemon opens the file for reading:
+    with open(eventPath, 'wb', buffering = 0) as eventFile:
+        for value in (1, 0):
+            eventFile.write(packKeyEvent(KEY_A, value))
+        time.sleep(0.5)
+    os.unlink(eventPath)
+
+"""
+Creates Tests that run the daemon with a stand-in event directory.
+Keyword Arguments:
+testArgs -- A testArgs.Values argument object.
+"""
+def getTests(testArgs):
+    title = 'Keyboard hotplug tests:'
+    def testFunction(testObject):
+        eventDir = tempfile.mkdtemp(prefix = 'kdEvents')
+        try:
+            makeArgs = make.getBuildArgs(testArgs = testArgs, \
+                                         timeout = daemonTimeout, \
+                                         eventDir = eventDir + '/')
+            parentPath = paths.parentSecureExePath
+            result = testObject.fullTest(makeArgs, parentPath)
+            testObject.checkResult(result, \
+                                   'Daemon waits while no keyboards exist')
+
+            # Reuse the installed daemon and parent, connecting a keyboard
+            # after the daemon starts:
+            keyboardThread = threading.Thread( \
+                    target = connectKeyboard, \
+                    args = (os.path.join(eventDir, 'event0'),), \
+                    daemon = True)
+            keyboardThread.start()
+            runResult = testObject.execTest(parentPath)
+            keyboardThread.join(1)
+            if runResult == ExitCode.success:
+                keyOutput = ''
+                if os.path.isfile(paths.tempLogPath):
+                    with open(paths.tempLogPath, 'r') as logFile:
+                        keyOutput = logFile.read()
+                if '[' + str(KEY_A) + ']' not in keyOutput:
+                    runResult = InitCode.keyEventsMissing
+            testObject.checkResult(Result(runResult, ExitCode.success), \
+                                   'Keyboard connected and removed while ' \
+                                   + 'running')
+        finally:
+            shutil.rmtree(eventDir, ignore_errors = True)
+    testCount = 2
+    return Test(title, testFunction, testCount, testArgs)
+
+# Run this file's tests alone if executing this module as a script:
+if __name__ == '__main__':
+    args = testArgs.read()
+    if args.printHelp:
+        testArgs.printHelp('hotplug.py', \
+                           'Test if the KeyDaemon detects keyboards ' \
+                           + 'connected or removed while it runs.')
+    hotplugTests = getTests(args).runAll()
@@ -0,0 +1,127 @@
+"""
+Test that the daemon combines key events from several keyboards, so a key held
+on more than one keyboard at once is only pressed and released once, even when
+the parent only requests key presses.
+
+The daemon is built to search a stand-in event directory, where FIFOs take the
+place of keyboard event files.
+"""
+
+import sys, os, shutil, tempfile, threading, time
+moduleDir = os.path.dirname(os.path.realpath(__file__))
+sys.path.insert(0, os.path.join(moduleDir, os.pardir))
+from supportModules import make, testArgs, pathConstants, testObject
+from supportModules.pathConstants import paths
+from supportModules.testObject import Test
+from supportModules.testResult import InitCode, ExitCode, Result
+from supportModules.inputEvents import KEY_A, packKeyEvent
+
+# Number of stand-in keyboards to connect:
+keyboardCount = 2
+
+# Seconds the daemon runs before closing:
+daemonTimeout = 4
+
+"""
+Opens one stand-in keyboard, waits for every keyboard to open, then taps the A
+key, staggering each keyboard so their presses overlap.
+Keyword Arguments:
+eventPath -- The stand-in event file path.
+index     -- The keyboard's index, used to delay its key presses.
+barrier   -- Shared by all keyboard threads, so none type until all are read.
+tapCount  -- The number of times to press and release the A key.
+"""
+def typeOnKeyboard(eventPath, index, barrier, tapCount):
+    # Opening for writing blocks until the daemon opens the file for reading:
+    with open(eventPath, 'wb', buffering = 0) as eventFile:
+        barrier.wait()
+        time.sleep(0.5 + (0.1 * index))
+        for tap in range(tapCount):
+            for value in (1, 0):
+                eventFile.write(packKeyEvent(KEY_A, value))
+                time.sleep(0.2)
+        time.sleep(0.5)
+
+"""
+Counts how many times the parent reported an A key event.
+Keyword Arguments:
+keyOutput -- The parent's logged output.
+eventName -- The event type string printed by the parent.
+"""
+def countKeyEvents(keyOutput, eventName):
+    return keyOutput.count('[' + str(KEY_A) + ']: ' + eventName)
+
+"""
+Creates Tests that run the daemon with several stand-in keyboards.
+Keyword Arguments:
+testArgs -- A testArgs.Values argument object.
+"""
+def getTests(testArgs):
+    title = 'Keyboard merge tests:'
+    """
+    Runs the daemon while every stand-in keyboard taps the A key, and checks
+    the number of A key events the parent received.
+    Keyword Arguments:
+    testObject       -- The Test object running the test.
+    description      -- A description of the test.
+    tapCount         -- The number of times each keyboard taps the A key.
+    expectedPresses  -- The number of A key presses the parent should get.
+    expectedReleases -- The number of A key releases the parent should get.
+    argList          -- Arguments to pass to the TestParent. (default: [])
+    """
+    def runMergeTest(testObject, description, tapCount, expectedPresses, \
+                     expectedReleases, argList = []):
+        eventDir = tempfile.mkdtemp(prefix = 'kdEvents')
+        try:
+            eventPaths = [os.path.join(eventDir, 'event' + str(i)) \
+                          for i in range(keyboardCount)]
+            for eventPath in eventPaths:
+                os.mkfifo(eventPath, 0o600)
+            barrier = threading.Barrier(keyboardCount)
+            keyboardThreads = [threading.Thread(target = typeOnKeyboard, \
+                                                args = (path, i, barrier, \
+                                                        tapCount), \
+                                                daemon = True) \
+                               for i, path in enumerate(eventPaths)]
+            for keyboardThread in keyboardThreads:
+                keyboardThread.start()
+            makeArgs = make.getBuildArgs(testArgs = testArgs, \
+                                         timeout = daemonTimeout, \
+                                         eventDir = eventDir + '/')
+            result = testObject.fullTest(makeArgs, paths.parentSecureExePath, \
+                                         argList = argList)
+            for keyboardThread in keyboardThreads:
+                keyboardThread.join(1)
+            if result.getResultCode() == ExitCode.success:
+                keyOutput = ''
+                if os.path.isfile(paths.tempLogPath):
+                    with open(paths.tempLogPath, 'r') as logFile:
+                        keyOutput = logFile.read()
+                if countKeyEvents(keyOutput, 'pressed') != expectedPresses \
+                        or countKeyEvents(keyOutput, 'released') \
+                        != expectedReleases:
+                    result = Result(InitCode.keyEventsMissing, \
+                                    ExitCode.success)
+            testObject.checkResult(result, description)
+        finally:
+            shutil.rmtree(eventDir, ignore_errors = True)
+    def testFunction(testObject):
+        runMergeTest(testObject, 'Overlapping presses on ' \
+                     + str(keyboardCount) + ' keyboards are sent once', \
+                     1, 1, 1)
+        # Releases are still needed to merge presses, even if the parent
+        # doesn't request them:
+        runMergeTest(testObject, 'Repeated overlapping presses are sent ' \
+                     + 'when only presses are requested', 2, 2, 0, \
+                     ['--pressed-only'])
+    testCount = 2
+    return Test(title, testFunction, testCount, testArgs)
+
+# Run this file's tests alone if executing this module as a script:
+if __name__ == '__main__':
+    args = testArgs.read()
+    if args.printHelp:
+        testArgs.printHelp('mergeKeyboards.py', \
+                           'Test if the KeyDaemon sends keys held on ' \
+                           + 'several keyboards only once.')
+    mergeTests = getTests(args).runAll()
@@ -0,0 +1,87 @@
+"""
+Test that the daemon collapses or rate-limits repeat events sent by a stand-in
+keyboard while a key is held, according to the parent's repeat policy.
+"""
+
+import sys, os
+moduleDir = os.path.dirname(os.path.realpath(__file__))
+sys.path.insert(0, os.path.join(moduleDir, os.pardir))
+from supportModules import testArgs, standInKeyboard
+from supportModules.testObject import Test
+from supportModules.standInKeyboard import keyStep
+from supportModules.inputEvents import KEY_A
+
+# Number of repeat events sent while the A key is held:
+repeatCount = 20
+
+# Seconds between repeat events:
+repeatDelay = 0.05
+
+# Maximum repeats per second sent in the rate limit test:
+rateHz = 5
+
+"""
+Returns typing steps that press the A key, send repeat events, and release it.
+"""
+def holdWithRepeats():
+    return [keyStep(KEY_A, 1, repeatDelay)] \
+            + [keyStep(KEY_A, 2, repeatDelay) for i in range(repeatCount)] \
+            + [keyStep(KEY_A, 0)]
+
+"""
+Counts how many times the parent reported an A key repeat.
+Keyword Arguments:
+keyOutput -- The parent's logged output.
+"""
+def countRepeats(keyOutput):
+    return keyOutput.count('[' + str(KEY_A) + ']: held')
+
+"""
+Checks that the parent got one repeat, and a release holding the number of
+repeats sent.
+Keyword Arguments:
+keyOutput -- The parent's logged output.
+"""
+def checkCollapsed(keyOutput):
+    return countRepeats(keyOutput) == 1 \
+            and ('[' + str(KEY_A) + ']: released after ' + str(repeatCount) \
+                 + ' repeats') in keyOutput
+
+"""
+Checks that the parent got roughly as many repeats as the rate limit allows
+while the key was held, allowing for timing differences.
+Keyword Arguments:
+keyOutput -- The parent's logged output.
+"""
+def checkRateLimited(keyOutput):
+    allowedRepeats = int(repeatCount * repeatDelay * rateHz) + 1
+    return 1 < countRepeats(keyOutput) <= allowedRepeats
+
+"""
+Creates Tests that hold keys on a stand-in keyboard with repeat policies set.
+Keyword Arguments:
+testArgs -- A testArgs.Values argument object.
+"""
+def getTests(testArgs):
+    title = 'Repeat policy tests:'
+    def testFunction(testObject):
+        standInKeyboard.runTest(testObject, testArgs, \
+                                'Collapsed repeats are counted on release', \
+                                holdWithRepeats(), checkCollapsed, \
+                                ['--repeat', 'collapse'])
+        standInKeyboard.runTest(testObject, testArgs, \
+                                'Rate-limited repeats are sent at most ' \
+                                + str(rateHz) + ' times per second', \
+                                holdWithRepeats(), checkRateLimited, \
+                                ['--repeat', 'rateLimit:' + str(rateHz)])
+    testCount = 2
+    return Test(title, testFunction, testCount, testArgs)
+
+# Run this file's tests alone if executing this module as a script:
+if __name__ == '__main__':
+    args = testArgs.read()
+    if args.printHelp:
+        testArgs.printHelp('repeatPolicy.py', \
+                           'Test if the KeyDaemon collapses and rate-limits ' \
+                           + 'key repeats.')
+    repeatTests = getTests(args).runAll()
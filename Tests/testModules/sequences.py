@@ -0,0 +1,70 @@
+"""
+Test that the daemon reports registered key sequences typed on a stand-in
+keyboard, including sequences that start inside a partial match, and that
+sequences typed too slowly are ignored when a sequence timeout is set.
+"""
+
+import sys, os
+moduleDir = os.path.dirname(os.path.realpath(__file__))
+sys.path.insert(0, os.path.join(moduleDir, os.pardir))
+from supportModules import testArgs, standInKeyboard
+from supportModules.testObject import Test
+from supportModules.standInKeyboard import tapSteps
+from supportModules.inputEvents import KEY_A, KEY_B, KEY_C
+
+# The registered sequence, which repeats its first key so a partial match can
+# restart partway through:
+sequenceKeys = [KEY_A, KEY_A, KEY_B]
+
+# Maximum milliseconds between sequence key presses in the timeout test:
+sequenceTimeout = 300
+
+"""
+Returns a function that checks how many times the parent reported the
+registered sequence.
+Keyword Arguments:
+expectedCount -- The number of completed sequences the parent should get.
+"""
+def expectSequences(expectedCount):
+    return lambda keyOutput: \
+            keyOutput.count('Sequence 0: completed') == expectedCount
+
+"""
+Creates Tests that type key sequences on a stand-in keyboard.
+Keyword Arguments:
+testArgs -- A testArgs.Values argument object.
+"""
+def getTests(testArgs):
+    title = 'Key sequence tests:'
+    sequenceArgs = ['--sequence', ','.join(map(str, sequenceKeys))]
+    def testFunction(testObject):
+        # An extra leading press must still match, while an unrelated key
+        # press must reset the partial match:
+        standInKeyboard.runTest(testObject, testArgs, \
+                                'Sequences are matched after a partial ' \
+                                + 'match, and reset by other keys', \
+                                tapSteps([KEY_A, KEY_A, KEY_A, KEY_B]) \
+                                + tapSteps([KEY_A, KEY_A, KEY_C, KEY_B]), \
+                                expectSequences(1), sequenceArgs)
+        # Pause before the last key of the first sequence, then type the
+        # sequence again quickly:
+        slowSteps = tapSteps([KEY_A, KEY_A])
+        slowSteps[-1] = (slowSteps[-1][0], (sequenceTimeout * 2) / 1000)
+        slowSteps += tapSteps([KEY_B])
+        quickSteps = tapSteps(sequenceKeys, sequenceTimeout / 6000)
+        standInKeyboard.runTest(testObject, testArgs, \
+                                'Sequences typed slower than the timeout ' \
+                                + 'are ignored', slowSteps + quickSteps, \
+                                expectSequences(1), sequenceArgs, \
+                                sequenceTimeout = sequenceTimeout)
+    testCount = 2
+    return Test(title, testFunction, testCount, testArgs)
+
+# Run this file's tests alone if executing this module as a script:
+if __name__ == '__main__':
+    args = testArgs.read()
+    if args.printHelp:
+        testArgs.printHelp('sequences.py', \
+                           'Test if the KeyDaemon reports registered key ' \
+                           + 'sequences.')
+    sequenceTests = getTests(args).runAll()